@@ -17,6 +17,7 @@
   user_peripheral_domain = xheep.get_user_peripheral_domain()
   base_peripheral_domain = xheep.get_base_peripheral_domain()
   dma = base_peripheral_domain.get_dma()
+  spi_memio = base_peripheral_domain.get_spi_memio()
   memory_ss = xheep.memory_ss()
 %>
 
@@ -159,6 +160,10 @@ package core_v_mini_mcu_pkg;
 
   localparam int DMA_FIFO_DEPTH = ${dma.get_fifo_depth()};
 
+  localparam int SPIMEMIO_CACHE_LINE_SIZE = ${spi_memio.get_cache_line_size()};
+  localparam int SPIMEMIO_CACHE_NUM_LINES = ${spi_memio.get_cache_num_lines()};
+  localparam int SPIMEMIO_CACHE_PREFETCH = ${spi_memio.get_cache_prefetch()};
+
 % for peripheral in base_peripheral_domain.get_peripherals():
   localparam logic [31:0] ${peripheral.get_name().upper()}_START_ADDRESS = AO_PERIPHERAL_START_ADDRESS + 32'h${hex(peripheral.get_address())[2:]};
   localparam logic [31:0] ${peripheral.get_name().upper()}_SIZE = 32'h${hex(peripheral.get_length())[2:]};
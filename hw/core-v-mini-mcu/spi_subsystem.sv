@@ -93,14 +93,32 @@ module spi_subsystem
     end
   end
 
+  // The FLASH may be written while the OpenTitan SPI owns it, hence the cache is
+  // flushed when spimemio gets it back. A flush held meanwhile would stall the
+  // reads of the FLASH window, which instead keep going through the cache.
+  logic use_spimemio_q;
+
+  always_ff @(posedge clk_i or negedge rst_ni) begin
+    if (!rst_ni) begin
+      use_spimemio_q <= 1'b0;
+    end else begin
+      use_spimemio_q <= use_spimemio_i;
+    end
+  end
+
   // YosysHQ SPI
   assign yo_spi_sck_en = 1'b1;
   assign yo_spi_csb_en = 2'b01;
   assign yo_spi_csb[1] = 1'b1;
 
-  obi_spimemio obi_spimemio_i (
+  obi_spimemio #(
+      .CACHE_LINE_SIZE(core_v_mini_mcu_pkg::SPIMEMIO_CACHE_LINE_SIZE),
+      .CACHE_NUM_LINES(core_v_mini_mcu_pkg::SPIMEMIO_CACHE_NUM_LINES),
+      .CACHE_PREFETCH (core_v_mini_mcu_pkg::SPIMEMIO_CACHE_PREFETCH)
+  ) obi_spimemio_i (
       .clk_i,
       .rst_ni,
+      .cache_flush_i(use_spimemio_i & ~use_spimemio_q),
       .flash_csb_o(yo_spi_csb[0]),
       .flash_clk_o(yo_spi_sck),
       .flash_io0_oe_o(yo_spi_sd_en[0]),
@@ -20,7 +20,7 @@
     { name:     "SRC_PTR"
       desc:     "Input data pointer (word aligned)"
       swaccess: "rw"
-      hwaccess: "hro"
+      hwaccess: "hrw"
       fields: [
         { bits: "31:0", name: "PTR_IN", desc: "Input data pointer (word aligned)" }
       ]
@@ -28,7 +28,7 @@
     { name:     "DST_PTR"
       desc:     "Output data pointer (word aligned)"
       swaccess: "rw"
-      hwaccess: "hro"
+      hwaccess: "hrw"
       fields: [
         { bits: "31:0", name: "PTR_OUT", desc: "Output data pointer (word aligned)" }
       ]
@@ -46,7 +46,7 @@
     { name:     "SIZE_D1"
       desc:     "Number of elements to copy from, defined with respect to the first dimension - Once a value is written, the copy starts"
       swaccess: "rw"
-      hwaccess: "hro"
+      hwaccess: "hrw"
       hwqe:     "true" // enable `qe` latched signal of software write pulse
       // Dimensioned to 16 bits to allow for 64kB transfers on 1D
       fields: [
@@ -56,7 +56,7 @@
     { name:     "SIZE_D2"
       desc:     "Number of elements to copy from, defined with respect to the second dimension"
       swaccess: "rw"
-      hwaccess: "hro"
+      hwaccess: "hrw"
       // Dimensioned to 16 bits to allow for 64kB transfers on 2D
       fields: [
         { bits: "15:0", name: "SIZE", desc: "DMA counter D2" }
@@ -77,7 +77,7 @@
     { name:     "SRC_PTR_INC_D1"
       desc:     "Increment the D1 source pointer every time a word is copied"
       swaccess: "rw"
-      hwaccess: "hro"
+      hwaccess: "hrw"
       // Dimensioned to allow a maximum of a 15 element stride for a data_type_word case
       fields: [
         { bits: "5:0"
@@ -90,7 +90,7 @@
     { name:     "SRC_PTR_INC_D2"
       desc:     "Increment the D2 source pointer every time a word is copied"
       swaccess: "rw"
-      hwaccess: "hro"
+      hwaccess: "hrw"
       // Dimensioned to allow a maximum of 15 element stride for a data_type_word
       fields: [
         { bits: "22:0"
@@ -103,7 +103,7 @@
     { name:     "DST_PTR_INC_D1"
       desc:     "Increment the D1 destination pointer every time a word is copied"
       swaccess: "rw"
-      hwaccess: "hro"
+      hwaccess: "hrw"
       fields: [
         { bits: "5:0"
           name: "INC"
@@ -115,7 +115,7 @@
     { name:     "DST_PTR_INC_D2"
       desc:     "Increment the D2 destination pointer every time a word is copied"
       swaccess: "rw"
-      hwaccess: "hro"
+      hwaccess: "hrw"
       fields: [
         { bits: "22:0"
           name: "INC"
@@ -143,7 +143,7 @@
     { name:     "SRC_DATA_TYPE"
       desc:     '''Width/type of the source data to transfer'''
       swaccess: "rw"
-      hwaccess: "hro"
+      hwaccess: "hrw"
       resval:   0
       fields: [
         { bits: "1:0", name: "DATA_TYPE"
@@ -160,7 +160,7 @@
     { name:     "DST_DATA_TYPE"
       desc:     '''Width/type of the destination data to transfer'''
       swaccess: "rw"
-      hwaccess: "hro"
+      hwaccess: "hrw"
       resval:   0
       fields: [
         { bits: "1:0", name: "DATA_TYPE"
@@ -178,7 +178,7 @@
       name:     "SIGN_EXT"
       desc:     '''Is the data to be sign extended? (Checked only if the dst data type is wider than the src data type)'''
       swaccess: "rw"
-      hwaccess: "hro"
+      hwaccess: "hrw"
       resval:   0
       fields: [
         { bits: "0", name: "SIGNED"
@@ -223,7 +223,7 @@
     { name:     "DIM_CONFIG"
       desc:     '''Set the dimensionality of the DMA'''
       swaccess: "rw"
-      hwaccess: "hro"
+      hwaccess: "hrw"
       resval:   0
       fields: [
         { bits: "0", name: "DMA_DIM", desc: "DMA transfer dimensionality"}
@@ -232,7 +232,7 @@
     { name:     "DIM_INV"
       desc:     '''DMA dimensionality inversion selector'''
       swaccess: "rw"
-      hwaccess: "hro"
+      hwaccess: "hrw"
       resval:   0
       fields: [
         { bits: "0", name: "SEL", desc: "DMA dimensionality inversion, used to perform transposition"}
@@ -330,5 +330,38 @@
         { bits: "0", name: "FLAG", desc: "Set for window done interrupt" }
       ]
     }
+    { name:     "DESC_PTR"
+      desc:     '''Pointer to the first descriptor of a chain (word aligned) - Once a non-zero value is written,
+                   the DMA fetches the descriptors and performs their transactions one after the other.
+                   A descriptor is made of 8 words: next descriptor pointer (0 ends the chain), SRC_PTR, DST_PTR,
+                   SIZE_D1 | SIZE_D2 << 16, SRC_PTR_INC_D1 | DST_PTR_INC_D1 << 8 | SRC_DATA_TYPE << 16 |
+                   DST_DATA_TYPE << 18 | SIGN_EXT << 20 | DIM_CONFIG << 21 | DIM_INV << 22, SRC_PTR_INC_D2,
+                   DST_PTR_INC_D2 and flags (bit 0 raises the transaction done interrupt at the end of the descriptor,
+                   otherwise it is raised at the end of the chain)'''
+      swaccess: "rw"
+      hwaccess: "hro"
+      hwqe:     "true" // enable `qe` latched signal of software write pulse
+      fields: [
+        { bits: "31:0", name: "PTR", desc: "Descriptor pointer (word aligned) and start of the chain" }
+      ]
+    }
+    { name:    "TRANSACTION_PENDING"
+      desc:    '''Transaction interrupt flags of all the channels of the DMA subsystem, read from any channel'''
+      swaccess: "ro"
+      hwaccess: "hwo"
+      hwext:    "true"
+      fields: [
+        { bits: "31:0", name: "CHANNELS", desc: "Bit i is set while channel i has a pending transaction done interrupt" }
+      ]
+    }
+    { name:    "WINDOW_PENDING"
+      desc:    '''Window interrupt flags of all the channels of the DMA subsystem, read from any channel'''
+      swaccess: "ro"
+      hwaccess: "hwo"
+      hwext:    "true"
+      fields: [
+        { bits: "31:0", name: "CHANNELS", desc: "Bit i is set while channel i has a pending window done interrupt" }
+      ]
+    }
   ]
 }
@@ -41,6 +41,9 @@ module dma
 
     input logic [SLOT_NUM-1:0] trigger_slot_i,
 
+    input logic [31:0] trans_pending_i,
+    input logic [31:0] window_pending_i,
+
     output dma_done_intr_o,
     output dma_window_intr_o,
 
@@ -77,6 +80,20 @@ module dma
   logic address_mode;
   logic hw_fifo_mode;
 
+  /* Descriptor chain signals */
+  localparam int unsigned DESC_WORDS = 8;
+
+  logic desc_start_pending;
+  logic desc_chain_q;
+  logic desc_fetch;
+  logic desc_load;
+  logic desc_last;
+  logic desc_req;
+  logic [31:0] desc_addr_q;
+  logic [$clog2(DESC_WORDS):0] desc_req_cnt_q;
+  logic [$clog2(DESC_WORDS):0] desc_rsp_cnt_q;
+  logic [31:0] desc_words_q[DESC_WORDS];
+
   /* Buffer signals */
   fifo_req_t read_buffer_req;
   fifo_req_t read_addr_buffer_req;
@@ -148,6 +165,8 @@ module dma
   /* FSM states */
   enum {
     DMA_READY,
+    DMA_DESC_FETCH,
+    DMA_DESC_LOAD,
     DMA_STARTING,
     DMA_RUNNING
   }
@@ -233,8 +252,8 @@ module dma
 
       .read_buffer_input_o(read_buffer_input),
 
-      .data_in_gnt_i(data_in_gnt),
-      .data_in_rvalid_i(data_in_rvalid),
+      .data_in_gnt_i(data_in_gnt & ~desc_fetch),
+      .data_in_rvalid_i(data_in_rvalid & ~desc_fetch),
       .data_in_rdata_i(data_in_rdata),
 
       .data_in_req_o(data_in_req),
@@ -352,10 +371,14 @@ module dma
   //
   // Main DMA state machine
   //
-  // READY   : idle, waiting for a write pulse to size registered in `dma_start_pending`
-  // STARTING: load transaction data
-  // RUNNING : waiting for transaction finish
-  //           when `dma_done` rises either enter ready or restart in circular mode
+  // READY     : idle, waiting for a write pulse to size registered in `dma_start_pending`
+  //             or to the descriptor pointer registered in `desc_start_pending`
+  // DESC_FETCH: read the descriptor at `desc_addr_q` through the read port
+  // DESC_LOAD : copy the descriptor into the transaction registers
+  // STARTING  : load transaction data
+  // RUNNING   : waiting for transaction finish
+  //             when `dma_done` rises either enter ready, restart in circular mode
+  //             or fetch the next descriptor of the chain
   //
 
   always_comb begin
@@ -364,14 +387,25 @@ module dma
       DMA_READY: begin
         if (dma_start_pending) begin
           dma_state_d = DMA_STARTING;
+        end else if (desc_start_pending) begin
+          dma_state_d = DMA_DESC_FETCH;
         end
       end
+      DMA_DESC_FETCH: begin
+        if (data_in_rvalid && desc_rsp_cnt_q == DESC_WORDS - 1) begin
+          dma_state_d = DMA_DESC_LOAD;
+        end
+      end
+      DMA_DESC_LOAD: begin
+        dma_state_d = DMA_STARTING;
+      end
       DMA_STARTING: begin
         dma_state_d = DMA_RUNNING;
       end
       DMA_RUNNING: begin
         if (dma_done) begin
           if (circular_mode) dma_state_d = DMA_STARTING;
+          else if (desc_chain_q && !desc_last) dma_state_d = DMA_DESC_FETCH;
           else dma_state_d = DMA_READY;
         end
       end
@@ -400,13 +434,60 @@ module dma
     end
   end
 
+  /* Descriptor chain start when the desc_ptr register is written */
+  always_ff @(posedge clk_cg or negedge rst_ni) begin : proc_desc_start
+    if (~rst_ni) begin
+      desc_start_pending <= 1'b0;
+    end else begin
+      if (desc_fetch == 1'b1) begin
+        desc_start_pending <= 1'b0;
+      end else if ((reg2hw.desc_ptr.qe & |reg2hw.desc_ptr.q)) begin
+        desc_start_pending <= 1'b1;
+      end
+    end
+  end
+
+  /* Descriptor fetch: the current descriptor pointer and the words read so far */
+  always_ff @(posedge clk_cg, negedge rst_ni) begin : proc_desc_fetch
+    if (~rst_ni) begin
+      desc_chain_q   <= 1'b0;
+      desc_addr_q    <= '0;
+      desc_req_cnt_q <= '0;
+      desc_rsp_cnt_q <= '0;
+      for (int i = 0; i < DESC_WORDS; i++) desc_words_q[i] <= '0;
+    end else begin
+      if (dma_state_q == DMA_READY && !dma_start_pending && desc_start_pending) begin
+        desc_chain_q <= 1'b1;
+        desc_addr_q  <= {reg2hw.desc_ptr.q[31:2], 2'b00};
+      end else if (dma_state_q == DMA_RUNNING && dma_done) begin
+        if (desc_chain_q && !desc_last && !circular_mode) begin
+          desc_addr_q <= {desc_words_q[0][31:2], 2'b00};
+        end else if (!circular_mode) begin
+          desc_chain_q <= 1'b0;
+        end
+      end
+
+      if (desc_fetch) begin
+        if (desc_req && data_in_gnt) desc_req_cnt_q <= desc_req_cnt_q + 1;
+        if (data_in_rvalid) begin
+          desc_words_q[desc_rsp_cnt_q[$clog2(DESC_WORDS)-1:0]] <= data_in_rdata;
+          desc_rsp_cnt_q <= desc_rsp_cnt_q + 1;
+        end
+      end else begin
+        desc_req_cnt_q <= '0;
+        desc_rsp_cnt_q <= '0;
+      end
+    end
+  end
+
   /* Transaction IFR update */
   always_ff @(posedge clk_cg, negedge rst_ni) begin : proc_ff_transaction_ifr
     if (~rst_ni) begin
       transaction_ifr <= '0;
     end else if (reg2hw.interrupt_en.transaction_done.q == 1'b1) begin
       // Enter here only if the transaction_done interrupt is enabled
-      if (dma_done == 1'b1) begin
+      // Inside a chain, only at its end or after the descriptors that request it
+      if (dma_done == 1'b1 && (!desc_chain_q || desc_last || desc_words_q[7][0])) begin
         transaction_ifr <= 1'b1;
       end else if (reg2hw.transaction_ifr.re == 1'b1) begin
         // If the IFR bit is read, we must clear the transaction_ifr
@@ -498,11 +579,17 @@ module dma
   assign dma_done_o = dma_done;
   assign dma_start = (dma_state_q == DMA_STARTING);
 
-  /* OBI signals */
-  assign dma_read_req_o.req = data_in_req;
-  assign dma_read_req_o.we = data_in_we;
-  assign dma_read_req_o.be = data_in_be;
-  assign dma_read_req_o.addr = data_in_addr;
+  /* Descriptor signals */
+  assign desc_fetch = (dma_state_q == DMA_DESC_FETCH);
+  assign desc_load = (dma_state_q == DMA_DESC_LOAD);
+  assign desc_last = ~|desc_words_q[0];
+  assign desc_req = desc_fetch && (desc_req_cnt_q != DESC_WORDS);
+
+  /* OBI signals, the read port is borrowed to fetch the descriptors */
+  assign dma_read_req_o.req = desc_fetch ? desc_req : data_in_req;
+  assign dma_read_req_o.we = desc_fetch ? 1'b0 : data_in_we;
+  assign dma_read_req_o.be = desc_fetch ? 4'hF : data_in_be;
+  assign dma_read_req_o.addr = desc_fetch ? desc_addr_q + {desc_req_cnt_q, 2'b00} : data_in_addr;
   assign dma_read_req_o.wdata = 32'h0;
 
   assign data_in_gnt = dma_read_resp_i.gnt;
@@ -530,7 +617,7 @@ module dma
   assign data_out_rdata = dma_write_resp_i.rdata;
 
   /* FIFO signals */
-  assign read_buffer_req.push = data_in_rvalid;
+  assign read_buffer_req.push = data_in_rvalid & ~desc_fetch;
   assign read_buffer_req.pop = read_buffer_pop;
   assign read_buffer_req.flush = general_buffer_flush;
   assign read_buffer_req.data = read_buffer_input;
@@ -568,7 +655,38 @@ module dma
   assign hw2reg.transaction_ifr.d = transaction_ifr;
   assign hw2reg.window_ifr.d = window_ifr;
 
-  assign hw2reg.status.ready.d = (dma_state_q == DMA_READY);
+  assign hw2reg.transaction_pending.d = trans_pending_i;
+  assign hw2reg.window_pending.d = window_pending_i;
+
+  assign hw2reg.status.ready.d = (dma_state_q == DMA_READY) & ~desc_start_pending;
+
+  /* Transaction registers loaded from the descriptor */
+  assign hw2reg.src_ptr.d = desc_words_q[1];
+  assign hw2reg.src_ptr.de = desc_load;
+  assign hw2reg.dst_ptr.d = desc_words_q[2];
+  assign hw2reg.dst_ptr.de = desc_load;
+  assign hw2reg.size_d1.d = desc_words_q[3][15:0];
+  assign hw2reg.size_d1.de = desc_load;
+  assign hw2reg.size_d2.d = desc_words_q[3][31:16];
+  assign hw2reg.size_d2.de = desc_load;
+  assign hw2reg.src_ptr_inc_d1.d = desc_words_q[4][5:0];
+  assign hw2reg.src_ptr_inc_d1.de = desc_load;
+  assign hw2reg.dst_ptr_inc_d1.d = desc_words_q[4][13:8];
+  assign hw2reg.dst_ptr_inc_d1.de = desc_load;
+  assign hw2reg.src_data_type.d = desc_words_q[4][17:16];
+  assign hw2reg.src_data_type.de = desc_load;
+  assign hw2reg.dst_data_type.d = desc_words_q[4][19:18];
+  assign hw2reg.dst_data_type.de = desc_load;
+  assign hw2reg.sign_ext.d = desc_words_q[4][20];
+  assign hw2reg.sign_ext.de = desc_load;
+  assign hw2reg.dim_config.d = desc_words_q[4][21];
+  assign hw2reg.dim_config.de = desc_load;
+  assign hw2reg.dim_inv.d = desc_words_q[4][22];
+  assign hw2reg.dim_inv.de = desc_load;
+  assign hw2reg.src_ptr_inc_d2.d = desc_words_q[5][22:0];
+  assign hw2reg.src_ptr_inc_d2.de = desc_load;
+  assign hw2reg.dst_ptr_inc_d2.d = desc_words_q[6][22:0];
+  assign hw2reg.dst_ptr_inc_d2.de = desc_load;
   assign hw2reg.status.window_done.d = window_event;
 
   assign circular_mode = reg2hw.mode.q == 1;
@@ -59,6 +59,9 @@ module dma_subsystem
 
   localparam RVALID_FIFO_DEPTH = 4;
 
+  /* Channels covered by the pending interrupt registers */
+  localparam PENDING_CH_NUM = core_v_mini_mcu_pkg::DMA_CH_NUM > 32 ? 32 : core_v_mini_mcu_pkg::DMA_CH_NUM;
+
   /*_________________________________________________________________________________________________________________________________ */
 
   /* Signals declaration */
@@ -77,6 +80,10 @@ module dma_subsystem
   logic [core_v_mini_mcu_pkg::DMA_CH_NUM-1:0] dma_trans_done;
   logic [core_v_mini_mcu_pkg::DMA_CH_NUM-1:0] dma_window_done;
 
+  /* Pending interrupts of all the channels, readable from every channel */
+  logic [31:0] trans_pending;
+  logic [31:0] window_pending;
+
   /* Register interfaces from register demux to DMAs */
   reg_pkg::reg_req_t [core_v_mini_mcu_pkg::DMA_CH_NUM-1:0] submodules_req;
   reg_pkg::reg_rsp_t [core_v_mini_mcu_pkg::DMA_CH_NUM-1:0] submodules_rsp;
@@ -117,6 +124,8 @@ module dma_subsystem
           .trigger_slot_i({
             ext_trigger_slot_i[2*i+1], ext_trigger_slot_i[2*i], global_trigger_slot_i
           }),
+          .trans_pending_i(trans_pending),
+          .window_pending_i(window_pending),
           .dma_done_intr_o(dma_trans_done[i]),
           .dma_window_intr_o(dma_window_done[i]),
           .dma_done_o(dma_done_o[i])
@@ -269,4 +278,11 @@ module dma_subsystem
   assign dma_done_intr_o   = |(dma_trans_done);
   assign dma_window_intr_o = |(dma_window_done);
 
+  always_comb begin
+    trans_pending = '0;
+    window_pending = '0;
+    trans_pending[PENDING_CH_NUM-1:0] = dma_trans_done[PENDING_CH_NUM-1:0];
+    window_pending[PENDING_CH_NUM-1:0] = dma_window_done[PENDING_CH_NUM-1:0];
+  end
+
 endmodule
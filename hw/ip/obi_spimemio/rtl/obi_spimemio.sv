@@ -7,9 +7,14 @@
 module obi_spimemio
   import obi_pkg::*;
   import reg_pkg::*;
-(
+#(
+    parameter int CACHE_LINE_SIZE = 16,  // Bytes
+    parameter int CACHE_NUM_LINES = 0,  // 0 removes the read cache
+    parameter int CACHE_PREFETCH  = 0   // Lines
+) (
     input  logic clk_i,
     input  logic rst_ni,
+    input  logic cache_flush_i,
     output logic flash_csb_o,
     output logic flash_clk_o,
 
@@ -41,12 +46,17 @@ module obi_spimemio
   picorv32_req_t  picorv32_req;
   picorv32_resp_t picorv32_resp;
 
+  logic spimem_valid, spimem_ready;
+  logic [23:0] spimem_addr;
+  logic [31:0] spimem_rdata;
+
   reg_rsp_t reg_rsp_reg, reg_rsp_spimem;
 
   logic [31:0] cfgreg_do;
   logic cfgreg_we, cfgreg_rd;
 
   obi_spimemio_reg2hw_t reg2hw;
+  obi_spimemio_hw2reg_t hw2reg;
 
   obi_to_picorv32 obi_to_picorv32_i (
       .clk_i(clk_i),
@@ -66,6 +76,7 @@ module obi_spimemio
       .reg_req_i,
       .reg_rsp_o(reg_rsp_reg),
       .reg2hw,
+      .hw2reg,
       .devmode_i(1'b1)
   );
 
@@ -84,14 +95,54 @@ module obi_spimemio
     end
   end
 
+  generate
+    if (CACHE_NUM_LINES > 0) begin : gen_cache
+      logic cache_hit, cache_miss;
+
+      obi_spimemio_cache #(
+          .LINE_SIZE(CACHE_LINE_SIZE),
+          .NUM_LINES(CACHE_NUM_LINES),
+          .PREFETCH (CACHE_PREFETCH)
+      ) obi_spimemio_cache_i (
+          .clk_i,
+          .rst_ni,
+          .en_i(reg2hw.cache_ctrl.en.q),
+          .prefetch_en_i(reg2hw.cache_ctrl.prefetch_en.q),
+          .flush_i(cache_flush_i | (reg2hw.cache_flush.qe & reg2hw.cache_flush.q)),
+          .valid_i(picorv32_req.valid),
+          .addr_i({picorv32_req.addr[23:2], 2'b00}),
+          .ready_o(picorv32_resp.ready),
+          .rdata_o(picorv32_resp.rdata),
+          .mem_valid_o(spimem_valid),
+          .mem_addr_o(spimem_addr),
+          .mem_ready_i(spimem_ready),
+          .mem_rdata_i(spimem_rdata),
+          .hit_o(cache_hit),
+          .miss_o(cache_miss)
+      );
+
+      assign hw2reg.cache_hits.d = reg2hw.cache_hits.q + 32'd1;
+      assign hw2reg.cache_hits.de = cache_hit;
+      assign hw2reg.cache_misses.d = reg2hw.cache_misses.q + 32'd1;
+      assign hw2reg.cache_misses.de = cache_miss;
+    end else begin : gen_no_cache
+      assign spimem_valid = picorv32_req.valid;
+      assign spimem_addr = {picorv32_req.addr[23:2], 2'b00};
+      assign picorv32_resp.ready = spimem_ready;
+      assign picorv32_resp.rdata = spimem_rdata;
+
+      assign hw2reg = '0;
+    end
+  endgenerate
+
   spimemio spimemio_i (
       .clk(clk_i),
       .resetn(rst_ni),
       .start_spi_i(reg2hw.start_spimem.q),
-      .valid(picorv32_req.valid),
-      .ready(picorv32_resp.ready),
-      .addr({picorv32_req.addr[23:2], 2'b00}),
-      .rdata(picorv32_resp.rdata),
+      .valid(spimem_valid),
+      .ready(spimem_ready),
+      .addr(spimem_addr),
+      .rdata(spimem_rdata),
 
       .flash_csb(flash_csb_o),
       .flash_clk(flash_clk_o),
@@ -0,0 +1,152 @@
+// Copyright EPFL contributors.
+// Solderpad Hardware License, Version 2.1, see LICENSE.md for details.
+// SPDX-License-Identifier: Apache-2.0 WITH SHL-2.1
+
+// Direct-mapped read cache in front of the spimemio core.
+// A miss fills the whole line starting from its first word, so that spimemio
+// streams it without sending a new command, and then keeps going with the
+// next PREFETCH sequential lines. The word being received is forwarded to the
+// requester as soon as it arrives, and a new miss aborts any ongoing fill.
+
+module obi_spimemio_cache #(
+    parameter int LINE_SIZE = 16,  // Bytes
+    parameter int NUM_LINES = 16,
+    parameter int PREFETCH  = 1    // Lines
+) (
+    input logic clk_i,
+    input logic rst_ni,
+
+    input logic en_i,
+    input logic prefetch_en_i,
+    input logic flush_i,  // Pulse, misses are not served while it is high
+
+    // From obi_to_picorv32
+    input  logic        valid_i,
+    input  logic [23:0] addr_i,
+    output logic        ready_o,
+    output logic [31:0] rdata_o,
+
+    // To spimemio
+    output logic        mem_valid_o,
+    output logic [23:0] mem_addr_o,
+    input  logic        mem_ready_i,
+    input  logic [31:0] mem_rdata_i,
+
+    // Read served without waiting for the flash / after waiting for it
+    output logic hit_o,
+    output logic miss_o
+);
+
+  localparam int WORDS = LINE_SIZE / 4;
+  localparam int WORD_W = $clog2(WORDS);
+  localparam int OFFSET_W = $clog2(LINE_SIZE);
+  localparam int INDEX_W = $clog2(NUM_LINES);
+  localparam int LINE_W = 24 - OFFSET_W;
+  localparam int TAG_W = LINE_W - INDEX_W;
+  localparam int PREFETCH_W = PREFETCH > 0 ? $clog2(PREFETCH + 1) : 1;
+
+  logic [31:0] data_q[NUM_LINES][WORDS];
+  logic [TAG_W-1:0] tag_q[NUM_LINES];
+  logic [NUM_LINES-1:0] valid_q;
+
+  logic fill_q;
+  logic [LINE_W-1:0] fill_line_q;
+  logic [WORD_W-1:0] fill_word_q;
+  logic [PREFETCH_W-1:0] prefetch_left_q;
+  logic wait_q;
+
+  logic [LINE_W-1:0] req_line, next_line;
+  logic [INDEX_W-1:0] req_index, fill_index, next_index;
+  logic [WORD_W-1:0] req_word;
+
+  logic line_hit, in_fill, fill_hit, fill_bypass, next_present;
+  logic miss, fill_done, prefetch_next;
+
+  assign req_line = addr_i[23:OFFSET_W];
+  assign req_index = req_line[INDEX_W-1:0];
+  assign req_word = addr_i[OFFSET_W-1:2];
+
+  assign fill_index = fill_line_q[INDEX_W-1:0];
+  assign next_line = fill_line_q + 1'b1;
+  assign next_index = next_line[INDEX_W-1:0];
+
+  assign line_hit = valid_q[req_index] && tag_q[req_index] == req_line[LINE_W-1:INDEX_W];
+  assign in_fill = fill_q && fill_line_q == req_line;
+  // Words below fill_word_q are already stored, the current one is forwarded
+  assign fill_hit = in_fill && req_word < fill_word_q;
+  assign fill_bypass = in_fill && req_word == fill_word_q && mem_ready_i;
+  assign next_present = valid_q[next_index] && tag_q[next_index] == next_line[LINE_W-1:INDEX_W];
+
+  // A request that is neither stored nor coming with the current fill
+  assign miss = valid_i && !line_hit && !in_fill;
+  assign fill_done = fill_q && mem_ready_i && fill_word_q == WORD_W'(WORDS - 1);
+  assign prefetch_next = fill_done && prefetch_en_i && prefetch_left_q != '0 && !next_present;
+
+  always_comb begin
+    if (en_i) begin
+      ready_o = valid_i && (line_hit || fill_hit || fill_bypass);
+      rdata_o = fill_bypass ? mem_rdata_i : data_q[req_index][req_word];
+      mem_valid_o = fill_q;
+      mem_addr_o = {fill_line_q, fill_word_q, 2'b00};
+    end else begin
+      ready_o = mem_ready_i;
+      rdata_o = mem_rdata_i;
+      mem_valid_o = valid_i;
+      mem_addr_o = addr_i;
+    end
+  end
+
+  assign hit_o = en_i && ready_o && !wait_q;
+  assign miss_o = en_i && ready_o && wait_q;
+
+  always_ff @(posedge clk_i or negedge rst_ni) begin
+    if (!rst_ni) begin
+      valid_q <= '0;
+      fill_q <= 1'b0;
+      fill_line_q <= '0;
+      fill_word_q <= '0;
+      prefetch_left_q <= '0;
+      wait_q <= 1'b0;
+    end else begin
+      wait_q <= valid_i && !ready_o;
+
+      if (!en_i || flush_i) begin
+        valid_q <= '0;
+        fill_q  <= 1'b0;
+      end else if (miss) begin
+        fill_q <= 1'b1;
+        fill_line_q <= req_line;
+        fill_word_q <= '0;
+        prefetch_left_q <= PREFETCH_W'(PREFETCH);
+        valid_q[req_index] <= 1'b0;
+      end else if (fill_q && mem_ready_i) begin
+        fill_word_q <= fill_word_q + 1'b1;
+        if (fill_done) begin
+          valid_q[fill_index] <= 1'b1;
+          if (prefetch_next) begin
+            fill_line_q <= next_line;
+            prefetch_left_q <= prefetch_left_q - 1'b1;
+            valid_q[next_index] <= 1'b0;
+          end else begin
+            fill_q <= 1'b0;
+          end
+        end
+      end
+    end
+  end
+
+  // Tags and data need no reset, they are only read once the line is valid
+  always_ff @(posedge clk_i) begin
+    if (en_i && !flush_i) begin
+      if (miss) begin
+        tag_q[req_index] <= req_line[LINE_W-1:INDEX_W];
+      end else if (fill_q && mem_ready_i) begin
+        data_q[fill_index][fill_word_q] <= mem_rdata_i;
+        if (prefetch_next) begin
+          tag_q[next_index] <= next_line[LINE_W-1:INDEX_W];
+        end
+      end
+    end
+  end
+
+endmodule
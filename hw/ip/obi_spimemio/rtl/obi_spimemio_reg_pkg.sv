@@ -7,7 +7,7 @@
 package obi_spimemio_reg_pkg;
 
   // Address widths within the block
-  parameter int BlockAw = 3;
+  parameter int BlockAw = 5;
 
   ////////////////////////////
   // Typedefs for registers //
@@ -15,25 +15,71 @@ package obi_spimemio_reg_pkg;
 
   typedef struct packed {logic q;} obi_spimemio_reg2hw_start_spimem_reg_t;
 
+  typedef struct packed {
+    struct packed {logic q;} en;
+    struct packed {logic q;} prefetch_en;
+  } obi_spimemio_reg2hw_cache_ctrl_reg_t;
+
+  typedef struct packed {
+    logic q;
+    logic qe;
+  } obi_spimemio_reg2hw_cache_flush_reg_t;
+
+  typedef struct packed {logic [31:0] q;} obi_spimemio_reg2hw_cache_hits_reg_t;
+
+  typedef struct packed {logic [31:0] q;} obi_spimemio_reg2hw_cache_misses_reg_t;
+
+  typedef struct packed {
+    logic [31:0] d;
+    logic        de;
+  } obi_spimemio_hw2reg_cache_hits_reg_t;
+
+  typedef struct packed {
+    logic [31:0] d;
+    logic        de;
+  } obi_spimemio_hw2reg_cache_misses_reg_t;
+
   // Register -> HW type
   typedef struct packed {
-    obi_spimemio_reg2hw_start_spimem_reg_t start_spimem;  // [0:0]
+    obi_spimemio_reg2hw_start_spimem_reg_t start_spimem;  // [68:68]
+    obi_spimemio_reg2hw_cache_ctrl_reg_t cache_ctrl;  // [67:66]
+    obi_spimemio_reg2hw_cache_flush_reg_t cache_flush;  // [65:64]
+    obi_spimemio_reg2hw_cache_hits_reg_t cache_hits;  // [63:32]
+    obi_spimemio_reg2hw_cache_misses_reg_t cache_misses;  // [31:0]
   } obi_spimemio_reg2hw_t;
 
+  // HW -> register type
+  typedef struct packed {
+    obi_spimemio_hw2reg_cache_hits_reg_t cache_hits;  // [65:33]
+    obi_spimemio_hw2reg_cache_misses_reg_t cache_misses;  // [32:0]
+  } obi_spimemio_hw2reg_t;
+
   // Register offsets
-  parameter logic [BlockAw-1:0] OBI_SPIMEMIO_START_SPIMEM_OFFSET = 3'h0;
-  parameter logic [BlockAw-1:0] OBI_SPIMEMIO_CFG_SPIMEM_OFFSET = 3'h4;
+  parameter logic [BlockAw-1:0] OBI_SPIMEMIO_START_SPIMEM_OFFSET = 5'h0;
+  parameter logic [BlockAw-1:0] OBI_SPIMEMIO_CFG_SPIMEM_OFFSET = 5'h4;
+  parameter logic [BlockAw-1:0] OBI_SPIMEMIO_CACHE_CTRL_OFFSET = 5'h8;
+  parameter logic [BlockAw-1:0] OBI_SPIMEMIO_CACHE_FLUSH_OFFSET = 5'hc;
+  parameter logic [BlockAw-1:0] OBI_SPIMEMIO_CACHE_HITS_OFFSET = 5'h10;
+  parameter logic [BlockAw-1:0] OBI_SPIMEMIO_CACHE_MISSES_OFFSET = 5'h14;
 
   // Register index
   typedef enum int {
     OBI_SPIMEMIO_START_SPIMEM,
-    OBI_SPIMEMIO_CFG_SPIMEM
+    OBI_SPIMEMIO_CFG_SPIMEM,
+    OBI_SPIMEMIO_CACHE_CTRL,
+    OBI_SPIMEMIO_CACHE_FLUSH,
+    OBI_SPIMEMIO_CACHE_HITS,
+    OBI_SPIMEMIO_CACHE_MISSES
   } obi_spimemio_id_e;
 
   // Register width information to check illegal writes
-  parameter logic [3:0] OBI_SPIMEMIO_PERMIT[2] = '{
+  parameter logic [3:0] OBI_SPIMEMIO_PERMIT[6] = '{
       4'b0001,  // index[0] OBI_SPIMEMIO_START_SPIMEM
-      4'b1111  // index[1] OBI_SPIMEMIO_CFG_SPIMEM
+      4'b1111,  // index[1] OBI_SPIMEMIO_CFG_SPIMEM
+      4'b0001,  // index[2] OBI_SPIMEMIO_CACHE_CTRL
+      4'b0001,  // index[3] OBI_SPIMEMIO_CACHE_FLUSH
+      4'b1111,  // index[4] OBI_SPIMEMIO_CACHE_HITS
+      4'b1111  // index[5] OBI_SPIMEMIO_CACHE_MISSES
   };
 
 endpackage
@@ -10,7 +10,7 @@
 module obi_spimemio_reg_top #(
     parameter type reg_req_t = logic,
     parameter type reg_rsp_t = logic,
-    parameter int AW = 3
+    parameter int AW = 5
 ) (
     input clk_i,
     input rst_ni,
@@ -18,6 +18,7 @@ module obi_spimemio_reg_top #(
     output reg_rsp_t reg_rsp_o,
     // To HW
     output obi_spimemio_reg_pkg::obi_spimemio_reg2hw_t reg2hw,  // Write
+    input obi_spimemio_reg_pkg::obi_spimemio_hw2reg_t hw2reg,  // Read
 
 
     // Config
@@ -70,6 +71,20 @@ module obi_spimemio_reg_top #(
   logic start_spimem_qs;
   logic start_spimem_wd;
   logic start_spimem_we;
+  logic cache_ctrl_en_qs;
+  logic cache_ctrl_en_wd;
+  logic cache_ctrl_en_we;
+  logic cache_ctrl_prefetch_en_qs;
+  logic cache_ctrl_prefetch_en_wd;
+  logic cache_ctrl_prefetch_en_we;
+  logic cache_flush_wd;
+  logic cache_flush_we;
+  logic [31:0] cache_hits_qs;
+  logic [31:0] cache_hits_wd;
+  logic cache_hits_we;
+  logic [31:0] cache_misses_qs;
+  logic [31:0] cache_misses_wd;
+  logic cache_misses_we;
 
   // Register instances
   // R[start_spimem]: V(False)
@@ -124,13 +139,151 @@ module obi_spimemio_reg_top #(
   );
 
 
+  // R[cache_ctrl]: V(False)
 
+  //   F[en]: 0:0
+  prim_subreg #(
+      .DW      (1),
+      .SWACCESS("RW"),
+      .RESVAL  (1'h1)
+  ) u_cache_ctrl_en (
+      .clk_i (clk_i),
+      .rst_ni(rst_ni),
+
+      // from register interface
+      .we(cache_ctrl_en_we),
+      .wd(cache_ctrl_en_wd),
+
+      // from internal hardware
+      .de(1'b0),
+      .d ('0),
+
+      // to internal hardware
+      .qe(),
+      .q (reg2hw.cache_ctrl.en.q),
+
+      // to register interface (read)
+      .qs(cache_ctrl_en_qs)
+  );
+
+
+  //   F[prefetch_en]: 1:1
+  prim_subreg #(
+      .DW      (1),
+      .SWACCESS("RW"),
+      .RESVAL  (1'h1)
+  ) u_cache_ctrl_prefetch_en (
+      .clk_i (clk_i),
+      .rst_ni(rst_ni),
+
+      // from register interface
+      .we(cache_ctrl_prefetch_en_we),
+      .wd(cache_ctrl_prefetch_en_wd),
+
+      // from internal hardware
+      .de(1'b0),
+      .d ('0),
+
+      // to internal hardware
+      .qe(),
+      .q (reg2hw.cache_ctrl.prefetch_en.q),
+
+      // to register interface (read)
+      .qs(cache_ctrl_prefetch_en_qs)
+  );
+
+
+  // R[cache_flush]: V(False)
+
+  prim_subreg #(
+      .DW      (1),
+      .SWACCESS("WO"),
+      .RESVAL  (1'h0)
+  ) u_cache_flush (
+      .clk_i (clk_i),
+      .rst_ni(rst_ni),
+
+      // from register interface
+      .we(cache_flush_we),
+      .wd(cache_flush_wd),
+
+      // from internal hardware
+      .de(1'b0),
+      .d ('0),
+
+      // to internal hardware
+      .qe(reg2hw.cache_flush.qe),
+      .q (reg2hw.cache_flush.q),
+
+      .qs()
+  );
 
-  logic [1:0] addr_hit;
+
+  // R[cache_hits]: V(False)
+
+  prim_subreg #(
+      .DW      (32),
+      .SWACCESS("RW"),
+      .RESVAL  (32'h0)
+  ) u_cache_hits (
+      .clk_i (clk_i),
+      .rst_ni(rst_ni),
+
+      // from register interface
+      .we(cache_hits_we),
+      .wd(cache_hits_wd),
+
+      // from internal hardware
+      .de(hw2reg.cache_hits.de),
+      .d (hw2reg.cache_hits.d),
+
+      // to internal hardware
+      .qe(),
+      .q (reg2hw.cache_hits.q),
+
+      // to register interface (read)
+      .qs(cache_hits_qs)
+  );
+
+
+  // R[cache_misses]: V(False)
+
+  prim_subreg #(
+      .DW      (32),
+      .SWACCESS("RW"),
+      .RESVAL  (32'h0)
+  ) u_cache_misses (
+      .clk_i (clk_i),
+      .rst_ni(rst_ni),
+
+      // from register interface
+      .we(cache_misses_we),
+      .wd(cache_misses_wd),
+
+      // from internal hardware
+      .de(hw2reg.cache_misses.de),
+      .d (hw2reg.cache_misses.d),
+
+      // to internal hardware
+      .qe(),
+      .q (reg2hw.cache_misses.q),
+
+      // to register interface (read)
+      .qs(cache_misses_qs)
+  );
+
+
+
+
+  logic [5:0] addr_hit;
   always_comb begin
     addr_hit = '0;
     addr_hit[0] = (reg_addr == OBI_SPIMEMIO_START_SPIMEM_OFFSET);
     addr_hit[1] = (reg_addr == OBI_SPIMEMIO_CFG_SPIMEM_OFFSET);
+    addr_hit[2] = (reg_addr == OBI_SPIMEMIO_CACHE_CTRL_OFFSET);
+    addr_hit[3] = (reg_addr == OBI_SPIMEMIO_CACHE_FLUSH_OFFSET);
+    addr_hit[4] = (reg_addr == OBI_SPIMEMIO_CACHE_HITS_OFFSET);
+    addr_hit[5] = (reg_addr == OBI_SPIMEMIO_CACHE_MISSES_OFFSET);
   end
 
   assign addrmiss = (reg_re || reg_we) ? ~|addr_hit : 1'b0;
@@ -139,12 +292,31 @@ module obi_spimemio_reg_top #(
   always_comb begin
     wr_err = (reg_we &
               ((addr_hit[0] & (|(OBI_SPIMEMIO_PERMIT[0] & ~reg_be))) |
-               (addr_hit[1] & (|(OBI_SPIMEMIO_PERMIT[1] & ~reg_be)))));
+               (addr_hit[1] & (|(OBI_SPIMEMIO_PERMIT[1] & ~reg_be))) |
+               (addr_hit[2] & (|(OBI_SPIMEMIO_PERMIT[2] & ~reg_be))) |
+               (addr_hit[3] & (|(OBI_SPIMEMIO_PERMIT[3] & ~reg_be))) |
+               (addr_hit[4] & (|(OBI_SPIMEMIO_PERMIT[4] & ~reg_be))) |
+               (addr_hit[5] & (|(OBI_SPIMEMIO_PERMIT[5] & ~reg_be)))));
   end
 
   assign start_spimem_we = addr_hit[0] & reg_we & !reg_error;
   assign start_spimem_wd = reg_wdata[0];
 
+  assign cache_ctrl_en_we = addr_hit[2] & reg_we & !reg_error;
+  assign cache_ctrl_en_wd = reg_wdata[0];
+
+  assign cache_ctrl_prefetch_en_we = addr_hit[2] & reg_we & !reg_error;
+  assign cache_ctrl_prefetch_en_wd = reg_wdata[1];
+
+  assign cache_flush_we = addr_hit[3] & reg_we & !reg_error;
+  assign cache_flush_wd = reg_wdata[0];
+
+  assign cache_hits_we = addr_hit[4] & reg_we & !reg_error;
+  assign cache_hits_wd = reg_wdata[31:0];
+
+  assign cache_misses_we = addr_hit[5] & reg_we & !reg_error;
+  assign cache_misses_wd = reg_wdata[31:0];
+
   // Read data return
   always_comb begin
     reg_rdata_next = '0;
@@ -157,6 +329,23 @@ module obi_spimemio_reg_top #(
         reg_rdata_next[31:0] = '0;
       end
 
+      addr_hit[2]: begin
+        reg_rdata_next[0] = cache_ctrl_en_qs;
+        reg_rdata_next[1] = cache_ctrl_prefetch_en_qs;
+      end
+
+      addr_hit[3]: begin
+        reg_rdata_next[0] = '0;
+      end
+
+      addr_hit[4]: begin
+        reg_rdata_next[31:0] = cache_hits_qs;
+      end
+
+      addr_hit[5]: begin
+        reg_rdata_next[31:0] = cache_misses_qs;
+      end
+
       default: begin
         reg_rdata_next = '1;
       end
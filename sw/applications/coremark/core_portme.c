@@ -34,10 +34,21 @@ Original Author: Shay Gal-on
 // SPDX-License-Identifier:Apache-2.0 WITH SHL-2.0
 
 #include "csr.h"
+#include "mmio.h"
 #include "x-heep.h"
+#include "core_v_mini_mcu.h"
+#include "spi_memio_regs.h"
 
 #include "coremark.h"
 
+/*
+ * Compile with -DFLASH_CACHE=0 to run with the spimemio read cache disabled,
+ * to compare the two when running in-place from flash (LINKER=flash_exec).
+ */
+#ifndef FLASH_CACHE
+#define FLASH_CACHE 1
+#endif
+
 ee_u32 default_num_contexts = 1;
 
 static CORETIMETYPE start_time_val, stop_time_val;
@@ -63,17 +74,34 @@ volatile ee_s32 seed5_volatile = 0;
 void
 portable_init(core_portable *p, int *argc, char *argv[])
 {
-    // Don't need to do anything here atm.
     (void)p;
     (void)argc;
     (void)argv;
+
+#if SPIMEMIO_CACHE_NUM_LINES > 0
+    mmio_region_t spimemio = mmio_region_from_addr(SPI_MEMIO_START_ADDRESS);
+    mmio_region_write32(spimemio,
+                        OBI_SPIMEMIO_CACHE_CTRL_REG_OFFSET,
+                        FLASH_CACHE ? (1 << OBI_SPIMEMIO_CACHE_CTRL_EN_BIT)
+                                          | (1 << OBI_SPIMEMIO_CACHE_CTRL_PREFETCH_EN_BIT)
+                                    : 0);
+    mmio_region_write32(spimemio, OBI_SPIMEMIO_CACHE_HITS_REG_OFFSET, 0);
+    mmio_region_write32(spimemio, OBI_SPIMEMIO_CACHE_MISSES_REG_OFFSET, 0);
+#endif
 }
 
 void
 portable_fini(core_portable *p)
 {
-    // Don't need to do anything here atm.
     (void)p;
+
+#if SPIMEMIO_CACHE_NUM_LINES > 0
+    mmio_region_t spimemio = mmio_region_from_addr(SPI_MEMIO_START_ADDRESS);
+    ee_printf("Flash cache %s: %u hits, %u misses\n",
+              FLASH_CACHE ? "enabled" : "disabled",
+              (unsigned)mmio_region_read32(spimemio, OBI_SPIMEMIO_CACHE_HITS_REG_OFFSET),
+              (unsigned)mmio_region_read32(spimemio, OBI_SPIMEMIO_CACHE_MISSES_REG_OFFSET));
+#endif
 }
 
 void
@@ -15,6 +15,8 @@
  * data size does not fit in the available SRAM memory, so some data needs to be
  * stored as "flash_only" and read trough the spi interface. This usually requires
  * filling a buffer and tiling the data processing.
+ * The tiles are streamed from the flash into a ring of buffers, so the next
+ * tiles are read while the current one is being processed.
 */
 
 #include <stdio.h>
@@ -27,6 +29,8 @@
 #include "dma_sdk.h"
 
 #define TILING_ROWS 2
+#define TILE_BUFFERS 2
+#define STREAM_DMA_CHANNEL 0
 
  /* By default, printfs are activated for FPGA and disabled for simulation. */
 #define PRINTF_IN_FPGA  1
@@ -39,9 +43,11 @@
     #define PRINTF(...)
 #endif
 
-int32_t buffer_data[MATRIX_SIZE*TILING_ROWS] = {0};
+int32_t buffer_data[MATRIX_SIZE*TILING_ROWS*TILE_BUFFERS] = {0};
 int32_t output_matrix[MATRIX_SIZE*MATRIX_SIZE] = {0};
 
+static w25q_stream_t stream;
+
 int main(int argc, char *argv[]) {
 #ifndef FLASH_LOAD
     PRINTF("This application is meant to run with the FLASH_LOAD linker script\n");
@@ -71,13 +77,27 @@ int main(int argc, char *argv[]) {
         return EXIT_FAILURE;
     } 
 
-    for (int i = 0; i < MATRIX_SIZE; i+=TILING_ROWS) {
-        // read first half matrix A from flash and perform matmul
-        if(fill_buffer(&A[i*MATRIX_SIZE], buffer_data, MATRIX_SIZE*TILING_ROWS)!=FLASH_OK){
-            PRINTF("Error reading from flash\n");
-            return EXIT_FAILURE;
-        }
-        matmul(buffer_data, B, &output_matrix[i*MATRIX_SIZE], TILING_ROWS, MATRIX_SIZE, MATRIX_SIZE);
+    dma_sdk_init();
+
+    // Stream matrix A from flash, TILING_ROWS rows at a time
+    stream.buffers = (uint8_t *)buffer_data;
+    stream.chunk_size = MATRIX_SIZE*TILING_ROWS*sizeof(int32_t);
+    stream.num_buffers = TILE_BUFFERS;
+    stream.channel = STREAM_DMA_CHANNEL;
+    stream.callback = NULL;
+    if (w25q128jw_stream_start(&stream, (uintptr_t)heep_get_flash_address_offset((uint32_t *)A), sizeof(A)) != FLASH_OK) {
+        PRINTF("Error reading from flash\n");
+        return EXIT_FAILURE;
+    }
+
+    // Perform the matmul of each tile while the next one is read
+    int32_t *tile;
+    for (int i = 0; (tile = (int32_t *)w25q128jw_stream_get(&stream, NULL)) != NULL; i+=TILING_ROWS) {
+        matmul(tile, B, &output_matrix[i*MATRIX_SIZE], TILING_ROWS, MATRIX_SIZE, MATRIX_SIZE);
+    }
+    if (stream.error) {
+        PRINTF("Error streaming from flash\n");
+        return EXIT_FAILURE;
     }
 
     for(int i = 0; i < MATRIX_SIZE*MATRIX_SIZE; i++){
@@ -18,11 +18,14 @@
 #define TEST_PENDING_TRANSACTION
 #define TEST_WINDOW
 #define TEST_ADDRESS_MODE_EXTERNAL_DEVICE
+#define TEST_TRANS_IMAGE
+#define TEST_DESC_CHAIN
 
 #define TEST_DATA_SIZE 16
 #define TEST_DATA_LARGE 256
 #define TRANSACTIONS_N 3         // Only possible to perform one transaction at a time, others should be blocked
 #define TEST_WINDOW_SIZE_DU 256 // if put at <=71 the isr is too slow to react to the interrupt
+#define TEST_CHAIN_TILE 4       // Side of the square tiles extracted by the descriptor chain
 
 #if TEST_DATA_LARGE < 2 * TEST_DATA_SIZE
 #errors("TEST_DATA_LARGE must be at least 2*TEST_DATA_SIZE")
@@ -513,5 +516,160 @@ int main(int argc, char *argv[])
     }
 #endif // TEST_WINDOW
 
+#ifdef TEST_TRANS_IMAGE
+
+    PRINTF("\n\n\r===================================\n\n\r");
+    PRINTF("    TESTING TRANSACTION IMAGE   ");
+    PRINTF("\n\n\r===================================\n\n\r");
+
+    dma_trans_image_t img;
+    uint32_t cycles_load, cycles_img, cycles_img_total = 0;
+
+    // Enable the cycle counter, it is stopped by default
+    CSR_CLEAR_BITS(CSR_REG_MCOUNTINHIBIT, 0x1);
+
+    for (uint32_t i = 0; i < TEST_DATA_LARGE; i++)
+    {
+        test_data_large[i] = i;
+        copied_data_4B[i] = 0;
+    }
+
+    tgt_src.ptr = (uint8_t *)test_data_large;
+    trans.size_d1_du = TEST_DATA_SIZE;
+    trans.win_du = 0;
+    trans.end = DMA_TRANS_END_POLLING;
+    trans.flags = 0x0;
+
+    res = dma_validate_transaction(&trans, DMA_ENABLE_REALIGN, DMA_PERFORM_CHECKS_INTEGRITY);
+    res |= dma_compile_transaction(&trans, &img);
+    PRINTF("tran: %u \t%s\n\r", res, res == DMA_CONFIG_OK ? "Ok!" : "Error!");
+
+    // Setup cost of a transfer through the load and launch path
+    CSR_WRITE(CSR_REG_MCYCLE, 0);
+    res = dma_load_transaction(&trans);
+    res |= dma_launch(&trans);
+    CSR_READ(CSR_REG_MCYCLE, &cycles_load);
+    while (!dma_is_ready(0));
+
+    // The following blocks are copied relaunching the compiled image
+    for (uint32_t i = 1; i < TEST_DATA_LARGE / TEST_DATA_SIZE; i++)
+    {
+        CSR_WRITE(CSR_REG_MCYCLE, 0);
+        res |= dma_launch_image(&img, (uint8_t *)&test_data_large[i * TEST_DATA_SIZE], (uint8_t *)&copied_data_4B[i * TEST_DATA_SIZE], 0);
+        CSR_READ(CSR_REG_MCYCLE, &cycles_img);
+        cycles_img_total += cycles_img;
+        while (!dma_is_ready(0));
+    }
+
+    PRINTF("Setup cycles: load+launch %d, image %d (average of %d relaunches)\n\r", cycles_load,
+           cycles_img_total / (TEST_DATA_LARGE / TEST_DATA_SIZE - 1), TEST_DATA_LARGE / TEST_DATA_SIZE - 1);
+
+    for (uint32_t i = 0; i < TEST_DATA_LARGE; i++)
+    {
+        if (copied_data_4B[i] != test_data_large[i])
+        {
+            PRINTF("[%d] %04x\tvs.\t%04x\n\r", i, copied_data_4B[i], test_data_large[i]);
+            errors++;
+        }
+    }
+
+    if (errors == 0 && res == DMA_CONFIG_OK)
+    {
+        PRINTF("DMA transaction image success\n\r");
+    }
+    else
+    {
+        PRINTF("DMA transaction image failure: %d errors out of %d words checked\n\r", errors, TEST_DATA_LARGE);
+        return EXIT_FAILURE;
+    }
+#endif // TEST_TRANS_IMAGE
+
+#ifdef TEST_DESC_CHAIN
+
+    PRINTF("\n\n\r===================================\n\n\r");
+    PRINTF("    TESTING DESCRIPTOR CHAIN   ");
+    PRINTF("\n\n\r===================================\n\n\r");
+
+    // Two tiles of the TEST_DATA_SIZE-wide matrix in test_data_large, copied one after the other
+    static dma_desc_t desc[2];
+    const uint32_t tile_row[2] = {0, TEST_CHAIN_TILE};
+    const uint32_t tile_col[2] = {0, 2 * TEST_CHAIN_TILE};
+
+    for (uint32_t i = 0; i < TEST_DATA_LARGE; i++)
+    {
+        test_data_large[i] = i;
+        copied_data_4B[i] = 0;
+    }
+
+    tgt_src.inc_d1_du = 1;
+    tgt_src.inc_d2_du = TEST_DATA_SIZE - (TEST_CHAIN_TILE - 1);
+    tgt_dst.inc_d1_du = 1;
+    tgt_dst.inc_d2_du = 1;
+
+    trans.dim = DMA_DIM_CONF_2D;
+    trans.size_d1_du = TEST_CHAIN_TILE;
+    trans.size_d2_du = TEST_CHAIN_TILE;
+    trans.win_du = 0;
+    trans.end = DMA_TRANS_END_INTR_WAIT;
+
+    res = DMA_CONFIG_OK;
+    for (uint32_t t = 0; t < 2; t++)
+    {
+        tgt_src.ptr = (uint8_t *)&test_data_large[tile_row[t] * TEST_DATA_SIZE + tile_col[t]];
+        tgt_dst.ptr = (uint8_t *)&copied_data_4B[t * TEST_CHAIN_TILE * TEST_CHAIN_TILE];
+        trans.flags = 0x0;
+        res |= dma_validate_transaction(&trans, DMA_ENABLE_REALIGN, DMA_PERFORM_CHECKS_INTEGRITY);
+        // The first tile also raises the interrupt, in the middle of the chain
+        res |= dma_desc_build(&desc[t], &trans, t == 0 ? &desc[1] : NULL, t == 0 ? DMA_DESC_FLAG_INTR : 0);
+    }
+    PRINTF("desc: %u \t%s\n\r", res, res == DMA_CONFIG_OK ? "Ok!" : "Error!");
+
+    // The loaded transaction holds the end event and the triggers of the whole chain
+    cycles = 0;
+    res |= dma_load_transaction(&trans);
+    res |= dma_launch_chain(&trans, &desc[0]);
+    PRINTF("laun: %u \t%s\n\r", res, res == DMA_CONFIG_OK ? "Ok!" : "Error!");
+
+    // The interrupt at the end of the chain can come after the channel is ready
+    while (cycles < 2)
+    {
+        CSR_CLEAR_BITS(CSR_REG_MSTATUS, 0x8);
+        if (cycles < 2)
+        {
+            wait_for_interrupt();
+        }
+        CSR_SET_BITS(CSR_REG_MSTATUS, 0x8);
+    }
+
+    PRINTF("\nWe had %d transaction done interrupts.\n\r", cycles);
+
+    for (uint32_t t = 0; t < 2; t++)
+    {
+        for (uint32_t r = 0; r < TEST_CHAIN_TILE; r++)
+        {
+            for (uint32_t c = 0; c < TEST_CHAIN_TILE; c++)
+            {
+                uint32_t expected = test_data_large[(tile_row[t] + r) * TEST_DATA_SIZE + tile_col[t] + c];
+                uint32_t copied = copied_data_4B[(t * TEST_CHAIN_TILE + r) * TEST_CHAIN_TILE + c];
+                if (copied != expected)
+                {
+                    PRINTF("[%d][%d][%d] %04x\tvs.\t%04x\n\r", t, r, c, copied, expected);
+                    errors++;
+                }
+            }
+        }
+    }
+
+    if (errors == 0 && res == DMA_CONFIG_OK && cycles == 2)
+    {
+        PRINTF("DMA descriptor chain success\n\r");
+    }
+    else
+    {
+        PRINTF("DMA descriptor chain failure: %d errors out of %d words checked\n\r", errors, 2 * TEST_CHAIN_TILE * TEST_CHAIN_TILE);
+        return EXIT_FAILURE;
+    }
+#endif // TEST_DESC_CHAIN
+
     return EXIT_SUCCESS;
 }
\ No newline at end of file
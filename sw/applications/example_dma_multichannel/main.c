@@ -58,12 +58,16 @@
  *     - Add boot_sel and execute_from_flash: 
  *       'make run PLUSARGS="c firmware=../../../sw/build/main.hex boot_sel=1 execute_from_flash=0" '
  *     
+ *  4: Launch a short copy on every channel with the DMA interrupt masked, so that all the channels are
+ *     pending when it is unmasked, and check that the handler serves them in the order given by
+ *     dma_set_intr_priority(): highest priority first, lowest channel first among equal priorities.
  */
 
 #define TEST_ID_0
 #define TEST_ID_1
 #define TEST_ID_2
 #define TEST_ID_3
+#define TEST_ID_4
 
 /* Enable performance analysis */
 #define EN_PERF 1
@@ -210,10 +214,18 @@ uint8_t window_flag[DMA_CH_NUM];
 char passed = 1;
 char flag = 0;
 
+/* Order in which the transaction interrupts are served, for TEST_ID_4 */
+uint8_t trans_order[DMA_CH_NUM];
+uint8_t trans_order_cnt = 0;
+
 /* Strong transaction ISR implementation */
 void dma_intr_handler_trans_done(uint8_t channel)
 {
     transaction_flag[channel] = 1;
+    if (trans_order_cnt < DMA_CH_NUM)
+    {
+        trans_order[trans_order_cnt++] = channel;
+    }
     return;
 }
 
@@ -1250,5 +1262,134 @@ int main()
 
     #endif
 
+    #ifdef TEST_ID_4
+
+    /* Testing the order in which the pending channels are served, according to their priority */
+
+    /* Reset for the fifth test */
+    for (int c=0; c<DMA_CH_NUM; c++)
+    { 
+        transaction_flag[c] = 0;
+        for (int i = 0; i < SIZE_EXTR_D1; i++) {
+            copied_data_2D_DMA[c][i] = 0;
+        }
+    }
+    trans_order_cnt = 0;
+
+    dma_init(NULL);
+
+    /* The priorities decrease with the channel index, wrapping around when there are more channels than levels */
+    for (int c=0; c<DMA_CH_NUM; c++)
+    {
+        dma_set_intr_priority(c, (DMA_CH_NUM - 1 - c) % DMA_INTR_PRIO_LEVELS);
+    }
+
+    tgt_src.ptr            = (uint8_t *) test_data;
+    tgt_src.inc_d1_du      = 1;
+    tgt_src.trig           = DMA_TRIG_MEMORY;
+    tgt_src.type           = DMA_DATA_TYPE;
+
+    for (int c=0; c<DMA_CH_NUM; c++)
+    { 
+        tgt_dst[c].ptr            = (uint8_t *) copied_data_2D_DMA[c];
+        tgt_dst[c].inc_d1_du      = 1;
+        tgt_dst[c].trig           = DMA_TRIG_MEMORY;
+
+        trans[c].src            = &tgt_src;
+        trans[c].dst            = &tgt_dst[c];
+        trans[c].size_d1_du     = SIZE_EXTR_D1;
+        trans[c].mode           = DMA_TRANS_MODE_SINGLE;
+        trans[c].dim            = DMA_DIM_CONF_1D;
+        trans[c].dim_inv        = 0;
+        trans[c].pad_top_du     = 0;
+        trans[c].pad_bottom_du  = 0;
+        trans[c].pad_left_du    = 0;
+        trans[c].pad_right_du   = 0;
+        trans[c].win_du         = 0;
+        trans[c].end            = DMA_TRANS_END_INTR;
+        trans[c].channel        = c;
+
+        dma_validate_transaction(&trans[c], DMA_ENABLE_REALIGN, DMA_PERFORM_CHECKS_INTEGRITY);
+        dma_load_transaction(&trans[c]);
+    }
+
+    /* 
+     * Mask the DMA interrupt until every channel is done, so that they are all pending
+     * when the handler runs.
+     */
+    CSR_CLEAR_BITS(CSR_REG_MIE, DMA_CSR_REG_MIE_MASK);
+
+    for (int c=0; c<DMA_CH_NUM; c++)
+    { 
+        dma_launch(&trans[c]);
+    }
+
+    for (int c=0; c<DMA_CH_NUM; c++)
+    { 
+        while(!dma_is_ready(c));
+    }
+
+    CSR_SET_BITS(CSR_REG_MIE, DMA_CSR_REG_MIE_MASK);
+
+    /* Wait for the handler to serve all the channels */
+    while(trans_order_cnt < DMA_CH_NUM) {
+        CSR_CLEAR_BITS(CSR_REG_MSTATUS, 0x8);
+        if ( trans_order_cnt < DMA_CH_NUM ) {
+            wait_for_interrupt();
+        }
+        CSR_SET_BITS(CSR_REG_MSTATUS, 0x8);
+    }
+
+    /* Restore the default priority */
+    for (int c=0; c<DMA_CH_NUM; c++)
+    {
+        dma_set_intr_priority(c, 0);
+    }
+
+    #if EN_VERIF
+
+    /* Each channel is served before the lower priority ones, and before the higher channels of the same priority */
+    for (int n = 1; n < DMA_CH_NUM; n++)
+    {
+        uint8_t prev_prio = (DMA_CH_NUM - 1 - trans_order[n - 1]) % DMA_INTR_PRIO_LEVELS;
+        uint8_t prio = (DMA_CH_NUM - 1 - trans_order[n]) % DMA_INTR_PRIO_LEVELS;
+
+        if (prev_prio < prio || (prev_prio == prio && trans_order[n - 1] > trans_order[n]))
+        {
+            passed = 0;
+        }
+    }
+
+    /* Verify that every channel was served once and copied its data */
+    for (int c=0; c<DMA_CH_NUM; c++)
+    { 
+        if (transaction_flag[c] == 0)
+        {
+            passed = 0;
+        }
+        for (int i = 0; i < SIZE_EXTR_D1; i++) {
+            if (copied_data_2D_DMA[c][i] != test_data[i])
+            {
+                passed = 0;
+            }
+        }
+    }
+
+    if (passed) {
+        PRINTF("Success test 4\n\r");
+    } 
+    else 
+    {
+        PRINTF("Fail test 4\n\r");
+        for (int n = 0; n < DMA_CH_NUM; n++)
+        {
+            PRINTF("served %d: channel %d\n\r", n, trans_order[n]);
+        }
+        return EXIT_FAILURE;
+    }
+    #endif
+
+    #endif
+
     return EXIT_SUCCESS;
 }
\ No newline at end of file
@@ -8,7 +8,8 @@
 // Description: Example application to test the DMA SDK. Will copy
 //              a constant value in a buffer and then copy the content
 //              of the buffer into another. Will check that both transactions
-//              are performed correctly.
+//              are performed correctly. Also checks the parallel copy and
+//              a memory-to-memory ping-pong stream.
 
 #include <stdint.h>
 #include <stdio.h>              // For compatibility with OH Group compiler
@@ -40,6 +41,9 @@
 #define CONST_NEG_VALUE_16B -123
 #define CONST_VALUE_8B 123
 #define CONST_NEG_VALUE_8B -123
+#define PARALLEL_BUFFER_SIZE_32b 1024
+#define STREAM_BUFFER_SIZE_32b 256
+#define STREAM_BUFFER_NUM 2
 
 static uint32_t source_32b[SOURCE_BUFFER_SIZE_32b];
 static uint32_t destin_32b[SOURCE_BUFFER_SIZE_32b];
@@ -67,6 +71,13 @@ static int32_t neg_value_32b = CONST_NEG_VALUE_32B;
 static int16_t neg_value_16b = CONST_NEG_VALUE_16B;
 static int8_t neg_value_8b = CONST_NEG_VALUE_8B;
 
+static uint32_t parallel_source_32b[PARALLEL_BUFFER_SIZE_32b];
+static uint32_t parallel_destin_32b[PARALLEL_BUFFER_SIZE_32b];
+
+static uint32_t stream_source_32b[STREAM_BUFFER_NUM * STREAM_BUFFER_SIZE_32b];
+static uint32_t stream_buffers_32b[STREAM_BUFFER_NUM * STREAM_BUFFER_SIZE_32b];
+static dma_stream_t stream;
+
 uint32_t i;
 uint32_t errors = 0;
 
@@ -106,6 +117,51 @@ int main()
         errors += destin_32b[i] != CONST_VALUE_32B;
     }
 
+    for (i = 0; i < PARALLEL_BUFFER_SIZE_32b; i++)
+    {
+        parallel_source_32b[i] = i;
+    }
+    uint8_t channels = dma_copy_parallel((uint32_t)parallel_destin_32b, (uint32_t)parallel_source_32b, PARALLEL_BUFFER_SIZE_32b, DMA_DATA_TYPE_WORD);
+    PRINTF("Parallel copy on %d channels\n\r", channels);
+    errors += channels == 0;
+
+    for (i = 0; i < PARALLEL_BUFFER_SIZE_32b; i++)
+    {
+        errors += parallel_destin_32b[i] != i;
+    }
+
+    // Memory-to-memory stream: the DMA copies the source into the ring over and over
+    for (i = 0; i < STREAM_BUFFER_NUM * STREAM_BUFFER_SIZE_32b; i++)
+    {
+        stream_source_32b[i] = i;
+    }
+    stream.src_ptr = (uint32_t)stream_source_32b;
+    stream.src_trig = DMA_TRIG_MEMORY;
+    stream.buffers = (uint8_t *)stream_buffers_32b;
+    stream.buf_size = STREAM_BUFFER_SIZE_32b * sizeof(uint32_t);
+    stream.buf_num = STREAM_BUFFER_NUM;
+    stream.type = DMA_DATA_TYPE_WORD;
+    stream.channel = 0;
+    stream.callback = NULL;
+    errors += dma_stream_start(&stream) != DMA_CONFIG_OK;
+
+    // A buffer holds the part of the source matching its place in the ring
+    uint32_t *buffer = (uint32_t *)dma_stream_get(&stream);
+    uint32_t offset = (buffer - stream_buffers_32b);
+    for (i = 0; i < STREAM_BUFFER_SIZE_32b; i++)
+    {
+        errors += buffer[i] != offset + i;
+    }
+
+    // Let the DMA wrap around the ring: the buffers in between are counted as overruns
+    while (stream.filled < stream.consumed + STREAM_BUFFER_NUM + 1);
+    buffer = (uint32_t *)dma_stream_get(&stream);
+    PRINTF("Stream: %d buffers filled, %d overruns\n\r", stream.filled, stream.overruns);
+    errors += stream.overruns == 0;
+    errors += stream.consumed - stream.overruns != 2;
+
+    dma_stream_stop(&stream);
+
     PRINTF("Errors:%d\n\r", errors);
 
     return errors ? EXIT_FAILURE : EXIT_SUCCESS;
@@ -0,0 +1,171 @@
+/**
+ * @file main.c
+ * @brief Log-structured record storage example using BSP
+ *
+ * Simple example that appends records to a log stored in a flash region, until
+ * the region wraps around and the oldest records are dropped. The log is then
+ * reopened with w25q_log_init(), as after a reset, and the records still
+ * stored are read back and checked. Finally the statistics of the log, with
+ * the erase counts of its sectors, are printed.
+ *
+ * On FPGA the flash keeps the log between two runs, so the second run finds
+ * the records of the first one when it opens the log.
+ *
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "x-heep.h"
+#include "w25q128jw.h"
+#include "w25q_log.h"
+
+/* By default, PRINTFs are activated for FPGA and disabled for simulation. */
+#define PRINTF_IN_FPGA  1
+#define PRINTF_IN_SIM   0
+
+#if TARGET_SIM && PRINTF_IN_SIM
+    #define PRINTF(fmt, ...)    printf(fmt, ## __VA_ARGS__)
+#elif PRINTF_IN_FPGA && !TARGET_SIM
+    #define PRINTF(fmt, ...)    printf(fmt, ## __VA_ARGS__)
+#else
+    #define PRINTF(...)
+#endif
+
+// Flash region of the log, far from the program loaded at the start of the flash
+#define LOG_BASE       ((FLASH_MEM_SIZE / 2) & ~(FLASH_SECTOR_SIZE - 1))
+#define LOG_SECTORS    4
+#define LOG_BUFFER     (2 * FLASH_PAGE_SIZE)
+
+// Enough records to fill the region more than once, the spare sector excluded
+#define NUM_RECORDS    400
+#define MAX_RECORD_LEN 100
+
+// Index and write buffer of the log
+w25q_log_sector_t log_sectors[LOG_SECTORS];
+uint32_t log_buffer[LOG_BUFFER / 4];
+
+uint8_t record_data[MAX_RECORD_LEN];
+uint8_t read_data[MAX_RECORD_LEN];
+
+// Fill a record with data derived from its number, so that it can be checked
+uint32_t make_record(uint32_t record, uint8_t *data);
+
+// Open the log, with the index rebuilt from the flash
+w25q_error_codes_t open_log(w25q_log_t *log);
+
+int main(int argc, char *argv[]) {
+    // Initialize the DMA
+    dma_init(NULL);
+
+    soc_ctrl_t soc_ctrl;
+    soc_ctrl.base_addr = mmio_region_from_addr((uintptr_t)SOC_CTRL_START_ADDRESS);
+
+    if ( get_spi_flash_mode(&soc_ctrl) == SOC_CTRL_SPI_FLASH_MODE_SPIMEMIO ) {
+        PRINTF("This application cannot work with the memory mapped SPI FLASH"
+            "module - do not use the FLASH_EXEC linker script for this application\n");
+        return EXIT_SUCCESS;
+    }
+
+    PRINTF("BSP flash log test\n");
+
+    // Pick the correct spi device based on simulation type
+    spi_host_t* spi;
+    spi = spi_flash;
+
+    // Init SPI host and SPI<->Flash bridge parameters
+    if (w25q128jw_init(spi) != FLASH_OK) return EXIT_FAILURE;
+
+    w25q_log_t log;
+    w25q_log_stats_t stats;
+
+    if (open_log(&log) != FLASH_OK) {
+        PRINTF("Error opening the log\n");
+        return EXIT_FAILURE;
+    }
+    w25q_log_get_stats(&log, &stats);
+    PRINTF("Opened the log: %u records, from %u\n", stats.num_records, stats.first_record);
+
+    // Append the records, the oldest ones are dropped as the region wraps around
+    uint32_t first = 0;
+    for (uint32_t i = 0; i < NUM_RECORDS; i++) {
+        uint32_t record;
+        uint32_t length = make_record(log.next_record, record_data);
+        if (w25q_log_append(&log, record_data, length, &record) != FLASH_OK) {
+            PRINTF("Error appending record %u\n", i);
+            return EXIT_FAILURE;
+        }
+        if (i == 0) first = record;
+        // Let the log program the full pages while the application is idle
+        w25q_log_poll(&log);
+    }
+    uint32_t last = first + NUM_RECORDS - 1;
+
+    if (w25q_log_sync(&log) != FLASH_OK) return EXIT_FAILURE;
+    PRINTF("Appended records %u to %u\n", first, last);
+
+    // Reopen the log from the flash only, as after a reset
+    if (open_log(&log) != FLASH_OK) {
+        PRINTF("Error reopening the log\n");
+        return EXIT_FAILURE;
+    }
+    w25q_log_get_stats(&log, &stats);
+
+    int32_t errors = 0;
+
+    // The records appended last must all be there, and the older ones dropped
+    if (stats.num_records == 0 || stats.first_record + stats.num_records != last + 1) {
+        PRINTF("Expected records up to %u, found %u from %u\n", last, stats.num_records, stats.first_record);
+        errors++;
+    }
+    if (stats.first_record <= first) {
+        PRINTF("The region should have wrapped around\n");
+        errors++;
+    }
+
+    // Read back the records still stored
+    for (uint32_t record = stats.first_record; record <= last && errors == 0; record++) {
+        uint32_t length;
+        uint32_t expected = make_record(record, record_data);
+        if (w25q_log_read(&log, record, read_data, sizeof(read_data), &length) != FLASH_OK) {
+            PRINTF("Error reading record %u\n", record);
+            errors++;
+            break;
+        }
+        if (length != expected || memcmp(read_data, record_data, length) != 0) {
+            PRINTF("Record %u differs\n", record);
+            errors++;
+        }
+    }
+
+    PRINTF("Records:      %u, from %u\n", stats.num_records, stats.first_record);
+    PRINTF("Erase counts: min %u, max %u, total %u\n", stats.erase_min, stats.erase_max, stats.erase_total);
+
+    PRINTF("\n--------TEST FINISHED--------\n");
+    if (errors == 0) {
+        PRINTF("All tests passed!\n");
+        return EXIT_SUCCESS;
+    } else {
+        PRINTF("Some tests failed!\n");
+        return EXIT_FAILURE;
+    }
+}
+
+uint32_t make_record(uint32_t record, uint8_t *data) {
+    uint32_t length = 1 + (record * 7) % MAX_RECORD_LEN;
+    for (uint32_t i = 0; i < length; i++) {
+        data[i] = (uint8_t)(record + i);
+    }
+    return length;
+}
+
+w25q_error_codes_t open_log(w25q_log_t *log) {
+    log->base = LOG_BASE;
+    log->num_sectors = LOG_SECTORS;
+    log->sectors = log_sectors;
+    log->buffer = (uint8_t *)log_buffer;
+    log->buffer_size = LOG_BUFFER;
+    return w25q_log_init(log);
+}
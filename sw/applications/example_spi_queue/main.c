@@ -0,0 +1,218 @@
+/**
+ * @file main.c
+ * @brief Example of queued SPI transactions using the SDK
+ *
+ * Queues transactions for two slaves on different chip selects of the SPI
+ * FLASH device: reads of the flash (chip select 0) and short writes to a
+ * second slave (chip select 1, which needs not be connected). The interrupts
+ * are kept disabled while queuing, so that the queue fills up until
+ * spi_execute_queued() returns SPI_CODE_QUEUE_FULL. Once they are enabled, the
+ * transactions run one after the other from the SPI interrupt.
+ *
+ * The example checks that each transaction called its own callback, in the
+ * order in which they were queued, and that the queued reads got the same data
+ * as a blocking read of the flash.
+ *
+ * The flash device being used is the w25q128jw
+ *
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "x-heep.h"
+#include "core_v_mini_mcu.h"
+#include "spi_sdk.h"
+
+#include "fast_intr_ctrl.h"
+#include "csr.h"
+#include "csr_registers.h"
+
+/* By default, PRINTFs are activated for FPGA and disabled for simulation. */
+#define PRINTF_IN_FPGA  1
+#define PRINTF_IN_SIM   0
+
+#if TARGET_SIM && PRINTF_IN_SIM
+        #define PRINTF(fmt, ...)    printf(fmt, ## __VA_ARGS__)
+#elif TARGET_IS_FPGA && PRINTF_IN_FPGA
+    #define PRINTF(fmt, ...)    printf(fmt, ## __VA_ARGS__)
+#else
+    #define PRINTF(...)
+#endif
+
+// =========================== VARS & DEFS ==================================
+
+// Flash w25q128jw SPI commands
+#define FC_RD      0x03 /** Read Data */
+
+#define READ_LEN       256                          // Amount bytes of each read
+#define READ_ADDRESS   ((FLASH_MEM_SIZE / 2) + 256) // Flash address where to read
+#define FLASH_MAX_FREQ (133*1000*1000)  // Device max spi frequency
+#define SLAVE_B_FREQ   (10*1000*1000)   // Second slave max spi frequency
+#define FIC_FLASH_MEIE 21               // SPI Flash fast interrupt bit enable
+#define CSR_INTR_EN    0x08             // CPU Global interrupt enable
+
+// One more transaction than the queue length fits: the first one is launched
+// right away and leaves the queue.
+#define TXN_NUM        (SPI_QUEUE_LEN + 1)
+#define TXN_IS_READ(k) ((k) % 2 == 0)   // Even transactions read the flash
+
+// Command word of each transaction (also used to identify it in the callbacks)
+uint32_t cmd[TXN_NUM];
+// Data read by the queued transactions and by the blocking read
+uint32_t rxbuffer[TXN_NUM][READ_LEN / 4];
+uint32_t golden[READ_LEN / 4];
+
+// Filled by the callbacks, from the SPI interrupt
+volatile uint32_t done_cnt  = 0;
+volatile uint32_t error_cnt = 0;
+uint32_t order[TXN_NUM];
+uint32_t wrong_cb = 0;
+
+// ====================== PROTOTYPES ======================
+
+void read_done_cb(const uint32_t* txbuff, uint32_t txlen, uint32_t* rxbuff, uint32_t rxlen);
+void write_done_cb(const uint32_t* txbuff, uint32_t txlen, uint32_t* rxbuff, uint32_t rxlen);
+void error_cb(const uint32_t* txbuff, uint32_t txlen, uint32_t* rxbuff, uint32_t rxlen);
+
+// ========================= MAIN =========================
+
+int main(int argc, char *argv[]) {
+    // Create our two slaves, on different chip selects and with different speeds
+    spi_slave_t slave_a = SPI_SLAVE(0, FLASH_MAX_FREQ);
+    spi_slave_t slave_b = SPI_SLAVE(1, SLAVE_B_FREQ);
+
+    // Both are connected to the same spi device
+    spi_t spi_a = spi_init(SPI_IDX_FLASH, slave_a);
+    spi_t spi_b = spi_init(SPI_IDX_FLASH, slave_b);
+
+    // Check if initialization succeeded
+    if (!spi_a.init || !spi_b.init) {
+        PRINTF("\nFailed to initialize spi\n");
+        return EXIT_FAILURE;
+    }
+
+    PRINTF("\nSPI initialized\n");
+
+    // Segments of the transactions, which must stay valid until they are over
+    spi_segment_t read_segments[2] = { SPI_SEG_TX(4), SPI_SEG_RX(READ_LEN) };
+    spi_segment_t write_segments[1] = { SPI_SEG_TX(4) };
+
+    spi_callbacks_t read_callbacks = {
+        .done_cb  = &read_done_cb,
+        .error_cb = &error_cb,
+        .rxwm_cb  = NULL,
+        .txwm_cb  = NULL
+    };
+    spi_callbacks_t write_callbacks = {
+        .done_cb  = &write_done_cb,
+        .error_cb = &error_cb,
+        .rxwm_cb  = NULL,
+        .txwm_cb  = NULL
+    };
+
+    // Flash uses Big Endian, CPU Little Endian, hence swap bytes
+    const uint32_t read_byte_cmd = ((bitfield_byteswap32(READ_ADDRESS & 0x00ffffff)) | FC_RD);
+
+    // Reference data, read with a blocking transaction
+    spi_codes_e error = spi_execute(&spi_a, read_segments, 2, &read_byte_cmd, golden);
+    if (error) {
+        PRINTF("Blocking read FAILED! Error Code: %i\n", error);
+        return EXIT_FAILURE;
+    }
+
+    // Set mie.MEIE bit to one to enable machine-level fast spi_flash interrupt,
+    // but keep the global interrupt disabled so that no transaction ends while
+    // queuing.
+    CSR_CLEAR_BITS(CSR_REG_MSTATUS, CSR_INTR_EN);
+    const uint32_t mask = 1 << FIC_FLASH_MEIE;
+    CSR_SET_BITS(CSR_REG_MIE, mask);
+
+    uint32_t queued = 0;
+    for (int k = 0; k < TXN_NUM; k++)
+    {
+        if (TXN_IS_READ(k)) {
+            cmd[k] = read_byte_cmd;
+            error = spi_execute_queued(&spi_a, read_segments, 2, &cmd[k],
+                                       rxbuffer[k], read_callbacks);
+        }
+        else {
+            cmd[k] = 0xA5000000 | k;
+            error = spi_execute_queued(&spi_b, write_segments, 1, &cmd[k],
+                                       NULL, write_callbacks);
+        }
+        if (error) {
+            PRINTF("Queuing FAILED! Error Code: %i\n", error);
+            return EXIT_FAILURE;
+        }
+        queued++;
+    }
+
+    PRINTF("Queued %i transactions\n", queued);
+
+    // The queue is full, one more transaction must be refused
+    const uint32_t extra_cmd = 0xA5FFFFFF;
+    error = spi_execute_queued(&spi_b, write_segments, 1, &extra_cmd, NULL, write_callbacks);
+    if (error != SPI_CODE_QUEUE_FULL) {
+        PRINTF("The queue should be full after %i transactions, got code %i\n", TXN_NUM, error);
+        return EXIT_FAILURE;
+    }
+
+    // Let the transactions run
+    CSR_SET_BITS(CSR_REG_MSTATUS, CSR_INTR_EN);
+
+    while (done_cnt + error_cnt < queued) {
+        CSR_CLEAR_BITS(CSR_REG_MSTATUS, CSR_INTR_EN);
+        if (done_cnt + error_cnt < queued) {
+            wait_for_interrupt();
+        }
+        CSR_SET_BITS(CSR_REG_MSTATUS, CSR_INTR_EN);
+    }
+
+    // Each transaction called the callbacks of its slave, in the queue order
+    bool passed = error_cnt == 0 && wrong_cb == 0;
+    for (int k = 0; k < TXN_NUM; k++)
+    {
+        if (order[k] != k) {
+            PRINTF("Transaction %i ended in position %i\n", order[k], k);
+            passed = false;
+        }
+        if (TXN_IS_READ(k) && memcmp(rxbuffer[k], golden, READ_LEN)) {
+            PRINTF("Transaction %i read wrong data\n", k);
+            passed = false;
+        }
+    }
+
+    if (passed) PRINTF("\nSUCCESS\n\n");
+    else {
+        PRINTF("\nFAILED: %i errors, %i wrong callbacks\n\n", error_cnt, wrong_cb);
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+// ========================= FUNCTIONS =========================
+
+void read_done_cb(const uint32_t* txbuff, uint32_t txlen, uint32_t* rxbuff, uint32_t rxlen) {
+    const uint32_t k = txbuff - cmd;
+    if (k >= TXN_NUM || !TXN_IS_READ(k) || rxbuff != rxbuffer[k] || rxlen != READ_LEN / 4) wrong_cb++;
+    if (done_cnt < TXN_NUM) order[done_cnt] = k;
+    done_cnt++;
+}
+
+void write_done_cb(const uint32_t* txbuff, uint32_t txlen, uint32_t* rxbuff, uint32_t rxlen) {
+    const uint32_t k = txbuff - cmd;
+    if (k >= TXN_NUM || TXN_IS_READ(k) || rxbuff != NULL || txlen != 1) wrong_cb++;
+    if (done_cnt < TXN_NUM) order[done_cnt] = k;
+    done_cnt++;
+}
+
+void error_cb(const uint32_t* txbuff, uint32_t txlen, uint32_t* rxbuff, uint32_t rxlen) {
+    PRINTF("\x1b[31mTXN ERROR CALLBACK with txlen: %i, rxlen: %i\x1b[m\n", txlen, rxlen);
+    error_cnt++;
+}
+
+// ========================= THE END =========================
@@ -62,6 +62,9 @@ extern "C" {
 /* For word swap operations*/
 #include "bitfield.h"
 
+/* To wait for the stream chunks */
+#include "hart.h"
+
 /****************************************************************************/
 /**                                                                        **/
 /*                        DEFINITIONS AND MACROS                            */
@@ -186,6 +189,42 @@ static void flash_write_enable(void);
 */
 static w25q_error_codes_t w25q128jw_sanity_checks(uint32_t addr, uint8_t *data, uint32_t length);
 
+/**
+ * @brief Launch the DMA transfer of the next chunk of a stream, if the DMA is
+ * idle and a buffer of the ring is free.
+ *
+ * It must be called with the interrupts disabled or from the DMA interrupt.
+ * If the DMA refuses the transfer, the error of the stream is set and the
+ * stream stops.
+ *
+ * @param stream pointer to the stream.
+ * @return FLASH_OK if the chunk was launched or has to wait, FLASH_ERROR_DMA otherwise.
+*/
+static w25q_error_codes_t stream_launch(w25q_stream_t *stream);
+
+/**
+ * @brief DMA transaction done callback of the stream channel.
+ *
+ * @param channel the DMA channel.
+*/
+static void stream_chunk_done(uint8_t channel);
+
+/**
+ * @brief Release the oldest chunk of a stream and launch the next one.
+ *
+ * @param stream pointer to the stream.
+*/
+static void stream_release(w25q_stream_t *stream);
+
+/**
+ * @brief Length of a chunk of a stream, the last one can be shorter.
+ *
+ * @param stream pointer to the stream.
+ * @param chunk index of the chunk since the start of the stream.
+ * @return the length of the chunk in bytes.
+*/
+static uint32_t stream_chunk_length(w25q_stream_t *stream, uint32_t chunk);
+
 /**
  * @brief Return the minimum between two numbers.
  *
@@ -220,6 +259,19 @@ spi_host_t* __attribute__((section(".xheep_init_data_crt0"))) spi; //this variab
 */
 uint8_t sector_data[FLASH_SECTOR_SIZE];
 
+/**
+ * @brief DMA channel used by the DMA functions, set with w25q128jw_set_dma_channel().
+*/
+static uint8_t dma_channel = 0;
+
+/**
+ * @brief Stream being read, NULL if none.
+ *
+ * The flash serves a single read command at a time, so a single stream
+ * can run at a time.
+*/
+static w25q_stream_t *stream_active = NULL;
+
 
 /****************************************************************************/
 /**                                                                        **/
@@ -284,7 +336,7 @@ w25q_error_codes_t w25q128jw_read(uint32_t addr, void *data, uint32_t length) {
         if (status != FLASH_OK) return status;
     } else {
         // Wait DMA to be free
-        while(!dma_is_ready(0));
+        while(!dma_is_ready(dma_channel));
         status = w25q128jw_read_quad_dma(addr, data, length);
         if (status != FLASH_OK) return status;
     }
@@ -303,7 +355,7 @@ w25q_error_codes_t w25q128jw_write(uint32_t addr, void *data, uint32_t length, u
         status = erase_and_write(addr, data, length);
     } else {
         // Wait DMA to be free
-        while(!dma_is_ready(0));
+        while(!dma_is_ready(dma_channel));
         status = w25q128jw_write_quad_dma(addr, data, length);
     }
 
@@ -522,6 +574,7 @@ w25q_error_codes_t w25q128jw_read_standard_dma(uint32_t addr, void *data, uint32
     };
     // Size is in data units (words in this case)
     trans.size_d1_du = length>>2;
+    trans.channel = dma_channel;
 
     // Validate, load and launch DMA transaction
 
@@ -558,7 +611,7 @@ w25q_error_codes_t w25q128jw_read_standard_dma(uint32_t addr, void *data, uint32
     spi_wait_for_ready(spi);
 
     // Wait for DMA to finish transaction
-    if(!no_wait_init_dma) while(!dma_is_ready(0));
+    if(!no_wait_init_dma) while(!dma_is_ready(dma_channel));
 
     // Take into account the extra bytes (if any)
     if (length % 4 != 0) {
@@ -624,6 +677,7 @@ w25q_error_codes_t w25q128jw_read_standard_dma_async(uint32_t addr, void *data,
     };
     // Size is in data units (words in this case)
     trans.size_d1_du = length>>2;
+    trans.channel = dma_channel;
     // Validate, load and launch DMA transaction
     dma_config_flags_t res;
     res = dma_validate_transaction(&trans, DMA_ENABLE_REALIGN, DMA_PERFORM_CHECKS_INTEGRITY );
@@ -1015,6 +1069,7 @@ w25q_error_codes_t w25q128jw_read_quad_dma(uint32_t addr, void *data, uint32_t l
     };
     // Size is in data units (words in this case)
     trans.size_d1_du = length>>2;
+    trans.channel = dma_channel;
 
     // Validate, load and launch DMA transaction
     dma_config_flags_t res;
@@ -1023,7 +1078,7 @@ w25q_error_codes_t w25q128jw_read_quad_dma(uint32_t addr, void *data, uint32_t l
     res = dma_launch(&trans);
 
     // Wait for DMA to finish transaction
-    while(!dma_is_ready(0));
+    while(!dma_is_ready(dma_channel));
 
     // Take into account the extra bytes (if any)
     if (length % 4 != 0) {
@@ -1137,6 +1192,7 @@ w25q_error_codes_t w25q128jw_read_quad_dma_async(uint32_t addr, void *data, uint
     };
     // Size is in data units (words in this case)
     trans.size_d1_du = length>>2;
+    trans.channel = dma_channel;
 
     // Validate, load and launch DMA transaction
     dma_config_flags_t res;
@@ -1149,7 +1205,7 @@ w25q_error_codes_t w25q128jw_read_quad_dma_async(uint32_t addr, void *data, uint
 
 void w25q128jw_wait_quad_dma_async(void *data, uint32_t length){
     // Wait for DMA to finish transaction
-    while(!dma_is_ready(0));
+    while(!dma_is_ready(dma_channel));
 
     // Take into account the extra bytes (if any)
     if (length % 4 != 0) {
@@ -1212,7 +1268,136 @@ w25q_error_codes_t w25q128jw_erase_and_write_quad_dma(uint32_t addr, void *data,
 
 }
 
+void w25q128jw_set_dma_channel(uint8_t channel) {
+    dma_channel = channel;
+}
+
+w25q_error_codes_t w25q128jw_stream_start(w25q_stream_t *stream, uint32_t addr, uint32_t length) {
+    // Sanity checks
+    if (w25q128jw_sanity_checks(addr, stream->buffers, length) != FLASH_OK) return FLASH_ERROR;
+    if (stream_active != NULL || stream->num_buffers < 2 || stream->channel >= DMA_CH_NUM) return FLASH_ERROR;
+    if (stream->chunk_size == 0 || stream->chunk_size % 4 != 0 || (stream->chunk_size >> 2) > DMA_SIZE_D1_SIZE_MASK) return FLASH_ERROR;
+
+    stream->length = length;
+    stream->num_chunks = (length + stream->chunk_size - 1) / stream->chunk_size;
+    stream->launched = 0;
+    stream->landed = 0;
+    stream->released = 0;
+    stream->held = 0;
+    stream->error = 0;
+
+    /*
+     * SET UP DMA
+     * The chunk transaction is compiled once and relaunched by the DMA
+     * interrupt with only the destination and the size changed.
+    */
+    // SPI and SPI_FLASH are the same IP so same register map
+    dma_target_t tgt_src = {
+        .ptr = (uint8_t*)((uintptr_t)spi + SPI_HOST_RXDATA_REG_OFFSET), // Target is SPI RX FIFO
+        .inc_d1_du = 0, // Target is peripheral, no increment
+        .type = DMA_DATA_TYPE_WORD, // Data type is word
+        .trig = DMA_TRIG_SLOT_SPI_FLASH_RX, // Wait for the SPI FLASH RX FIFO valid signal
+    };
+    dma_target_t tgt_dst = {
+        .ptr = stream->buffers, // Target is the first buffer of the ring
+        .inc_d1_du = 1, // Increment by 1 data unit (word)
+        .type = DMA_DATA_TYPE_WORD, // Data type is word
+        .trig = DMA_TRIG_MEMORY, // Read-write operation to memory
+    };
+    dma_trans_t trans = {
+        .src = &tgt_src,
+        .dst = &tgt_dst,
+        .size_d1_du = stream->chunk_size >> 2,
+        .src_type = DMA_DATA_TYPE_WORD,
+        .dst_type = DMA_DATA_TYPE_WORD,
+        .mode = DMA_TRANS_MODE_SINGLE,
+        .end = DMA_TRANS_END_INTR,
+        .channel = stream->channel,
+    };
+    if (dma_validate_transaction(&trans, DMA_DO_NOT_ENABLE_REALIGN, DMA_PERFORM_CHECKS_INTEGRITY) & DMA_CONFIG_CRITICAL_ERROR) return FLASH_ERROR_DMA;
+    if (dma_compile_transaction(&trans, &stream->img) != DMA_CONFIG_OK) return FLASH_ERROR_DMA;
+    if (!dma_is_ready(stream->channel)) return FLASH_ERROR_DMA;
+
+    /*
+     * The chunks are launched from the interrupt handler, where the global
+     * interrupt enable must not be set again: the interrupts are enabled
+     * once here instead of by each launch.
+    */
+    stream->img.end = DMA_TRANS_END_POLLING;
+
+    /*
+     * Read the whole region with a single command, rounded up to words as
+     * the DMA only moves words. The SPI host stops clocking the flash when
+     * its RX FIFO is full, so the flash simply waits while all the buffers
+     * are in use.
+    */
+    if (w25q128jw_read_quad_setup(addr, stream->buffers, (length + 3) & ~3) == NULL) return FLASH_ERROR;
+
+    stream_active = stream;
+    dma_set_trans_done_callback(stream->channel, stream_chunk_done);
+
+    // The global interrupt enable is left as the caller set it
+    uint32_t mstatus;
+    CSR_READ(CSR_REG_MSTATUS, &mstatus);
+    CSR_SET_BITS(CSR_REG_MIE, DMA_DONE_CSR_REG_MIE_MASK);
+    CSR_CLEAR_BITS(CSR_REG_MSTATUS, 0x8);
+    w25q_error_codes_t status = stream_launch(stream);
+    if (status != FLASH_OK) {
+        dma_set_trans_done_callback(stream->channel, NULL);
+        stream_active = NULL;
+    }
+    if (mstatus & 0x8) CSR_SET_BITS(CSR_REG_MSTATUS, 0x8);
+
+    return status;
+}
+
+uint8_t *w25q128jw_stream_get(w25q_stream_t *stream, uint32_t *length) {
+    // The global interrupt enable is restored as the caller set it
+    uint32_t mstatus;
+    CSR_READ(CSR_REG_MSTATUS, &mstatus);
+
+    // The chunk returned by the previous call goes back to the ring
+    if (stream->held) {
+        CSR_CLEAR_BITS(CSR_REG_MSTATUS, 0x8);
+        stream->held = 0;
+        stream_release(stream);
+        if (mstatus & 0x8) CSR_SET_BITS(CSR_REG_MSTATUS, 0x8);
+    }
+
+    if (stream->released == stream->num_chunks) return NULL;
+
+    // Wait for the next chunk to land, which needs the DMA interrupt. No chunk
+    // is coming once the DMA has refused one.
+    while (stream->landed == stream->released && !stream->error) {
+        CSR_CLEAR_BITS(CSR_REG_MSTATUS, 0x8);
+        if (stream->landed == stream->released && !stream->error) {
+            wait_for_interrupt();
+        }
+        CSR_SET_BITS(CSR_REG_MSTATUS, 0x8);
+    }
+    if (!(mstatus & 0x8)) CSR_CLEAR_BITS(CSR_REG_MSTATUS, 0x8);
+    if (stream->landed == stream->released) return NULL;
+
+    stream->held = 1;
+    if (length != NULL) *length = stream_chunk_length(stream, stream->released);
+    return stream->buffers + (stream->released % stream->num_buffers) * stream->chunk_size;
+}
+
+uint8_t w25q128jw_stream_done(w25q_stream_t *stream) {
+    return stream->released == stream->num_chunks;
+}
+
 w25q_error_codes_t w25q128jw_4k_erase(uint32_t addr) {
+    // Issue the erase
+    if (w25q128jw_4k_erase_async(addr) != FLASH_OK) return FLASH_ERROR;
+
+    // Wait for the erase operation to be finished
+    flash_wait();
+
+    return FLASH_OK;
+}
+
+w25q_error_codes_t w25q128jw_4k_erase_async(uint32_t addr) {
     // Sanity checks
     if (addr > MAX_FLASH_ADDR || addr < 0) return FLASH_ERROR;
 
@@ -1235,8 +1420,36 @@ w25q_error_codes_t w25q128jw_4k_erase(uint32_t addr) {
     spi_set_command(spi, cmd_erase);
     spi_wait_for_ready(spi);
 
-    // Wait for the erase operation to be finished
-    flash_wait();
+    return FLASH_OK;
+}
+
+uint8_t w25q128jw_is_busy(void) {
+    spi_set_rx_watermark(spi,1);
+    uint8_t flash_resp[4] = {0xff,0xff,0xff,0xff};
+
+    uint32_t flash_cmd = FC_RSR1; // [CMD] Read status register 1
+    spi_write_word(spi, flash_cmd); // Push TX buffer
+    uint32_t spi_status_cmd = spi_create_command((spi_command_t){
+        .len        = 0,
+        .csaat      = true,
+        .speed      = SPI_SPEED_STANDARD,
+        .direction  = SPI_DIR_TX_ONLY
+    });
+    uint32_t spi_status_read_cmd = spi_create_command((spi_command_t){
+        .len        = 0,
+        .csaat      = false,
+        .speed      = SPI_SPEED_STANDARD,
+        .direction  = SPI_DIR_RX_ONLY
+    });
+    spi_set_command(spi, spi_status_cmd);
+    spi_wait_for_ready(spi);
+    spi_set_command(spi, spi_status_read_cmd);
+    spi_wait_for_ready(spi);
+    spi_wait_for_rx_watermark(spi);
+    spi_read_word(spi, (uint32_t *)flash_resp);
+
+    // BUSY is bit 0 of status register 1
+    return flash_resp[0] & 0x01;
 }
 
 w25q_error_codes_t w25q128jw_32k_erase(uint32_t addr) {
@@ -1474,33 +1687,7 @@ static void configure_spi(void) {
 }
 
 static void flash_wait(void) {
-    spi_set_rx_watermark(spi,1);
-    bool flash_busy = true;
-    uint8_t flash_resp[4] = {0xff,0xff,0xff,0xff};
-
-    while(flash_busy){
-        uint32_t flash_cmd = FC_RSR1; // [CMD] Read status register 1
-        spi_write_word(spi, flash_cmd); // Push TX buffer
-        uint32_t spi_status_cmd = spi_create_command((spi_command_t){
-            .len        = 0,
-            .csaat      = true,
-            .speed      = SPI_SPEED_STANDARD,
-            .direction  = SPI_DIR_TX_ONLY
-        });
-        uint32_t spi_status_read_cmd = spi_create_command((spi_command_t){
-            .len        = 0,
-            .csaat      = false,
-            .speed      = SPI_SPEED_STANDARD,
-            .direction  = SPI_DIR_RX_ONLY
-        });
-        spi_set_command(spi, spi_status_cmd);
-        spi_wait_for_ready(spi);
-        spi_set_command(spi, spi_status_read_cmd);
-        spi_wait_for_ready(spi);
-        spi_wait_for_rx_watermark(spi);
-        spi_read_word(spi, (uint32_t *)flash_resp);
-        if ((flash_resp[0] & 0x01) == 0) flash_busy = false;
-    }
+    while (w25q128jw_is_busy());
 }
 
 static void flash_reset(void) {
@@ -1710,6 +1897,7 @@ static w25q_error_codes_t dma_send_toflash(uint8_t *data, uint32_t length) {
     };
     // Size is in data units (words in this case)
     trans.size_d1_du = length>>2;
+    trans.channel = dma_channel;
 
     // Validate, load and launch DMA transaction
     dma_config_flags_t res;
@@ -1721,7 +1909,7 @@ static w25q_error_codes_t dma_send_toflash(uint8_t *data, uint32_t length) {
     if (res != DMA_CONFIG_OK) return FLASH_ERROR_DMA;
 
     // Wait for DMA to finish transaction
-    while(!dma_is_ready(0));
+    while(!dma_is_ready(dma_channel));
 
     // Take into account the extra bytes (if any)
     if (length % 4 != 0) {
@@ -1745,6 +1933,60 @@ static void flash_write_enable(void) {
     spi_wait_for_ready(spi);
 }
 
+static w25q_error_codes_t stream_launch(w25q_stream_t *stream) {
+    if (stream->error) return FLASH_ERROR_DMA;
+    // All the chunks requested, DMA busy or no free buffer
+    if (stream->launched == stream->num_chunks) return FLASH_OK;
+    if (stream->launched != stream->landed) return FLASH_OK;
+    if (stream->launched - stream->released >= stream->num_buffers) return FLASH_OK;
+
+    uint8_t *dst = stream->buffers + (stream->launched % stream->num_buffers) * stream->chunk_size;
+    uint32_t words = (stream_chunk_length(stream, stream->launched) + 3) >> 2;
+
+    // The interrupts are disabled, so the chunk cannot land before it is counted
+    if (dma_launch_image(&stream->img, NULL, dst, words) != DMA_CONFIG_OK) {
+        stream->error = 1;
+        return FLASH_ERROR_DMA;
+    }
+    stream->launched++;
+    return FLASH_OK;
+}
+
+static void stream_chunk_done(uint8_t channel) {
+    w25q_stream_t *stream = stream_active;
+    (void)channel;
+
+    stream->landed++;
+
+    // In callback mode the chunk is released as soon as the callback returns
+    if (stream->callback != NULL) {
+        uint32_t chunk = stream->landed - 1;
+        stream->callback(stream,
+                         stream->buffers + (chunk % stream->num_buffers) * stream->chunk_size,
+                         stream_chunk_length(stream, chunk));
+        stream_release(stream);
+    } else {
+        stream_launch(stream);
+    }
+}
+
+static void stream_release(w25q_stream_t *stream) {
+    stream->released++;
+
+    // Last chunk consumed: the SPI command is over and the flash is free
+    if (stream->released == stream->num_chunks) {
+        dma_set_trans_done_callback(stream->channel, NULL);
+        stream_active = NULL;
+        return;
+    }
+
+    stream_launch(stream);
+}
+
+static uint32_t stream_chunk_length(w25q_stream_t *stream, uint32_t chunk) {
+    return MIN(stream->chunk_size, stream->length - chunk * stream->chunk_size);
+}
+
 static w25q_error_codes_t w25q128jw_sanity_checks(uint32_t addr, uint8_t *data, uint32_t length) {
     // Check if address is out of range
     if (addr > MAX_FLASH_ADDR || addr < 0) return FLASH_ERROR;
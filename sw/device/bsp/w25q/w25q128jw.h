@@ -37,6 +37,7 @@
 #include "spi_host.h"
 #include "soc_ctrl.h"
 #include "core_v_mini_mcu.h"
+#include "dma.h"
 
 /****************************************************************************/
 /**                                                                        **/
@@ -159,6 +160,48 @@ extern "C" {
 */
 typedef uint8_t w25q_error_codes_t;
 
+struct w25q_stream;
+
+/**
+ * @brief Function called when a chunk of a stream has landed.
+ *
+ * It runs in the DMA interrupt, while the next chunk is being read, and
+ * the chunk goes back to the ring as soon as it returns.
+ *
+ * @param stream pointer to the stream.
+ * @param chunk pointer to the chunk in the ring.
+ * @param length length of the chunk in bytes, only the last one can be shorter than chunk_size.
+*/
+typedef void (*w25q_stream_cb_t)(struct w25q_stream *stream, uint8_t *chunk, uint32_t length);
+
+/**
+ * @brief Streaming read of a flash region.
+ *
+ * The region is read at quad speed with a single command, and the DMA moves
+ * it chunk by chunk into a ring of buffers, so a chunk is processed while the
+ * next ones are being read. The configuration fields are set by the
+ * application before calling w25q128jw_stream_start().
+*/
+typedef struct w25q_stream {
+    /* Configuration */
+    uint8_t *buffers;          /*!< num_buffers contiguous buffers of chunk_size bytes, word aligned. */
+    uint32_t chunk_size;       /*!< Size of a chunk in bytes, multiple of 4. */
+    uint32_t num_buffers;      /*!< Number of buffers, at least 2. */
+    uint8_t channel;           /*!< DMA channel to be used. */
+    w25q_stream_cb_t callback; /*!< Called for each chunk, NULL to get them with w25q128jw_stream_get(). */
+    void *arg;                 /*!< Free for the application. */
+
+    /* State */
+    uint32_t length;            /*!< Length of the region in bytes. */
+    uint32_t num_chunks;        /*!< Number of chunks of the region. */
+    volatile uint32_t launched; /*!< Number of chunks given to the DMA. */
+    volatile uint32_t landed;   /*!< Number of chunks in the ring. */
+    volatile uint32_t released; /*!< Number of chunks given back to the ring. */
+    uint8_t held;               /*!< Whether the application holds a chunk from w25q128jw_stream_get(). */
+    volatile uint8_t error;     /*!< Set when the DMA refused a chunk, the stream is then stopped. */
+    dma_trans_image_t img;      /*!< Compiled DMA transaction of a chunk. */
+} w25q_stream_t;
+
 /****************************************************************************/
 /**                                                                        **/
 /**                          EXPORTED VARIABLES                            **/
@@ -398,6 +441,51 @@ w25q_error_codes_t w25q128jw_write_quad_dma(uint32_t addr, void* data, uint32_t
 */
 w25q_error_codes_t w25q128jw_erase_and_write_quad_dma(uint32_t addr, void* data, uint32_t length);
 
+/**
+ * @brief Set the DMA channel used by the DMA functions (0 by default).
+ *
+ * The streams use their own channel instead.
+ *
+ * @param channel DMA channel.
+*/
+void w25q128jw_set_dma_channel(uint8_t channel);
+
+/**
+ * @brief Start a streaming read of a flash region.
+ *
+ * The first chunk is read right away. The flash cannot be used for anything
+ * else until all the chunks have been consumed (see w25q128jw_stream_done()).
+ * The DMA must have been initialized (e.g. with dma_sdk_init()).
+ *
+ * @param stream pointer to the configured stream, it must stay valid until the end of the stream.
+ * @param addr 24-bit flash address to read from.
+ * @param length number of bytes to read.
+ * @return FLASH_OK if the stream is running, @ref error_codes otherwise.
+*/
+w25q_error_codes_t w25q128jw_stream_start(w25q_stream_t *stream, uint32_t addr, uint32_t length);
+
+/**
+ * @brief Wait for the next chunk of a stream.
+ *
+ * The chunk returned by the previous call goes back to the ring, so the
+ * application processes one chunk at a time while the DMA fills the others.
+ * Not to be used with a callback.
+ *
+ * @param stream pointer to the stream.
+ * @param length if not NULL, filled with the length of the chunk in bytes.
+ * @return pointer to the chunk, NULL when the whole region has been consumed
+ * or when the stream has stopped on an error (see w25q_stream_t::error).
+*/
+uint8_t *w25q128jw_stream_get(w25q_stream_t *stream, uint32_t *length);
+
+/**
+ * @brief Check whether all the chunks of a stream have been consumed.
+ *
+ * @param stream pointer to the stream.
+ * @return 1 if the stream is over and the flash is free, 0 otherwise.
+*/
+uint8_t w25q128jw_stream_done(w25q_stream_t *stream);
+
 /**
  * @brief Erase a 4kb sector.
  *
@@ -408,6 +496,24 @@ w25q_error_codes_t w25q128jw_erase_and_write_quad_dma(uint32_t addr, void* data,
 */
 w25q_error_codes_t w25q128jw_4k_erase(uint32_t addr);
 
+/**
+ * @brief Start erasing a 4kb sector without waiting for it.
+ *
+ * The erase goes on inside the flash, which ignores any other command until
+ * it is over (see w25q128jw_is_busy()).
+ *
+ * @param addr 24-bit address of the sector to erase.
+ * @return FLASH_OK if the erase has been issued, @ref error_codes otherwise.
+*/
+w25q_error_codes_t w25q128jw_4k_erase_async(uint32_t addr);
+
+/**
+ * @brief Check whether the flash is busy with an erase or a program.
+ *
+ * @return 1 if the flash is busy, 0 otherwise.
+*/
+uint8_t w25q128jw_is_busy(void);
+
 /**
  * @brief Erase a 32kb block.
  *
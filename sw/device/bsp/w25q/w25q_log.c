@@ -0,0 +1,436 @@
+/*
+                              *******************
+******************************* C SOURCE FILE *****************************
+**                            *******************
+**
+** project  : X-HEEP
+** filename : w25q_log.c
+** version  : 1
+** date     : 17/10/2026
+**
+***************************************************************************
+**
+** Copyright (c) EPFL contributors.
+** All rights reserved.
+**
+***************************************************************************
+*/
+
+/***************************************************************************/
+/***************************************************************************/
+/**
+* @file   w25q_log.c
+* @date   17/10/2026
+* @brief  Source file of the log-structured record storage on the W25Q flash.
+*/
+
+#ifdef __cplusplus
+extern "C" {
+#endif  // __cplusplus
+
+/****************************************************************************/
+/**                                                                        **/
+/*                             MODULES USED                                 */
+/**                                                                        **/
+/****************************************************************************/
+#include "string.h"
+
+#include "w25q_log.h"
+
+/* To get the target of the compilation (sim or pynq) */
+#include "x-heep.h"
+
+/****************************************************************************/
+/**                                                                        **/
+/*                        DEFINITIONS AND MACROS                            */
+/**                                                                        **/
+/****************************************************************************/
+
+/**
+ * Erased flash word, found after the last record of a sector.
+*/
+#define ERASED_WORD 0xffffffff
+
+/****************************************************************************/
+/**                                                                        **/
+/*                      PROTOTYPES OF LOCAL FUNCTIONS                       */
+/**                                                                        **/
+/****************************************************************************/
+
+/**
+ * @brief Flash address of a sector of the log.
+*/
+static uint32_t sector_addr(w25q_log_t *log, uint32_t sector);
+
+/**
+ * @brief Space taken by a record in the flash: header and data padded to words.
+*/
+static uint32_t record_size(uint32_t length);
+
+/**
+ * @brief Check the header of a record: length in the low half, its complement in the high half.
+*/
+static uint8_t record_header_valid(uint32_t header);
+
+/**
+ * @brief Program the buffered bytes of the head sector up to offset end.
+*/
+static w25q_error_codes_t log_program(w25q_log_t *log, uint32_t end);
+
+/**
+ * @brief Copy bytes to the write buffer, programming its pages when it is full.
+*/
+static w25q_error_codes_t log_put(w25q_log_t *log, const uint8_t *data, uint32_t length);
+
+/**
+ * @brief Start erasing a sector, dropping its records if it holds the oldest ones.
+*/
+static w25q_error_codes_t log_erase_start(w25q_log_t *log, uint32_t sector);
+
+/**
+ * @brief Complete the background erase by writing the header of the sector.
+ *
+ * If wait is not set, return right away when the flash is still erasing.
+*/
+static w25q_error_codes_t log_erase_finish(w25q_log_t *log, uint8_t wait);
+
+/**
+ * @brief Make a sector the head of the log.
+*/
+static w25q_error_codes_t log_activate(w25q_log_t *log, uint32_t sector);
+
+/**
+ * @brief Start erasing the sector after the head, unless it is already free.
+*/
+static w25q_error_codes_t log_reclaim(w25q_log_t *log);
+
+
+/****************************************************************************/
+/**                                                                        **/
+/*                            GLOBAL VARIABLES                              */
+/**                                                                        **/
+/****************************************************************************/
+
+#ifdef TARGET_SIM
+/**
+ * @brief Page of erased words, programmed over a sector to erase it in
+ * simulation, where the flash model has no erase command.
+*/
+static uint32_t erased_page[FLASH_PAGE_SIZE / 4];
+#endif // TARGET_SIM
+
+
+/****************************************************************************/
+/**                                                                        **/
+/*                           EXPORTED FUNCTIONS                             */
+/**                                                                        **/
+/****************************************************************************/
+
+w25q_error_codes_t w25q_log_init(w25q_log_t *log) {
+    // Sanity checks
+    if (log->sectors == NULL || log->num_sectors < 2 || log->base % FLASH_SECTOR_SIZE != 0) return FLASH_ERROR;
+    if (log->base + log->num_sectors * FLASH_SECTOR_SIZE > MAX_FLASH_ADDR + 1) return FLASH_ERROR;
+    if (log->buffer == NULL || (uintptr_t)log->buffer % 4 != 0) return FLASH_ERROR;
+    if (log->buffer_size == 0 || log->buffer_size % FLASH_PAGE_SIZE != 0) return FLASH_ERROR;
+
+    log->head = 0;
+    log->tail = 0;
+    log->next_record = 0;
+    log->next_seq = 0;
+    log->erasing = -1;
+
+    // Rebuild the index from the sector headers
+    int32_t head = -1;
+    for (uint32_t i = 0; i < log->num_sectors; i++) {
+        uint32_t header[W25Q_LOG_HEADER_SIZE / 4];
+        if (w25q128jw_read(sector_addr(log, i), header, sizeof(header)) != FLASH_OK) return FLASH_ERROR;
+
+        w25q_log_sector_t *s = &log->sectors[i];
+        s->erase_count = (header[0] == W25Q_LOG_MAGIC || header[0] == W25Q_LOG_RETIRED) ? header[1] : 0;
+        if (header[0] != W25Q_LOG_MAGIC) {
+            s->state = W25Q_LOG_SECTOR_DIRTY;
+        } else if (header[2] == W25Q_LOG_SEQ_FREE) {
+            s->state = W25Q_LOG_SECTOR_FREE;
+        } else {
+            s->state = W25Q_LOG_SECTOR_DATA;
+            s->seq = header[2];
+            s->first_record = header[3];
+            if (head < 0 || s->seq > log->sectors[head].seq) head = i;
+        }
+    }
+
+    // Empty region, start the log in its first sector
+    if (head < 0) {
+        if (log_activate(log, 0) != FLASH_OK) return FLASH_ERROR;
+        return log_reclaim(log);
+    }
+
+    // The records are in the sectors before the head with consecutive sequence numbers
+    log->head = head;
+    log->tail = head;
+    while (1) {
+        uint32_t prev = (log->tail + log->num_sectors - 1) % log->num_sectors;
+        if (prev == log->head || log->sectors[prev].state != W25Q_LOG_SECTOR_DATA) break;
+        if (log->sectors[prev].seq != log->sectors[log->tail].seq - 1) break;
+        log->tail = prev;
+    }
+
+    // Any other sector with records is a leftover
+    uint32_t used = (log->head + log->num_sectors - log->tail) % log->num_sectors;
+    for (uint32_t i = 0; i < log->num_sectors; i++) {
+        if (log->sectors[i].state == W25Q_LOG_SECTOR_DATA && (i + log->num_sectors - log->tail) % log->num_sectors > used) {
+            log->sectors[i].state = W25Q_LOG_SECTOR_DIRTY;
+        }
+    }
+
+    // Find the end of the records of the head sector
+    uint32_t offset = W25Q_LOG_HEADER_SIZE;
+    uint32_t header = ERASED_WORD;
+    uint32_t records = 0;
+    while (offset + 4 <= FLASH_SECTOR_SIZE) {
+        if (w25q128jw_read(sector_addr(log, head) + offset, &header, 4) != FLASH_OK) return FLASH_ERROR;
+        if (!record_header_valid(header) || offset + record_size(header & 0xffff) > FLASH_SECTOR_SIZE) break;
+        offset += record_size(header & 0xffff);
+        records++;
+    }
+
+    // A record cut by a power loss leaves programmed bytes behind, so the rest of the sector is not used
+    if (offset + 4 <= FLASH_SECTOR_SIZE && header != ERASED_WORD) offset = FLASH_SECTOR_SIZE;
+
+    log->fill = offset;
+    log->flushed = offset;
+    log->next_record = log->sectors[head].first_record + records;
+    log->next_seq = log->sectors[head].seq + 1;
+
+    // Keep a sector ready for the next records
+    return log_reclaim(log);
+}
+
+w25q_error_codes_t w25q_log_append(w25q_log_t *log, const void *data, uint32_t length, uint32_t *record) {
+    // Sanity checks
+    if (data == NULL || length == 0 || length > W25Q_LOG_MAX_RECORD) return FLASH_ERROR;
+
+    // A record never spans two sectors
+    if (log->fill + record_size(length) > FLASH_SECTOR_SIZE) {
+        // Everything left in the head sector goes to the flash before moving on
+        if (log_program(log, log->fill) != FLASH_OK) return FLASH_ERROR;
+        if (log_activate(log, (log->head + 1) % log->num_sectors) != FLASH_OK) return FLASH_ERROR;
+        if (log_reclaim(log) != FLASH_OK) return FLASH_ERROR;
+    }
+
+    uint32_t header = (length & 0xffff) | ((~length & 0xffff) << 16);
+    uint32_t padding = ERASED_WORD;
+    if (log_put(log, (const uint8_t *)&header, 4) != FLASH_OK) return FLASH_ERROR;
+    if (log_put(log, (const uint8_t *)data, length) != FLASH_OK) return FLASH_ERROR;
+    if (log_put(log, (const uint8_t *)&padding, record_size(length) - 4 - length) != FLASH_OK) return FLASH_ERROR;
+
+    if (record != NULL) *record = log->next_record;
+    log->next_record++;
+
+    return w25q_log_poll(log);
+}
+
+w25q_error_codes_t w25q_log_poll(w25q_log_t *log) {
+    if (log_erase_finish(log, 0) != FLASH_OK) return FLASH_ERROR;
+
+    // The flash takes no command while it erases
+    if (log->erasing >= 0) return FLASH_OK;
+
+    return log_program(log, log->fill & ~(FLASH_PAGE_SIZE - 1));
+}
+
+w25q_error_codes_t w25q_log_sync(w25q_log_t *log) {
+    if (log_erase_finish(log, 1) != FLASH_OK) return FLASH_ERROR;
+    return log_program(log, log->fill);
+}
+
+w25q_error_codes_t w25q_log_read(w25q_log_t *log, uint32_t record, void *data, uint32_t size, uint32_t *length) {
+    // Sanity checks
+    if (record < log->sectors[log->tail].first_record || record >= log->next_record) return FLASH_ERROR;
+
+    // The record may still be in the write buffer
+    if (w25q_log_sync(log) != FLASH_OK) return FLASH_ERROR;
+
+    // Find the sector from the index
+    uint32_t sector = log->head;
+    while (log->sectors[sector].first_record > record) {
+        sector = (sector + log->num_sectors - 1) % log->num_sectors;
+    }
+
+    // Walk the records of the sector
+    uint32_t addr = sector_addr(log, sector) + W25Q_LOG_HEADER_SIZE;
+    uint32_t header;
+    for (uint32_t i = log->sectors[sector].first_record; ; i++) {
+        if (w25q128jw_read(addr, &header, 4) != FLASH_OK) return FLASH_ERROR;
+        if (!record_header_valid(header)) return FLASH_ERROR;
+        if (i == record) break;
+        addr += record_size(header & 0xffff);
+    }
+
+    uint32_t record_length = header & 0xffff;
+    if (length != NULL) *length = record_length;
+    if (size > record_length) size = record_length;
+    if (size == 0) return FLASH_OK;
+
+    return w25q128jw_read(addr + 4, data, size);
+}
+
+void w25q_log_get_stats(w25q_log_t *log, w25q_log_stats_t *stats) {
+    stats->first_record = log->sectors[log->tail].first_record;
+    stats->num_records = log->next_record - stats->first_record;
+    stats->erase_min = log->sectors[0].erase_count;
+    stats->erase_max = log->sectors[0].erase_count;
+    stats->erase_total = 0;
+
+    for (uint32_t i = 0; i < log->num_sectors; i++) {
+        uint32_t count = log->sectors[i].erase_count;
+        if (count < stats->erase_min) stats->erase_min = count;
+        if (count > stats->erase_max) stats->erase_max = count;
+        stats->erase_total += count;
+    }
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/*                            LOCAL FUNCTIONS                               */
+/**                                                                        **/
+/****************************************************************************/
+
+static uint32_t sector_addr(w25q_log_t *log, uint32_t sector) {
+    return log->base + sector * FLASH_SECTOR_SIZE;
+}
+
+static uint32_t record_size(uint32_t length) {
+    return 4 + ((length + 3) & ~3);
+}
+
+static uint8_t record_header_valid(uint32_t header) {
+    uint32_t length = header & 0xffff;
+    return (header >> 16) == (~length & 0xffff) && length != 0 && length <= W25Q_LOG_MAX_RECORD;
+}
+
+static w25q_error_codes_t log_program(w25q_log_t *log, uint32_t end) {
+    if (end <= log->flushed) return FLASH_OK;
+
+    // The flash has to be done with the erase first
+    if (log_erase_finish(log, 1) != FLASH_OK) return FLASH_ERROR;
+
+    uint32_t length = end - log->flushed;
+    if (w25q128jw_write_quad_dma(sector_addr(log, log->head) + log->flushed, log->buffer, length) != FLASH_OK) return FLASH_ERROR;
+
+    // Move what is left to the start of the buffer
+    memmove(log->buffer, log->buffer + length, log->fill - end);
+    log->flushed = end;
+
+    return FLASH_OK;
+}
+
+static w25q_error_codes_t log_put(w25q_log_t *log, const uint8_t *data, uint32_t length) {
+    while (length > 0) {
+        uint32_t buffered = log->fill - log->flushed;
+        if (buffered == log->buffer_size) {
+            if (log_program(log, log->fill & ~(FLASH_PAGE_SIZE - 1)) != FLASH_OK) return FLASH_ERROR;
+            buffered = log->fill - log->flushed;
+        }
+
+        uint32_t n = log->buffer_size - buffered;
+        if (n > length) n = length;
+        memcpy(log->buffer + buffered, data, n);
+        log->fill += n;
+        data += n;
+        length -= n;
+    }
+
+    return FLASH_OK;
+}
+
+static w25q_error_codes_t log_erase_start(w25q_log_t *log, uint32_t sector) {
+    // A single erase at a time
+    if (log_erase_finish(log, 1) != FLASH_OK) return FLASH_ERROR;
+
+    w25q_log_sector_t *s = &log->sectors[sector];
+    if (s->state == W25Q_LOG_SECTOR_DATA) {
+        // The oldest records are dropped
+        if (sector == log->tail) log->tail = (log->tail + 1) % log->num_sectors;
+
+        // Retire the header first, so that a sector partially erased by a power loss is never taken for a valid one
+        uint32_t retired = W25Q_LOG_RETIRED;
+        if (w25q128jw_write_quad_dma(sector_addr(log, sector), &retired, 4) != FLASH_OK) return FLASH_ERROR;
+    }
+
+    s->state = W25Q_LOG_SECTOR_DIRTY;
+    s->erase_count++;
+    log->erasing = sector;
+
+    // Erase the sector. The simulation model has no erase, but its program
+    // replaces the data instead of clearing bits, so the erased words are written.
+    #ifndef TARGET_SIM
+    if (w25q128jw_4k_erase_async(sector_addr(log, sector)) != FLASH_OK) return FLASH_ERROR;
+    #else
+    for (uint32_t i = 0; i < FLASH_PAGE_SIZE / 4; i++) erased_page[i] = ERASED_WORD;
+    for (uint32_t offset = 0; offset < FLASH_SECTOR_SIZE; offset += FLASH_PAGE_SIZE) {
+        if (w25q128jw_write_quad_dma(sector_addr(log, sector) + offset, erased_page, FLASH_PAGE_SIZE) != FLASH_OK) return FLASH_ERROR;
+    }
+    #endif // TARGET_SIM
+
+    return FLASH_OK;
+}
+
+static w25q_error_codes_t log_erase_finish(w25q_log_t *log, uint8_t wait) {
+    if (log->erasing < 0) return FLASH_OK;
+
+    #ifndef TARGET_SIM
+    if (!wait && w25q128jw_is_busy()) return FLASH_OK;
+    while (w25q128jw_is_busy());
+    #endif // TARGET_SIM
+
+    // The sequence number and the first record are written when the sector becomes the head
+    uint32_t sector = log->erasing;
+    uint32_t header[2] = {W25Q_LOG_MAGIC, log->sectors[sector].erase_count};
+    log->erasing = -1;
+    if (w25q128jw_write_quad_dma(sector_addr(log, sector), header, sizeof(header)) != FLASH_OK) return FLASH_ERROR;
+
+    log->sectors[sector].state = W25Q_LOG_SECTOR_FREE;
+
+    return FLASH_OK;
+}
+
+static w25q_error_codes_t log_activate(w25q_log_t *log, uint32_t sector) {
+    if (log_erase_finish(log, 1) != FLASH_OK) return FLASH_ERROR;
+
+    // Only happens when opening the log, otherwise the sector is the spare one
+    if (log->sectors[sector].state != W25Q_LOG_SECTOR_FREE) {
+        if (log_erase_start(log, sector) != FLASH_OK) return FLASH_ERROR;
+        if (log_erase_finish(log, 1) != FLASH_OK) return FLASH_ERROR;
+    }
+
+    uint32_t header[2] = {log->next_seq, log->next_record};
+    if (w25q128jw_write_quad_dma(sector_addr(log, sector) + 8, header, sizeof(header)) != FLASH_OK) return FLASH_ERROR;
+
+    w25q_log_sector_t *s = &log->sectors[sector];
+    s->state = W25Q_LOG_SECTOR_DATA;
+    s->seq = log->next_seq++;
+    s->first_record = log->next_record;
+
+    log->head = sector;
+    log->fill = W25Q_LOG_HEADER_SIZE;
+    log->flushed = W25Q_LOG_HEADER_SIZE;
+
+    return FLASH_OK;
+}
+
+static w25q_error_codes_t log_reclaim(w25q_log_t *log) {
+    uint32_t spare = (log->head + 1) % log->num_sectors;
+    if (log->sectors[spare].state == W25Q_LOG_SECTOR_FREE || log->erasing == (int32_t)spare) return FLASH_OK;
+    return log_erase_start(log, spare);
+}
+
+#ifdef __cplusplus
+} // extern "C"
+#endif  // __cplusplus
+/****************************************************************************/
+/**                                                                        **/
+/*                                 EOF                                      */
+/**                                                                        **/
+/****************************************************************************/
@@ -0,0 +1,246 @@
+/*
+                              *******************
+******************************* H HEADER FILE *****************************
+**                            *******************
+**
+** project  : X-HEEP
+** filename : w25q_log.h
+** version  : 1
+** date     : 17/10/2026
+**
+***************************************************************************
+**
+** Copyright (c) EPFL contributors.
+** All rights reserved.
+**
+***************************************************************************
+*/
+
+/***************************************************************************/
+/***************************************************************************/
+
+/**
+* @file   w25q_log.h
+* @date   17/10/2026
+* @brief  Header file of the log-structured record storage on the W25Q flash.
+*
+* Records are appended one after the other to the sectors of a flash region,
+* which is used as a ring: no sector is ever rewritten in place. The records
+* are gathered in RAM and programmed a whole page at a time, and a sector is
+* always kept erased ahead of the one being written, its erase running in the
+* background while the records accumulate. When the region is full, the
+* oldest sector is reclaimed, so every sector is erased in turn and wears at
+* the same rate.
+*
+* Each sector starts with a header holding the erase count of the sector, its
+* sequence number in the log and the number of its first record, from which
+* the index in RAM is rebuilt by w25q_log_init() after a reset.
+*/
+
+#ifndef W25Q_LOG_H
+#define W25Q_LOG_H
+
+/****************************************************************************/
+/**                                                                        **/
+/**                            MODULES USED                                **/
+/**                                                                        **/
+/****************************************************************************/
+
+#include "w25q128jw.h"
+
+/****************************************************************************/
+/**                                                                        **/
+/**                       DEFINITIONS AND MACROS                           **/
+/**                                                                        **/
+/****************************************************************************/
+
+/**
+ * @brief Magic word of a sector header ("WLOG").
+*/
+#define W25Q_LOG_MAGIC 0x474f4c57
+
+/**
+ * @brief Magic word of a sector header whose records have been dropped.
+*/
+#define W25Q_LOG_RETIRED 0x00000000
+
+/**
+ * @brief Sequence number of a sector erased and ready for records.
+*/
+#define W25Q_LOG_SEQ_FREE 0xffffffff
+
+/**
+ * @brief Size of the header at the start of each sector, in bytes.
+*/
+#define W25Q_LOG_HEADER_SIZE 16
+
+/**
+ * @brief Maximum length of a record, in bytes (a record never spans two sectors).
+*/
+#define W25Q_LOG_MAX_RECORD (FLASH_SECTOR_SIZE - W25Q_LOG_HEADER_SIZE - 4)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/****************************************************************************/
+/**                                                                        **/
+/**                       TYPEDEFS AND STRUCTURES                          **/
+/**                                                                        **/
+/****************************************************************************/
+
+/**
+ * @brief State of a sector of the log.
+*/
+typedef enum {
+    W25Q_LOG_SECTOR_DIRTY, /*!< Holds stale data, to be erased. */
+    W25Q_LOG_SECTOR_FREE,  /*!< Erased, ready for records. */
+    W25Q_LOG_SECTOR_DATA,  /*!< Holds records. */
+} w25q_log_sector_state_t;
+
+/**
+ * @brief Entry of the index of the log, one per sector.
+*/
+typedef struct {
+    w25q_log_sector_state_t state; /*!< State of the sector. */
+    uint32_t seq;                  /*!< Sequence number of the sector in the log. */
+    uint32_t first_record;         /*!< Number of the first record of the sector. */
+    uint32_t erase_count;          /*!< Number of times the sector has been erased. */
+} w25q_log_sector_t;
+
+/**
+ * @brief Log of records in a flash region.
+ *
+ * The configuration fields are set by the application before calling
+ * w25q_log_init().
+*/
+typedef struct {
+    /* Configuration */
+    uint32_t base;              /*!< 24-bit flash address of the region, sector aligned. */
+    uint32_t num_sectors;       /*!< Number of sectors of the region, at least 2. */
+    w25q_log_sector_t *sectors; /*!< Index, num_sectors entries. */
+    uint8_t *buffer;            /*!< Write buffer, word aligned. */
+    uint32_t buffer_size;       /*!< Size of the write buffer in bytes, multiple of FLASH_PAGE_SIZE. */
+
+    /* State */
+    uint32_t head;        /*!< Sector being written. */
+    uint32_t tail;        /*!< Sector holding the oldest records. */
+    uint32_t fill;        /*!< Offset of the next record in the head sector. */
+    uint32_t flushed;     /*!< Offset up to which the head sector is programmed, the rest is in the buffer. */
+    uint32_t next_record; /*!< Number of the next record. */
+    uint32_t next_seq;    /*!< Sequence number of the next sector. */
+    int32_t erasing;      /*!< Sector being erased in the background, -1 if none. */
+} w25q_log_t;
+
+/**
+ * @brief Statistics of a log.
+*/
+typedef struct {
+    uint32_t first_record; /*!< Number of the oldest record still stored. */
+    uint32_t num_records;  /*!< Number of records stored. */
+    uint32_t erase_min;    /*!< Lowest erase count among the sectors. */
+    uint32_t erase_max;    /*!< Highest erase count among the sectors. */
+    uint32_t erase_total;  /*!< Sum of the erase counts of the sectors. */
+} w25q_log_stats_t;
+
+/****************************************************************************/
+/**                                                                        **/
+/**                          EXPORTED VARIABLES                            **/
+/**                                                                        **/
+/****************************************************************************/
+
+/****************************************************************************/
+/**                                                                        **/
+/**                          EXPORTED FUNCTIONS                            **/
+/**                                                                        **/
+/****************************************************************************/
+
+/**
+ * @brief Open the log stored in a flash region.
+ *
+ * The index is rebuilt from the sector headers and the records already in
+ * the region are kept. A region that holds no log starts empty, its sectors
+ * being erased as the log reaches them.
+ * The flash must have been initialized with w25q128jw_init().
+ *
+ * @param log pointer to the configured log.
+ * @return FLASH_OK if the log is ready, @ref error_codes otherwise.
+*/
+w25q_error_codes_t w25q_log_init(w25q_log_t *log);
+
+/**
+ * @brief Append a record to the log.
+ *
+ * The record is copied to the write buffer, and only the pages it completes
+ * are programmed, unless the flash is still erasing and the buffer has room
+ * left. When the region is full, the oldest records are dropped.
+ *
+ * @param log pointer to the log.
+ * @param data pointer to the record.
+ * @param length length of the record in bytes, at most W25Q_LOG_MAX_RECORD.
+ * @param record if not NULL, filled with the number of the record.
+ * @return FLASH_OK if the record has been appended, @ref error_codes otherwise.
+*/
+w25q_error_codes_t w25q_log_append(w25q_log_t *log, const void *data, uint32_t length, uint32_t *record);
+
+/**
+ * @brief Do the pending background work of the log without waiting.
+ *
+ * Completes the erase of the spare sector if the flash is done with it, and
+ * then programs the full pages of the write buffer. To be called when the
+ * application is idle.
+ *
+ * @param log pointer to the log.
+ * @return FLASH_OK if successful, @ref error_codes otherwise.
+*/
+w25q_error_codes_t w25q_log_poll(w25q_log_t *log);
+
+/**
+ * @brief Program all the records of the write buffer.
+ *
+ * Waits for the background erase, if any. The flash is free for other
+ * operations when the function returns.
+ *
+ * @param log pointer to the log.
+ * @return FLASH_OK if successful, @ref error_codes otherwise.
+*/
+w25q_error_codes_t w25q_log_sync(w25q_log_t *log);
+
+/**
+ * @brief Read a record of the log.
+ *
+ * The index in RAM gives the sector of the record, which is then found by
+ * walking the record headers of that sector. Syncs the log first.
+ *
+ * @param log pointer to the log.
+ * @param record number of the record.
+ * @param data pointer to the buffer to be filled.
+ * @param size size of the buffer in bytes, a longer record is truncated.
+ * @param length if not NULL, filled with the length of the record in bytes.
+ * @return FLASH_OK if successful, FLASH_ERROR if the record is not stored.
+*/
+w25q_error_codes_t w25q_log_read(w25q_log_t *log, uint32_t record, void *data, uint32_t size, uint32_t *length);
+
+/**
+ * @brief Get the statistics of a log, including the erase counts of its sectors.
+ *
+ * @param log pointer to the log.
+ * @param stats pointer to the statistics to be filled.
+*/
+void w25q_log_get_stats(w25q_log_t *log, w25q_log_stats_t *stats);
+
+/****************************************************************************/
+/**                                                                        **/
+/**                          INLINE FUNCTIONS                              **/
+/**                                                                        **/
+/****************************************************************************/
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif /* W25Q_LOG_H */
+/****************************************************************************/
+/**                                                                        **/
+/**                                EOF                                     **/
+/**                                                                        **/
+/****************************************************************************/
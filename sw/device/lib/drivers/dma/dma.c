@@ -45,6 +45,7 @@ extern "C"
 #include "fast_intr_ctrl.h"
 #include "csr.h"
 #include "stdasm.h"
+#include "bitfield.h"
 
 /****************************************************************************/
 /**                                                                        **/
@@ -57,16 +58,6 @@ extern "C"
  */
 #define DMA_STATIC_ASSERT(expr, msg)// _Static_assert(!expr, msg);
 
-/**
- * Returns the mask to enable/disable DMA transaction done interrupts.
- */
-#define DMA_DONE_CSR_REG_MIE_MASK (( 1 << 19 )) // 19 is DMA fast interrupt bit in MIE CSR
-
-/**
- * Returns the mask to enable/disable DMA window interrupts.
- */
-#define DMA_WINDOW_CSR_REG_MIE_MASK (( 1 << 30 )) // 30 is DMA fast interrupt bit in MIE CSR
-
 /**
  * Mask to determine if an address is multiple of 4 (Word aligned).
  */
@@ -199,20 +190,20 @@ static inline uint8_t is_region_outbound_2D(   uint8_t  *p_start,
 /**
  * @brief Analyzes a target to determine the size of its D1 increment (in bytes).
  * @param p_tgt A pointer to the target to analyze.
- * @param channel The channel to use as target.
+ * @param p_trans The transaction the target belongs to.
  * @return The number of bytes of the increment.
  */
 static inline uint32_t get_increment_b_1D( dma_target_t * p_tgt,
-                                    uint8_t channel );
+                                    dma_trans_t  * p_trans );
 
 /**
  * @brief Analyzes a target to determine the size of its D2 increment (in bytes).
  * @param p_tgt A pointer to the target to analyze.
- * @param channel The channel to use as target.
+ * @param p_trans The transaction the target belongs to.
  * @return The number of bytes of the increment.
  */
 static inline uint32_t get_increment_b_2D( dma_target_t * p_tgt,
-                                    uint8_t channel  );
+                                    dma_trans_t  * p_trans  );
 
 
 /****************************************************************************/
@@ -245,19 +236,56 @@ typedef struct
     */
     uint8_t intrFlag;
 
+    /**
+    * Raised while a library (e.g. the SPI SDK) programs the channel registers
+    * itself, so that no transaction is loaded or launched in the meantime.
+    */
+    uint8_t claimed;
+
     /**
      * memory mapped structure of a DMA.
      */
     dma *peri;
 
+    /**
+     * Called instead of dma_intr_handler_window_done() when not NULL.
+     */
+    void (*window_cb)(uint8_t channel);
+
+    /**
+     * Called instead of dma_intr_handler_trans_done() when not NULL.
+     */
+    void (*done_cb)(uint8_t channel);
+
 }dma_ch_cb;
 
 /* Allocate the channel's memory space */
 static dma_ch_cb dma_subsys_per[DMA_CH_NUM];
 
-/* High priority interrupts counters */
-uint16_t dma_hp_tr_intr_counter = 0;
-uint16_t dma_hp_win_intr_counter = 0;
+/*
+ * Channels of each interrupt priority level above 0 (mask of level 1 first).
+ * The channels that are in none of them have priority 0.
+ */
+static uint32_t dma_intr_prio_mask[DMA_INTR_PRIO_LEVELS - 1];
+
+/**
+ * @brief Picks the channel to serve among the pending ones: the lowest
+ * channel of the highest priority level with a pending interrupt.
+ * @param pending The pending interrupt bitmap, not 0.
+ * @return The channel.
+ */
+static inline uint8_t dma_next_pending(uint32_t pending)
+{
+    for (int level = DMA_INTR_PRIO_LEVELS - 2; level >= 0; level--)
+    {
+        uint32_t ready = pending & dma_intr_prio_mask[level];
+        if (ready)
+        {
+            return bitfield_count_trailing_zeroes32(ready);
+        }
+    }
+    return bitfield_count_trailing_zeroes32(pending);
+}
 
 
 /****************************************************************************/
@@ -268,89 +296,98 @@ uint16_t dma_hp_win_intr_counter = 0;
 
 void fic_irq_dma_window(void)
 {
-    /* 
-     * Find out which channel raised the interrupt and call
-     * either the weak implementation provided in this module,
-     * or the non-weak implementation.
-     */
+    uint32_t handled = 0;
+    uint32_t pending;
 
-    for (int i = 0; i < DMA_CH_NUM; i++)
+    /*
+     * The pending register tells which channels raised the interrupt, so
+     * the channel to serve is found without polling all of them. It is read
+     * again after each handler so that a higher priority channel that
+     * finishes in the meantime is served first. A channel is served once per
+     * call, as its pending bit takes a few cycles to fall after the IFR read.
+     */
+    while ((pending = dma_subsys_per[0].peri->WINDOW_PENDING & ~handled) != 0)
     {
+        uint8_t i = dma_next_pending(pending);
+        handled |= 1u << i;
+
+        /* Reading the IFR clears it */
         if (dma_subsys_per[i].peri->WINDOW_IFR == 1)
         {
-            dma_intr_handler_window_done(i);
-
-             #ifdef DMA_HP_INTR_INDEX
-            /* 
-             * If the channel that raised the interrupt is among the high priority channels,
-             * return to break the loop. 
-             */
-            #ifdef DMA_NUM_HP_INTR
-            if (i <= DMA_HP_INTR_INDEX && dma_hp_win_intr_counter < DMA_NUM_HP_INTR)
+            if (dma_subsys_per[i].window_cb != NULL)
             {
-                dma_hp_win_intr_counter++;
-                return;
-            } else if (i > DMA_HP_INTR_INDEX)
+                dma_subsys_per[i].window_cb(i);
+            }
+            else
             {
-                dma_hp_win_intr_counter = 0;
+                dma_intr_handler_window_done(i);
             }
+        }
+    }
 
-            #else
-
-            if (i <= DMA_HP_INTR_INDEX)
+    #if DMA_CH_NUM > DMA_PENDING_CH_NUM
+    /* The channels beyond the pending register are still polled */
+    for (int i = DMA_PENDING_CH_NUM; i < DMA_CH_NUM; i++)
+    {
+        if (dma_subsys_per[i].peri->WINDOW_IFR == 1)
+        {
+            if (dma_subsys_per[i].window_cb != NULL)
             {
-                return;
+                dma_subsys_per[i].window_cb(i);
+            }
+            else
+            {
+                dma_intr_handler_window_done(i);
             }
-            #endif
-
-            #endif
         }
     }
+    #endif
     return;
 }
 
 void fic_irq_dma_done(void)
 {
-    /* 
-     * Find out which channel raised the interrupt and call
-     * either the weak implementation provided in this module,
-     * or the non-weak implementation.
-     */
-    
-    for (int i = 0; i < DMA_CH_NUM; i++)
+    uint32_t handled = 0;
+    uint32_t pending;
+
+    /* Same dispatch as the window interrupt */
+    while ((pending = dma_subsys_per[0].peri->TRANSACTION_PENDING & ~handled) != 0)
     {
+        uint8_t i = dma_next_pending(pending);
+        handled |= 1u << i;
+
+        /* Reading the IFR clears it */
         if (dma_subsys_per[i].peri->TRANSACTION_IFR == 1)
         {
             dma_subsys_per[i].intrFlag = 1;
-            dma_intr_handler_trans_done(i);
-
-            #ifdef DMA_HP_INTR_INDEX
-            /* 
-             * If the channel that raised the interrupt is among the high priority channels,
-             * return to break the loop. 
-             */
-            #ifdef DMA_NUM_HP_INTR
-            if (i <= DMA_HP_INTR_INDEX && dma_hp_tr_intr_counter < DMA_NUM_HP_INTR)
+            if (dma_subsys_per[i].done_cb != NULL)
             {
-                dma_hp_tr_intr_counter++;
-                return;
+                dma_subsys_per[i].done_cb(i);
             }
-            else if (i > DMA_HP_INTR_INDEX)
+            else
             {
-                dma_hp_tr_intr_counter = 0;
+                dma_intr_handler_trans_done(i);
             }
+        }
+    }
 
-            #else
-
-            if (i <= DMA_HP_INTR_INDEX)
+    #if DMA_CH_NUM > DMA_PENDING_CH_NUM
+    for (int i = DMA_PENDING_CH_NUM; i < DMA_CH_NUM; i++)
+    {
+        if (dma_subsys_per[i].peri->TRANSACTION_IFR == 1)
+        {
+            dma_subsys_per[i].intrFlag = 1;
+            if (dma_subsys_per[i].done_cb != NULL)
             {
-                return;
+                dma_subsys_per[i].done_cb(i);
+            }
+            else
+            {
+                dma_intr_handler_trans_done(i);
             }
-            #endif
-
-            #endif
         }
     }
+    #endif
     return;
 }
 
@@ -367,6 +404,16 @@ void dma_init( dma *dma_peri )
 
         /* Clear the loaded transaction */
         dma_subsys_per[i].trans = NULL;
+        dma_subsys_per[i].claimed = 0;
+        dma_subsys_per[i].window_cb = NULL;
+        dma_subsys_per[i].done_cb = NULL;
+
+        /* Channels up to DMA_HP_INTR_INDEX start at the highest priority */
+        #ifdef DMA_HP_INTR_INDEX
+        dma_set_intr_priority(i, i <= DMA_HP_INTR_INDEX ? DMA_INTR_PRIO_LEVELS - 1 : 0);
+        #else
+        dma_set_intr_priority(i, 0);
+        #endif
 
         /* Clear all values in the DMA registers. */
         dma_subsys_per[i].peri->SRC_PTR        = 0;
@@ -821,7 +868,7 @@ dma_config_flags_t dma_load_transaction( dma_trans_t *p_trans)
      * until it has ended.
      * Transactions can still be validated in the meantime.
      */
-    if( !dma_is_ready(channel) )
+    if( !dma_is_ready(channel) || dma_subsys_per[channel].claimed )
     {
         return DMA_CONFIG_TRANS_OVERRIDE;
     }
@@ -979,7 +1026,7 @@ dma_config_flags_t dma_load_transaction( dma_trans_t *p_trans)
      * In case of a 2D DMA transaction, the second dimension increment is set.
      */
 
-    write_register(  get_increment_b_1D( dma_subsys_per[channel].trans->src, channel),
+    write_register(  get_increment_b_1D( dma_subsys_per[channel].trans->src, dma_subsys_per[channel].trans),
                     DMA_SRC_PTR_INC_D1_REG_OFFSET,
                     DMA_SRC_PTR_INC_D1_INC_MASK,
                     DMA_SRC_PTR_INC_D1_INC_OFFSET,
@@ -987,7 +1034,7 @@ dma_config_flags_t dma_load_transaction( dma_trans_t *p_trans)
 
     if(dma_subsys_per[channel].trans->dim == DMA_DIM_CONF_2D)
     {
-        write_register(  get_increment_b_2D( dma_subsys_per[channel].trans->src, channel),
+        write_register(  get_increment_b_2D( dma_subsys_per[channel].trans->src, dma_subsys_per[channel].trans),
                         DMA_SRC_PTR_INC_D2_REG_OFFSET,
                         DMA_SRC_PTR_INC_D2_INC_MASK,
                         DMA_SRC_PTR_INC_D2_INC_OFFSET,
@@ -997,7 +1044,7 @@ dma_config_flags_t dma_load_transaction( dma_trans_t *p_trans)
     #if DMA_ADDR_MODE
     if(dma_subsys_per[channel].trans->mode != DMA_TRANS_MODE_ADDRESS)
     {
-        write_register(  get_increment_b_1D( dma_subsys_per[channel].trans->dst, channel),
+        write_register(  get_increment_b_1D( dma_subsys_per[channel].trans->dst, dma_subsys_per[channel].trans),
                         DMA_DST_PTR_INC_D1_REG_OFFSET,
                         DMA_DST_PTR_INC_D1_INC_MASK,
                         DMA_DST_PTR_INC_D1_INC_OFFSET,
@@ -1005,7 +1052,7 @@ dma_config_flags_t dma_load_transaction( dma_trans_t *p_trans)
         
         if(dma_subsys_per[channel].trans->dim == DMA_DIM_CONF_2D)
         {
-            write_register(  get_increment_b_2D( dma_subsys_per[channel].trans->dst, channel),
+            write_register(  get_increment_b_2D( dma_subsys_per[channel].trans->dst, dma_subsys_per[channel].trans),
                         DMA_DST_PTR_INC_D2_REG_OFFSET,
                         DMA_DST_PTR_INC_D2_INC_MASK,
                         DMA_DST_PTR_INC_D2_INC_OFFSET,
@@ -1013,7 +1060,7 @@ dma_config_flags_t dma_load_transaction( dma_trans_t *p_trans)
         }
     }
     #else 
-    write_register(  get_increment_b_1D( dma_subsys_per[channel].trans->dst, channel),
+    write_register(  get_increment_b_1D( dma_subsys_per[channel].trans->dst, dma_subsys_per[channel].trans),
                         DMA_DST_PTR_INC_D1_REG_OFFSET,
                         DMA_DST_PTR_INC_D1_INC_MASK,
                         DMA_DST_PTR_INC_D1_INC_OFFSET,
@@ -1021,7 +1068,7 @@ dma_config_flags_t dma_load_transaction( dma_trans_t *p_trans)
         
     if(dma_subsys_per[channel].trans->dim == DMA_DIM_CONF_2D)
     {
-        write_register(  get_increment_b_2D( dma_subsys_per[channel].trans->dst, channel),
+        write_register(  get_increment_b_2D( dma_subsys_per[channel].trans->dst, dma_subsys_per[channel].trans),
                     DMA_DST_PTR_INC_D2_REG_OFFSET,
                     DMA_DST_PTR_INC_D2_INC_MASK,
                     DMA_DST_PTR_INC_D2_INC_OFFSET,
@@ -1129,7 +1176,7 @@ dma_config_flags_t dma_launch( dma_trans_t *p_trans)
      * until it has ended.
      * Transactions can still be validated in the meantime.
      */
-    if( !dma_is_ready(channel) )
+    if( !dma_is_ready(channel) || dma_subsys_per[channel].claimed )
     {
         return DMA_CONFIG_TRANS_OVERRIDE;
     }
@@ -1172,6 +1219,298 @@ dma_config_flags_t dma_launch( dma_trans_t *p_trans)
     return DMA_CONFIG_OK;
 }
 
+dma_config_flags_t dma_desc_build( dma_desc_t    *p_desc,
+                                   dma_trans_t   *p_trans,
+                                   dma_desc_t    *p_next,
+                                   uint32_t      p_flags )
+{
+    /*
+     * A successful transaction creation has to be done before building a
+     * descriptor out of it.
+     */
+    if( p_trans->flags & DMA_CONFIG_CRITICAL_ERROR )
+    {
+        return DMA_CONFIG_CRITICAL_ERROR;
+    }
+
+    /*
+     * The descriptors only hold the registers that change from a transaction
+     * to the next one. The mode, padding and HW FIFO are set once for the
+     * whole chain, so they can only take their default value.
+     */
+    if(     p_trans->mode != DMA_TRANS_MODE_SINGLE
+        ||  p_trans->size_d1_du > DMA_SIZE_D1_SIZE_MASK
+        ||  p_trans->size_d2_du > DMA_SIZE_D2_SIZE_MASK
+        #if DMA_ZERO_PADDING
+        ||  p_trans->pad_top_du  != 0 || p_trans->pad_bottom_du != 0
+        ||  p_trans->pad_left_du != 0 || p_trans->pad_right_du  != 0
+        #endif
+        #if DMA_HW_FIFO_MODE
+        ||  p_trans->hw_fifo_en
+        #endif
+      )
+    {
+        return DMA_CONFIG_CRITICAL_ERROR | DMA_CONFIG_INCOMPATIBLE;
+    }
+
+    p_desc->next    = p_next;
+    p_desc->src_ptr = (uint32_t)p_trans->src->ptr;
+    p_desc->dst_ptr = (uint32_t)p_trans->dst->ptr;
+    p_desc->size    = p_trans->size_d1_du;
+    p_desc->config  =
+          ( ( get_increment_b_1D( p_trans->src, p_trans ) & DMA_SRC_PTR_INC_D1_INC_MASK ) << DMA_DESC_SRC_INC_D1_OFFSET )
+        | ( ( get_increment_b_1D( p_trans->dst, p_trans ) & DMA_DST_PTR_INC_D1_INC_MASK ) << DMA_DESC_DST_INC_D1_OFFSET )
+        | ( ( p_trans->src_type & DMA_SRC_DATA_TYPE_DATA_TYPE_MASK ) << DMA_DESC_SRC_TYPE_OFFSET )
+        | ( ( p_trans->dst_type & DMA_DST_DATA_TYPE_DATA_TYPE_MASK ) << DMA_DESC_DST_TYPE_OFFSET )
+        | ( ( p_trans->sign_ext & 0x1 ) << DMA_DESC_SIGN_EXT_BIT )
+        | ( ( p_trans->dim & 0x1 ) << DMA_DESC_DIM_BIT )
+        | ( ( p_trans->dim_inv & 0x1 ) << DMA_DESC_DIM_INV_BIT );
+    p_desc->src_inc_d2 = 0;
+    p_desc->dst_inc_d2 = 0;
+    p_desc->flags   = p_flags;
+
+    if( p_trans->dim == DMA_DIM_CONF_2D )
+    {
+        p_desc->size       |= p_trans->size_d2_du << 16;
+        p_desc->src_inc_d2  = get_increment_b_2D( p_trans->src, p_trans ) & DMA_SRC_PTR_INC_D2_INC_MASK;
+        p_desc->dst_inc_d2  = get_increment_b_2D( p_trans->dst, p_trans ) & DMA_DST_PTR_INC_D2_INC_MASK;
+    }
+
+    return DMA_CONFIG_OK;
+}
+
+dma_config_flags_t dma_launch_chain( dma_trans_t *p_trans, dma_desc_t *p_desc )
+{
+    uint8_t channel = p_trans->channel;
+
+    /*
+     * Make sure that the loaded transaction is the intended transaction, as
+     * it holds the settings shared by the whole chain.
+     */
+    if(     ( p_desc == NULL )
+        ||  ( dma_subsys_per[channel].trans != p_trans ) )
+    {
+        return DMA_CONFIG_CRITICAL_ERROR;
+    }
+
+    /* A circular transaction would never move to the next descriptor. */
+    if( p_trans->mode != DMA_TRANS_MODE_SINGLE )
+    {
+        return DMA_CONFIG_INCOMPATIBLE;
+    }
+
+    if( !dma_is_ready(channel) || dma_subsys_per[channel].claimed )
+    {
+        return DMA_CONFIG_TRANS_OVERRIDE;
+    }
+
+    /*
+     * The registers end up holding the last descriptor of the chain, so the
+     * transaction cannot be relaunched with dma_launch() without loading it
+     * again.
+     */
+    dma_subsys_per[channel].trans = NULL;
+    dma_subsys_per[channel].intrFlag = 0;
+
+    /* Writing the pointer to the first descriptor starts the chain. */
+    dma_subsys_per[channel].peri->DESC_PTR = (uint32_t)p_desc;
+
+    /*
+     * Descriptors flagged with DMA_DESC_FLAG_INTR raise the interrupt in the
+     * middle of the chain, so the channel must also be ready to return.
+     */
+    while(    p_trans->end == DMA_TRANS_END_INTR_WAIT
+          && ( dma_subsys_per[channel].intrFlag == 0x0
+               || !dma_is_ready(channel) ) ) {
+            wait_for_interrupt();
+    }
+
+    return DMA_CONFIG_OK;
+}
+
+dma_config_flags_t dma_compile_transaction( dma_trans_t       *p_trans,
+                                            dma_trans_image_t *p_img )
+{
+    /*
+     * A successful transaction creation has to be done before compiling it.
+     */
+    if( p_trans->flags & DMA_CONFIG_CRITICAL_ERROR )
+    {
+        return DMA_CONFIG_CRITICAL_ERROR;
+    }
+
+    /*
+     * The registers are computed as in dma_load_transaction() and
+     * dma_launch(), without modifying the transaction.
+     */
+    dma_target_t src = *p_trans->src;
+    dma_dim_t dim = p_trans->dim;
+    uint32_t size_d2_du = p_trans->size_d2_du;
+
+    p_img->channel      = p_trans->channel;
+    p_img->end          = p_trans->end;
+    p_img->interrupt_en = INTR_EN_NONE;
+
+    if( p_trans->end != DMA_TRANS_END_POLLING )
+    {
+        p_img->interrupt_en = INTR_EN_TRANS_DONE;
+        if( p_trans->win_du > 0 )
+        {
+            p_img->interrupt_en |= INTR_EN_WINDOW_DONE;
+        }
+    }
+
+    #if DMA_ZERO_PADDING
+    p_img->pad_top    = 0;
+    p_img->pad_bottom = 0;
+    p_img->pad_left   = 0;
+    p_img->pad_right  = 0;
+
+    /* A 1D transaction with left or right padding is performed as a 2D one. */
+    if( dim == DMA_DIM_CONF_1D && (p_trans->pad_left_du != 0 || p_trans->pad_right_du != 0) )
+    {
+        dim = DMA_DIM_CONF_2D;
+        size_d2_du = 1;
+        src.inc_d2_du = DMA_DATA_TYPE_2_SIZE( p_trans->dst_type );
+        p_img->pad_left  = p_trans->pad_left_du;
+        p_img->pad_right = p_trans->pad_right_du;
+    }
+    else if( dim == DMA_DIM_CONF_2D )
+    {
+        p_img->pad_top    = p_trans->pad_top_du;
+        p_img->pad_bottom = p_trans->pad_bottom_du;
+        p_img->pad_left   = p_trans->pad_left_du;
+        p_img->pad_right  = p_trans->pad_right_du;
+    }
+    #endif
+
+    /*
+     * In address mode the destination addresses are read from the address
+     * port, so the destination pointer and increments are left out, as
+     * dma_load_transaction() does.
+     */
+    p_img->src_ptr    = (uint32_t)p_trans->src->ptr;
+    p_img->dst_ptr    = 0;
+    p_img->src_inc_d1 = get_increment_b_1D( &src, p_trans ) & DMA_SRC_PTR_INC_D1_INC_MASK;
+    p_img->dst_inc_d1 = 0;
+    p_img->src_inc_d2 = 0;
+    p_img->dst_inc_d2 = 0;
+    p_img->size_d2    = 0;
+    #if DMA_ADDR_MODE
+    p_img->addr_ptr = 0;
+    if( p_trans->mode == DMA_TRANS_MODE_ADDRESS )
+    {
+        p_img->addr_ptr = (uint32_t)p_trans->src_addr->ptr;
+    }
+    else
+    #endif
+    {
+        p_img->dst_ptr    = (uint32_t)p_trans->dst->ptr;
+        p_img->dst_inc_d1 = get_increment_b_1D( p_trans->dst, p_trans ) & DMA_DST_PTR_INC_D1_INC_MASK;
+    }
+
+    if( dim == DMA_DIM_CONF_2D )
+    {
+        p_img->src_inc_d2 = get_increment_b_2D( &src, p_trans ) & DMA_SRC_PTR_INC_D2_INC_MASK;
+        p_img->size_d2    = size_d2_du & DMA_SIZE_D2_SIZE_MASK;
+        if( p_trans->mode != DMA_TRANS_MODE_ADDRESS )
+        {
+            p_img->dst_inc_d2 = get_increment_b_2D( p_trans->dst, p_trans ) & DMA_DST_PTR_INC_D2_INC_MASK;
+        }
+    }
+
+    p_img->size_d1     = p_trans->size_d1_du & DMA_SIZE_D1_SIZE_MASK;
+    p_img->mode        = p_trans->mode;
+    p_img->window_size = p_trans->win_du;
+    #if DMA_HW_FIFO_MODE
+    p_img->hw_fifo_en  = p_trans->hw_fifo_en;
+    #endif
+    p_img->dim_config  = dim;
+    p_img->dim_inv     = p_trans->dim_inv << DMA_DIM_INV_SEL_BIT;
+    p_img->sign_ext    = p_trans->sign_ext << DMA_SIGN_EXT_SIGNED_BIT;
+    p_img->slot        = ( ( p_trans->src->trig & DMA_SLOT_RX_TRIGGER_SLOT_MASK ) << DMA_SLOT_RX_TRIGGER_SLOT_OFFSET )
+                       | ( ( p_trans->dst->trig & DMA_SLOT_TX_TRIGGER_SLOT_MASK ) << DMA_SLOT_TX_TRIGGER_SLOT_OFFSET );
+    p_img->src_type    = p_trans->src_type & DMA_SRC_DATA_TYPE_DATA_TYPE_MASK;
+    p_img->dst_type    = p_trans->dst_type & DMA_DST_DATA_TYPE_DATA_TYPE_MASK;
+
+    return DMA_CONFIG_OK;
+}
+
+dma_config_flags_t dma_launch_image( dma_trans_image_t *p_img,
+                                     uint8_t           *p_src,
+                                     uint8_t           *p_dst,
+                                     uint32_t          p_size_d1_du )
+{
+    uint8_t channel = p_img->channel;
+    dma *peri = dma_subsys_per[channel].peri;
+
+    if( !dma_is_ready(channel) || dma_subsys_per[channel].claimed )
+    {
+        return DMA_CONFIG_TRANS_OVERRIDE;
+    }
+
+    /* The overrides only go to the registers, the image keeps the compiled values. */
+    uint32_t src_ptr = p_src != NULL ? (uint32_t)p_src : p_img->src_ptr;
+    uint32_t dst_ptr = p_dst != NULL ? (uint32_t)p_dst : p_img->dst_ptr;
+    uint32_t size_d1 = p_size_d1_du != 0 ? p_size_d1_du & DMA_SIZE_D1_SIZE_MASK : p_img->size_d1;
+
+    if( p_img->end != DMA_TRANS_END_POLLING )
+    {
+        CSR_SET_BITS(CSR_REG_MSTATUS, 0x8);
+        CSR_SET_BITS(CSR_REG_MIE, DMA_DONE_CSR_REG_MIE_MASK );
+        CSR_SET_BITS(CSR_REG_MIE, DMA_WINDOW_CSR_REG_MIE_MASK );
+    }
+
+    /*
+     * The registers no longer hold the loaded transaction, so it cannot be
+     * relaunched with dma_launch() without loading it again.
+     */
+    dma_subsys_per[channel].trans = NULL;
+    dma_subsys_per[channel].intrFlag = 0;
+
+    peri->INTERRUPT_EN      = p_img->interrupt_en;
+    #if DMA_ZERO_PADDING
+    peri->PAD_TOP           = p_img->pad_top;
+    peri->PAD_BOTTOM        = p_img->pad_bottom;
+    peri->PAD_RIGHT         = p_img->pad_right;
+    peri->PAD_LEFT          = p_img->pad_left;
+    #endif
+    peri->SRC_PTR           = src_ptr;
+    #if DMA_ADDR_MODE
+    peri->ADDR_PTR          = p_img->addr_ptr;
+    /* The destination pointer and increments are not used in address mode. */
+    if( p_img->mode != DMA_TRANS_MODE_ADDRESS )
+    #endif
+    {
+        peri->DST_PTR           = dst_ptr;
+        peri->DST_PTR_INC_D1    = p_img->dst_inc_d1;
+        peri->DST_PTR_INC_D2    = p_img->dst_inc_d2;
+    }
+    peri->DIM_INV           = p_img->dim_inv;
+    peri->SRC_PTR_INC_D1    = p_img->src_inc_d1;
+    peri->SRC_PTR_INC_D2    = p_img->src_inc_d2;
+    peri->MODE              = p_img->mode;
+    peri->WINDOW_SIZE       = p_img->window_size ? p_img->window_size : size_d1;
+    #if DMA_HW_FIFO_MODE
+    peri->HW_FIFO_EN        = p_img->hw_fifo_en;
+    #endif
+    peri->DIM_CONFIG        = p_img->dim_config;
+    peri->SIGN_EXT          = p_img->sign_ext;
+    peri->SLOT              = p_img->slot;
+    peri->DST_DATA_TYPE     = p_img->dst_type;
+    peri->SRC_DATA_TYPE     = p_img->src_type;
+    peri->SIZE_D2           = p_img->size_d2;
+    /* Writing the size starts the transaction. */
+    peri->SIZE_D1           = size_d1;
+
+    while(    p_img->end == DMA_TRANS_END_INTR_WAIT
+          && ( dma_subsys_per[channel].intrFlag == 0x0 ) ) {
+            wait_for_interrupt();
+    }
+
+    return DMA_CONFIG_OK;
+}
+
 __attribute__((optimize("O0"))) uint32_t dma_is_ready(uint8_t channel)
 {
     /* The transaction READY bit is read from the status register*/
@@ -1189,6 +1528,36 @@ __attribute__((optimize("O0"))) uint32_t dma_is_ready(uint8_t channel)
  */
 
 
+uint32_t dma_claim_channel(uint8_t channel)
+{
+    uint32_t mstatus;
+    uint32_t ret = 0;
+
+    /* The claim may come from an interrupt handler, as for the SPI SDK */
+    CSR_READ(CSR_REG_MSTATUS, &mstatus);
+    CSR_CLEAR_BITS(CSR_REG_MSTATUS, 0x8);
+
+    /*
+     * A transaction that is loaded, launched or not, would be overwritten, so
+     * the channel is only given when none is.
+     */
+    if(     !dma_subsys_per[channel].claimed
+        &&  dma_subsys_per[channel].trans == NULL
+        &&  dma_is_ready(channel) )
+    {
+        dma_subsys_per[channel].claimed = 1;
+        ret = 1;
+    }
+
+    if (mstatus & 0x8) CSR_SET_BITS(CSR_REG_MSTATUS, 0x8);
+    return ret;
+}
+
+void dma_release_channel(uint8_t channel)
+{
+    dma_subsys_per[channel].claimed = 0;
+}
+
 uint32_t dma_get_window_count(uint8_t channel)
 {
     return dma_subsys_per[channel].peri->WINDOW_COUNT;
@@ -1204,6 +1573,33 @@ void dma_stop_circular(uint8_t channel)
     dma_subsys_per[channel].peri->MODE = DMA_TRANS_MODE_SINGLE;
 }
 
+void dma_set_window_callback(uint8_t channel, void (*p_cb)(uint8_t channel))
+{
+    dma_subsys_per[channel].window_cb = p_cb;
+}
+
+void dma_set_trans_done_callback(uint8_t channel, void (*p_cb)(uint8_t channel))
+{
+    dma_subsys_per[channel].done_cb = p_cb;
+}
+
+void dma_set_intr_priority(uint8_t channel, uint8_t priority)
+{
+    if (channel >= DMA_PENDING_CH_NUM || priority >= DMA_INTR_PRIO_LEVELS)
+    {
+        return;
+    }
+
+    for (int level = 0; level < DMA_INTR_PRIO_LEVELS - 1; level++)
+    {
+        dma_intr_prio_mask[level] &= ~(1u << channel);
+    }
+    if (priority > 0)
+    {
+        dma_intr_prio_mask[priority - 1] |= 1u << channel;
+    }
+}
+
 
 __attribute__((weak, optimize("O0"))) void dma_intr_handler_trans_done(uint8_t channel)
 {
@@ -1489,7 +1885,7 @@ static inline uint8_t is_region_outbound_2D(   uint8_t  *p_start,
 }
 
 static inline uint32_t get_increment_b_1D( dma_target_t * p_tgt,
-                                           uint8_t        channel)
+                                           dma_trans_t  * p_trans)
 {
     uint32_t inc_b = 0;
     /* If the target uses a trigger, the increment remains 0. */
@@ -1499,7 +1895,7 @@ static inline uint32_t get_increment_b_1D( dma_target_t * p_tgt,
          * If the transaction increment has been overriden (due to
          * misalignments), then that value is used (it's always set to 1).
          */
-        inc_b = dma_subsys_per[channel].trans->inc_b;
+        inc_b = p_trans->inc_b;
 
         /*
         * Otherwise, the target-specific increment is used transformed into
@@ -1515,7 +1911,7 @@ static inline uint32_t get_increment_b_1D( dma_target_t * p_tgt,
 }
 
 static inline uint32_t get_increment_b_2D( dma_target_t * p_tgt,
-                                           uint8_t channel )
+                                           dma_trans_t  * p_trans )
 {
     uint32_t inc_b = 0;
     /* If the target uses a trigger, the increment remains 0. */
@@ -1525,7 +1921,7 @@ static inline uint32_t get_increment_b_2D( dma_target_t * p_tgt,
          * If the transaction increment has been overriden (due to
          * misalignments), then that value is used (it's always set to 1).
          */
-        inc_b = dma_subsys_per[channel].trans->inc_b;
+        inc_b = p_trans->inc_b;
 
         /*
         * Otherwise, the target-specific increment is used transformed into
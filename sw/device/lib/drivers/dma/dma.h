@@ -51,6 +51,15 @@
 /**                                                                        **/
 /****************************************************************************/
 
+/**
+ * Returns the mask to enable/disable DMA transaction done interrupts.
+ */
+#define DMA_DONE_CSR_REG_MIE_MASK (( 1 << 19 )) // 19 is DMA fast interrupt bit in MIE CSR
+
+/**
+ * Returns the mask to enable/disable DMA window interrupts.
+ */
+#define DMA_WINDOW_CSR_REG_MIE_MASK (( 1 << 30 )) // 30 is DMA fast interrupt bit in MIE CSR
 
 /**
  * Wait Mode Defines
@@ -71,31 +80,40 @@
 #define DMA_INT_TR_START     0x0
 
 /* 
- * For multichannel configurations, a priority mechanism can be set up to allow the interrupt handler 
- * to prioritize a set of channels.
+ * For multichannel configurations, the interrupt handlers serve the channels by priority.
  * 
- * In order to enable this feature, the user must define DMA_HP_INTR_INDEX.
+ * The DMA subsystem exposes the pending transaction and window interrupts of all its channels
+ * in the TRANSACTION_PENDING and WINDOW_PENDING registers. The handlers read them and jump to
+ * the channel to serve (count trailing zeros), instead of polling the IFR of every channel.
  * 
- * When an interrupt is raised, the handler will loop through the channels. If the channel that
- * raised the interrupt is part of the high priority channels (index <= DMA_HP_INTR_INDEX), 
- * it will call the actual handler and exit the loop. 
- * It this way, low index channels will always be serviced first.
+ * Each channel has a priority between 0 (default) and DMA_INTR_PRIO_LEVELS - 1, which can be
+ * changed at any time with dma_set_intr_priority(). The pending channel with the highest
+ * priority is served first, the lowest channel first among equal priorities. The pending
+ * registers are read again after each handler, so a high priority channel that finishes while
+ * a low priority one is being served is the next to be served.
  * 
- * However, this feature could cause low priority channels to never be serviced if the high priority
- * interrupts are raised at a faster frequency.
- * In order to avoid this, the user can define DMA_NUM_HP_INTR (uint16_t).
- * This macro puts a limit to the number of consecutive interrupts raised by high priority channels 
- * that can trigger a "return".
- * If N = DMA_NUM_HP_INTR interrupts are raised by high priority channels, the N+1 interrupt will be
- * serviced and then no "return" will be triggered, thus allowing the handler's loop to continue and 
- * low priority channels to be serviced, if necessary.
+ * If DMA_HP_INTR_INDEX is defined, dma_init() gives the highest priority to the channels
+ * whose index is <= DMA_HP_INTR_INDEX.
  * 
- * The priority mechanism is applied to both transaction done and window done interrupts, if enabled.
- * Separate counters are used for each type of interrupt.
+ * The priority mechanism is applied to both transaction done and window done interrupts.
  */
 
 //#define DMA_HP_INTR_INDEX 0
-//#define DMA_NUM_HP_INTR 5
+
+#ifdef DMA_NUM_HP_INTR
+#error "DMA_NUM_HP_INTR is no longer supported: all the pending channels are served in the same interrupt, by priority. Use DMA_HP_INTR_INDEX or dma_set_intr_priority() instead."
+#endif
+
+/**
+ * Number of interrupt priority levels.
+ */
+#define DMA_INTR_PRIO_LEVELS 4
+
+/**
+ * Number of channels covered by the pending interrupt registers. The other
+ * channels are polled after them, with priority 0.
+ */
+#define DMA_PENDING_CH_NUM (DMA_CH_NUM > 32 ? 32 : DMA_CH_NUM)
 
 
 #ifdef __cplusplus
@@ -109,6 +127,24 @@ extern "C" {
 
 #define DMA_SELECTION_OFFSET_START 0
 
+/**
+ * Layout of the config word of a descriptor (see dma_desc_t).
+ */
+#define DMA_DESC_SRC_INC_D1_OFFSET  0
+#define DMA_DESC_DST_INC_D1_OFFSET  8
+#define DMA_DESC_SRC_TYPE_OFFSET    16
+#define DMA_DESC_DST_TYPE_OFFSET    18
+#define DMA_DESC_SIGN_EXT_BIT       20
+#define DMA_DESC_DIM_BIT            21
+#define DMA_DESC_DIM_INV_BIT        22
+
+/**
+ * Flags of a descriptor.
+ */
+#define DMA_DESC_FLAG_INTR          0x1 /*!< Raise the transaction done
+interrupt once this descriptor is finished, and not only at the end of the
+chain. */
+
 /****************************************************************************/
 /**                                                                        **/
 /**                       TYPEDEFS AND STRUCTURES                          **/
@@ -390,6 +426,78 @@ typedef struct
     uint8_t             channel; /*!< The channel to use. */
 } dma_trans_t;
 
+/**
+ * A descriptor is a transaction stored in memory, that the DMA fetches and
+ * performs by itself. Descriptors are linked through their next pointer into
+ * a chain, so a sequence of transactions (e.g. the tiles of a tensor) runs
+ * without any intervention of the CPU between them.
+ * Its layout is the one expected by the DMA hardware: do not reorder the
+ * fields. It is filled by dma_desc_build().
+ */
+typedef struct dma_desc
+{
+    struct dma_desc*    next;       /*!< Next descriptor of the chain, NULL
+    for the last one. */
+    uint32_t            src_ptr;    /*!< Source pointer. */
+    uint32_t            dst_ptr;    /*!< Destination pointer. */
+    uint32_t            size;       /*!< Size along D1 (bits 15:0) and D2
+    (bits 31:16), in data units. */
+    uint32_t            config;     /*!< D1 increments, data types, sign
+    extension, dimensionality and transposition (see DMA_DESC_*_OFFSET). */
+    uint32_t            src_inc_d2; /*!< Source D2 increment, in bytes. */
+    uint32_t            dst_inc_d2; /*!< Destination D2 increment, in bytes. */
+    uint32_t            flags;      /*!< A mask of DMA_DESC_FLAG_*. */
+} dma_desc_t;
+
+/**
+ * The register image of a transaction, compiled once by
+ * dma_compile_transaction(). Launching it through dma_launch_image() is a
+ * plain burst of register writes, without any validation nor computation, so
+ * an identical transfer (only the pointers and sizes may change) can be
+ * relaunched at a fraction of the cost of dma_load_transaction() and
+ * dma_launch().
+ */
+typedef struct
+{
+    uint32_t            src_ptr;        /*!< SRC_PTR register. */
+    uint32_t            dst_ptr;        /*!< DST_PTR register, not written in
+    address mode. */
+    #if DMA_ADDR_MODE
+    uint32_t            addr_ptr;       /*!< ADDR_PTR register. */
+    #endif
+    uint32_t            size_d1;        /*!< SIZE_D1 register, written last as
+    it starts the transaction. */
+    uint32_t            size_d2;        /*!< SIZE_D2 register. */
+    uint32_t            src_inc_d1;     /*!< SRC_PTR_INC_D1 register. */
+    uint32_t            src_inc_d2;     /*!< SRC_PTR_INC_D2 register. */
+    uint32_t            dst_inc_d1;     /*!< DST_PTR_INC_D1 register, not
+    written in address mode. */
+    uint32_t            dst_inc_d2;     /*!< DST_PTR_INC_D2 register, not
+    written in address mode. */
+    uint32_t            slot;           /*!< SLOT register. */
+    uint32_t            src_type;       /*!< SRC_DATA_TYPE register. */
+    uint32_t            dst_type;       /*!< DST_DATA_TYPE register. */
+    uint32_t            sign_ext;       /*!< SIGN_EXT register. */
+    uint32_t            mode;           /*!< MODE register. */
+    #if DMA_HW_FIFO_MODE
+    uint32_t            hw_fifo_en;     /*!< HW_FIFO_EN register. */
+    #endif
+    uint32_t            dim_config;     /*!< DIM_CONFIG register. */
+    uint32_t            dim_inv;        /*!< DIM_INV register. */
+    #if DMA_ZERO_PADDING
+    uint32_t            pad_top;        /*!< PAD_TOP register. */
+    uint32_t            pad_bottom;     /*!< PAD_BOTTOM register. */
+    uint32_t            pad_right;      /*!< PAD_RIGHT register. */
+    uint32_t            pad_left;       /*!< PAD_LEFT register. */
+    #endif
+    uint32_t            window_size;    /*!< WINDOW_SIZE register, 0 if it
+    follows SIZE_D1 (no window). */
+    uint32_t            interrupt_en;   /*!< INTERRUPT_EN register. */
+    dma_trans_end_evt_t end;            /*!< What should happen after the
+    transaction is launched. */
+    uint8_t             channel;        /*!< The channel to use. */
+} dma_trans_image_t;
+
 /****************************************************************************/
 /**                                                                        **/
 /**                          EXPORTED VARIABLES                            **/
@@ -506,6 +614,80 @@ dma_config_flags_t dma_load_transaction( dma_trans_t* p_trans);
  */
 dma_config_flags_t dma_launch( dma_trans_t* p_trans);
 
+/**
+ * @brief Translates a transaction (that has been previously validated through
+ * dma_validate_transaction()) into a descriptor and links it to the next one.
+ * All the checks are done here, once, so the chain can then be launched as
+ * many times as needed at no cost.
+ * @param p_desc Pointer to the descriptor to fill. It must stay in memory
+ * (e.g. be a static variable) while the chain is running.
+ * @param p_trans Pointer to the validated transaction. It must be a single
+ * mode transaction without padding, address mode nor HW FIFO. Its interrupt,
+ * trigger and window settings are ignored: those of a chain are the ones of the
+ * transaction passed to dma_launch_chain().
+ * @param p_next Pointer to the next descriptor of the chain, NULL to end it.
+ * @param p_flags A mask of DMA_DESC_FLAG_*.
+ * @retval DMA_CONFIG_CRITICAL_ERROR | DMA_CONFIG_INCOMPATIBLE if the
+ * transaction cannot be described by a descriptor.
+ * @retval DMA_CONFIG_CRITICAL_ERROR if the transaction was not validated.
+ * @retval DMA_CONFIG_OK == 0 otherwise.
+ */
+dma_config_flags_t dma_desc_build( dma_desc_t    *p_desc,
+                                   dma_trans_t   *p_trans,
+                                   dma_desc_t    *p_next,
+                                   uint32_t      p_flags );
+
+/**
+ * @brief Launches a chain of descriptors. The DMA fetches each descriptor,
+ * performs it and moves on to the next one until the end of the chain.
+ * @param p_trans A pointer to a loaded single mode transaction (see
+ * dma_load_transaction()). It sets the channel, the end event, the triggers and
+ * the window of the whole chain. It has to be loaded again before each chain
+ * or dma_launch().
+ * @param p_desc A pointer to the first descriptor of the chain.
+ * @note With the INTR_WAIT end event, the function returns at the end of the
+ * chain. The transaction done interrupt is raised at the end of the chain and
+ * after the descriptors flagged with DMA_DESC_FLAG_INTR.
+ * @retval DMA_CONFIG_CRITICAL_ERROR if the passed transaction does not
+ * correspond with the loaded one or the chain is empty.
+ * @retval DMA_CONFIG_INCOMPATIBLE if the transaction is not in single mode.
+ * @retval DMA_CONFIG_TRANS_OVERRIDE if a transaction is running.
+ * @retval DMA_CONFIG_OK == 0 otherwise.
+ */
+dma_config_flags_t dma_launch_chain( dma_trans_t *p_trans, dma_desc_t *p_desc );
+
+/**
+ * @brief Compiles a transaction (that has been previously validated through
+ * dma_validate_transaction()) into the image of the registers that
+ * dma_load_transaction() and dma_launch() would write.
+ * @param p_trans Pointer to the validated transaction. It is not modified.
+ * @param p_img Pointer to the image to fill.
+ * @retval DMA_CONFIG_CRITICAL_ERROR if the transaction contains a critical
+ * error.
+ * @retval DMA_CONFIG_OK == 0 otherwise.
+ */
+dma_config_flags_t dma_compile_transaction( dma_trans_t       *p_trans,
+                                            dma_trans_image_t *p_img );
+
+/**
+ * @brief Writes a compiled transaction into the registers of its channel and
+ * starts it. No check is performed other than the channel being ready.
+ * @param p_img Pointer to the compiled image. It is not modified: the
+ * overrides below only apply to this launch.
+ * @param p_src New source pointer, NULL to keep the compiled one.
+ * @param p_dst New destination pointer, NULL to keep the compiled one. It is
+ * ignored in address mode.
+ * @param p_size_d1_du New size along D1 in data units, 0 to keep the compiled
+ * one. It is the caller's responsibility to keep the transfer in bounds and
+ * aligned, as for the window size that was compiled.
+ * @retval DMA_CONFIG_TRANS_OVERRIDE if a transaction is running.
+ * @retval DMA_CONFIG_OK == 0 otherwise.
+ */
+dma_config_flags_t dma_launch_image( dma_trans_image_t *p_img,
+                                     uint8_t           *p_src,
+                                     uint8_t           *p_dst,
+                                     uint32_t          p_size_d1_du );
+
 /**
  * @brief Read from the done register of the DMA. Additionally decreases the
  * count of simultaneously-launched transactions. Be careful when calling this
@@ -521,6 +703,25 @@ dma_config_flags_t dma_launch( dma_trans_t* p_trans);
  */
 uint32_t dma_is_ready(uint8_t channel);
 
+/**
+ * @brief Claims a channel for a library that programs its registers directly
+ * (e.g. the SPI SDK). Until dma_release_channel() is called, loading or
+ * launching a transaction on the channel returns DMA_CONFIG_TRANS_OVERRIDE.
+ * @param channel The channel to claim.
+ * @retval 1 if the channel was claimed.
+ * @retval 0 if it is running, claimed already or holds a loaded transaction
+ * (transactions launched with dma_launch_image() or dma_launch_chain() leave
+ * none loaded).
+ */
+uint32_t dma_claim_channel(uint8_t channel);
+
+/**
+ * @brief Releases a channel claimed with dma_claim_channel(), once the
+ * transaction the claimer started is over.
+ * @param channel The channel to release.
+ */
+void dma_release_channel(uint8_t channel);
+
 /**
  * @brief Get the number of windows that have already been written. Resets on
  * the start of each transaction.
@@ -538,6 +739,33 @@ uint32_t dma_get_window_count(uint8_t channel);
  */
 void dma_stop_circular(uint8_t channel);
 
+/**
+ * @brief Sets a function to be called by the window done interrupt of a
+ * channel instead of dma_intr_handler_window_done(). It lets a library (e.g.
+ * the streams of the DMA SDK) own the window interrupts of a channel without
+ * overriding the handler of the whole application.
+ * @param channel The channel.
+ * @param p_cb The function to call, NULL to restore the default handler.
+ */
+void dma_set_window_callback(uint8_t channel, void (*p_cb)(uint8_t channel));
+
+/**
+ * @brief Sets a function to be called by the transaction done interrupt of a
+ * channel instead of dma_intr_handler_trans_done(), in the same way as
+ * dma_set_window_callback() (e.g. for the flash streams of the W25Q BSP).
+ * @param channel The channel.
+ * @param p_cb The function to call, NULL to restore the default handler.
+ */
+void dma_set_trans_done_callback(uint8_t channel, void (*p_cb)(uint8_t channel));
+
+/**
+ * @brief Sets the priority with which the interrupts of a channel are
+ * served when several channels raise them together.
+ * @param channel The channel, below DMA_PENDING_CH_NUM.
+ * @param priority From 0 (default, lowest) to DMA_INTR_PRIO_LEVELS - 1.
+ */
+void dma_set_intr_priority(uint8_t channel, uint8_t priority);
+
 /**
 * @brief DMA interrupt handler.
 * `dma.c` provides a weak definition of this symbol, which can be overridden
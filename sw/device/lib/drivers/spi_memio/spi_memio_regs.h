@@ -23,6 +23,21 @@ extern "C" {
 // Cfg SPIMEM
 #define OBI_SPIMEMIO_CFG_SPIMEM_REG_OFFSET 0x4
 
+// Read cache control
+#define OBI_SPIMEMIO_CACHE_CTRL_REG_OFFSET 0x8
+#define OBI_SPIMEMIO_CACHE_CTRL_EN_BIT 0
+#define OBI_SPIMEMIO_CACHE_CTRL_PREFETCH_EN_BIT 1
+
+// Read cache flush
+#define OBI_SPIMEMIO_CACHE_FLUSH_REG_OFFSET 0xc
+#define OBI_SPIMEMIO_CACHE_FLUSH_FLUSH_BIT 0
+
+// Read cache hits
+#define OBI_SPIMEMIO_CACHE_HITS_REG_OFFSET 0x10
+
+// Read cache misses
+#define OBI_SPIMEMIO_CACHE_MISSES_REG_OFFSET 0x14
+
 #ifdef __cplusplus
 }  // extern "C"
 #endif
@@ -6,6 +6,7 @@
     user_peripheral_domain = xheep.get_user_peripheral_domain()
     base_peripheral_domain = xheep.get_base_peripheral_domain()
     dma = base_peripheral_domain.get_dma()
+    spi_memio = base_peripheral_domain.get_spi_memio()
     memory_ss = xheep.memory_ss()
 %>
 
@@ -65,11 +66,20 @@ extern "C" {
 #define DMA_CH_NUM ${hex(dma.get_num_channels())[2:]}
 #define DMA_CH_SIZE 0x${hex(dma.get_ch_length())[2:]}
 #define DMA_NUM_MASTER_PORTS ${hex(dma.get_num_master_ports())[2:]}
+#define DMA_CH_PER_MASTER_PORT ${hex(dma.get_num_channels_per_master_port())[2:]}
+% if dma.get_num_master_ports() > 1:
+// Channels of each master port crossbar, as DMA_XBAR_MASTERS in core_v_mini_mcu_pkg
+#define DMA_XBAR_MASTERS {${dma.get_xbar_array()[::-1]}}
+% endif
 #define DMA_ADDR_MODE ${dma.get_addr_mode()}
 #define DMA_SUBADDR_MODE ${dma.get_subaddr_mode()}
 #define DMA_HW_FIFO_MODE ${dma.get_hw_fifo_mode()}
 #define DMA_ZERO_PADDING ${dma.get_zero_padding()}
 
+#define SPIMEMIO_CACHE_LINE_SIZE ${spi_memio.get_cache_line_size()}
+#define SPIMEMIO_CACHE_NUM_LINES ${spi_memio.get_cache_num_lines()}
+#define SPIMEMIO_CACHE_PREFETCH ${spi_memio.get_cache_prefetch()}
+
 // user peripherals
 #define PERIPHERAL_START_ADDRESS ${hex(user_peripheral_domain.get_start_address())}
 #define PERIPHERAL_SIZE ${hex(user_peripheral_domain.get_length())}
@@ -26,6 +26,9 @@ extern "C"
 
     volatile uint8_t dma_sdk_intr_flag;
 
+    /* Stream running on each channel */
+    static dma_stream_t *dma_streams[DMA_CH_NUM];
+
 #define DMA_REGISTER_SIZE_BYTES sizeof(int)
 #define DMA_SELECTION_OFFSET_START 0
 
@@ -41,6 +44,36 @@ extern "C"
         peri->SIZE_D1 = (uint32_t)((size) & DMA_SIZE_D1_SIZE_MASK);
     }
 
+    /*
+     * Gives the channels behind a master port, as routed by dma_subsystem and
+     * dma_NtoM_xbar: the range [first, first + count).
+     */
+    static uint32_t dma_port_channels(uint32_t port, uint32_t *first)
+    {
+#if DMA_NUM_MASTER_PORTS == 1
+        *first = 0;
+        return DMA_CH_NUM;
+#elif DMA_NUM_MASTER_PORTS == DMA_CH_NUM
+        *first = port;
+        return 1;
+#else
+        static const uint32_t xbar_masters[DMA_NUM_MASTER_PORTS] = DMA_XBAR_MASTERS;
+        if (port == 0)
+        {
+            *first = 0;
+        }
+        else if (xbar_masters[port] == 1)
+        {
+            *first = port + xbar_masters[0] - 1;
+        }
+        else
+        {
+            *first = xbar_masters[port - 1];
+        }
+        return xbar_masters[port];
+#endif
+    }
+
     // Initialize the DMA
     void dma_sdk_init(void)
     {
@@ -106,6 +139,187 @@ extern "C"
         return;
     }
 
+    uint8_t dma_copy_parallel(uint32_t dst_ptr, uint32_t src_ptr, uint32_t size, dma_data_type_t type)
+    {
+        uint8_t channels[DMA_CH_NUM];
+        uint8_t taken[DMA_CH_NUM] = {0};
+        uint8_t num = 0;
+        uint32_t type_size = DMA_DATA_TYPE_2_SIZE(type);
+
+        /*
+         * Take the free channels in turn from each master port, so that the
+         * first chunks go through different ports.
+         */
+        for (uint32_t i = 0; i < DMA_CH_NUM; i++)
+        {
+            for (uint32_t port = 0; port < DMA_NUM_MASTER_PORTS; port++)
+            {
+                uint32_t first;
+                uint32_t channel;
+                if (i >= dma_port_channels(port, &first))
+                {
+                    continue;
+                }
+                channel = first + i;
+                if (channel < DMA_CH_NUM && !taken[channel] && dma_is_ready(channel))
+                {
+                    taken[channel] = 1;
+                    channels[num++] = channel;
+                }
+            }
+        }
+        /* Channels the port ranges missed, if any */
+        for (uint32_t channel = 0; channel < DMA_CH_NUM; channel++)
+        {
+            if (!taken[channel] && dma_is_ready(channel))
+            {
+                taken[channel] = 1;
+                channels[num++] = channel;
+            }
+        }
+
+        /* The busy channels may belong to someone else (e.g. a stream), nothing is copied */
+        if (num == 0)
+        {
+            return 0;
+        }
+
+        /* Small copies are not worth the setup of several channels */
+        if (size / DMA_PARALLEL_MIN_CHUNK < num)
+        {
+            num = size / DMA_PARALLEL_MIN_CHUNK ? size / DMA_PARALLEL_MIN_CHUNK : 1;
+        }
+
+        uint32_t chunk = (size + num - 1) / num;
+        if (chunk > DMA_SIZE_D1_SIZE_MASK)
+        {
+            chunk = DMA_SIZE_D1_SIZE_MASK;
+        }
+
+        while (size > 0)
+        {
+            uint8_t used = 0;
+            for (; used < num && size > 0; used++)
+            {
+                uint32_t len = size < chunk ? size : chunk;
+                volatile dma *the_dma = dma_peri(channels[used]);
+                DMA_COPY(dst_ptr, src_ptr, len, type, type, 0, the_dma);
+                dma_start(the_dma, len, type);
+                dst_ptr += len * type_size;
+                src_ptr += len * type_size;
+                size -= len;
+            }
+            for (uint8_t i = 0; i < used; i++)
+            {
+                DMA_WAIT(channels[i]);
+            }
+        }
+        return num;
+    }
+
+    static void dma_stream_window_handler(uint8_t channel)
+    {
+        dma_stream_t *stream = dma_streams[channel];
+        uint32_t index = stream->filled % stream->buf_num;
+
+        stream->filled++;
+        if (stream->callback != NULL)
+        {
+            stream->callback(stream, stream->buffers + index * stream->buf_size, index);
+        }
+    }
+
+    dma_config_flags_t dma_stream_start(dma_stream_t *stream)
+    {
+        dma_config_flags_t res;
+        uint32_t buf_du = stream->buf_size / DMA_DATA_TYPE_2_SIZE(stream->type);
+
+        if (stream->buf_num < 2 || buf_du == 0 || stream->buf_num * buf_du > DMA_SIZE_D1_SIZE_MASK)
+        {
+            return DMA_CONFIG_INCOMPATIBLE | DMA_CONFIG_CRITICAL_ERROR;
+        }
+
+        stream->filled = 0;
+        stream->consumed = 0;
+        stream->overruns = 0;
+
+        /* A peripheral is read without increment, a memory region as the ring */
+        stream->src_tgt = (dma_target_t){
+            .ptr = (uint8_t *)stream->src_ptr,
+            .inc_d1_du = stream->src_trig == DMA_TRIG_MEMORY ? 1 : 0,
+            .type = stream->type,
+            .trig = stream->src_trig,
+        };
+        stream->dst_tgt = (dma_target_t){
+            .ptr = stream->buffers,
+            .inc_d1_du = 1,
+            .type = stream->type,
+            .trig = DMA_TRIG_MEMORY,
+        };
+        stream->trans = (dma_trans_t){
+            .src = &stream->src_tgt,
+            .dst = &stream->dst_tgt,
+            .size_d1_du = stream->buf_num * buf_du,
+            .src_type = stream->type,
+            .dst_type = stream->type,
+            .mode = DMA_TRANS_MODE_CIRCULAR,
+            .win_du = buf_du,
+            .end = DMA_TRANS_END_INTR,
+            .channel = stream->channel,
+        };
+
+        res = dma_validate_transaction(&stream->trans, DMA_DO_NOT_ENABLE_REALIGN, DMA_PERFORM_CHECKS_INTEGRITY);
+        if (res & DMA_CONFIG_CRITICAL_ERROR)
+        {
+            return res;
+        }
+
+        dma_streams[stream->channel] = stream;
+        dma_set_window_callback(stream->channel, dma_stream_window_handler);
+
+        res = dma_load_transaction(&stream->trans);
+        res |= dma_launch(&stream->trans);
+        if (res != DMA_CONFIG_OK)
+        {
+            dma_set_window_callback(stream->channel, NULL);
+            dma_streams[stream->channel] = NULL;
+        }
+        return res;
+    }
+
+    uint8_t *dma_stream_get(dma_stream_t *stream)
+    {
+        while (stream->filled == stream->consumed)
+        {
+            CSR_CLEAR_BITS(CSR_REG_MSTATUS, 0x8);
+            if (stream->filled == stream->consumed)
+            {
+                wait_for_interrupt();
+            }
+            CSR_SET_BITS(CSR_REG_MSTATUS, 0x8);
+        }
+
+        uint32_t filled = stream->filled;
+        if (filled - stream->consumed >= stream->buf_num)
+        {
+            /* The DMA wrapped around: the oldest buffers were overwritten */
+            stream->overruns += filled - 1 - stream->consumed;
+            stream->consumed = filled - 1;
+        }
+
+        uint8_t *buffer = stream->buffers + (stream->consumed % stream->buf_num) * stream->buf_size;
+        stream->consumed++;
+        return buffer;
+    }
+
+    void dma_stream_stop(dma_stream_t *stream)
+    {
+        dma_stop_circular(stream->channel);
+        DMA_WAIT(stream->channel);
+        dma_set_window_callback(stream->channel, NULL);
+        dma_streams[stream->channel] = NULL;
+    }
+
 #ifdef __cplusplus
 }
 #endif
@@ -55,6 +55,11 @@ extern "C"
     DMA_PERI->SRC_DATA_TYPE = (uint32_t)(DMA_DATA_TYPE_WORD & DMA_SRC_DATA_TYPE_DATA_TYPE_MASK);
 #endif
 
+/* Smallest chunk (in data units) given to a channel by dma_copy_parallel() */
+#ifndef DMA_PARALLEL_MIN_CHUNK
+#define DMA_PARALLEL_MIN_CHUNK 64
+#endif
+
 #define DMA_WAIT(CH)                          \
     while (!dma_is_ready(CH))                 \
     {                                         \
@@ -66,6 +71,56 @@ extern "C"
         CSR_SET_BITS(CSR_REG_MSTATUS, 0x8);   \
     }
 
+    /*******************************/
+    /* ---- TYPE DEFINITIONS ---- */
+    /*******************************/
+
+    struct dma_stream;
+
+    /**
+     * @brief Function called when a buffer of a stream has been filled.
+     *
+     * It runs in the window interrupt of the stream channel, while the DMA
+     * fills the next buffer, so it should only hand the buffer off.
+     *
+     * @param stream  The stream.
+     * @param buffer  Pointer to the filled buffer.
+     * @param index   Index of the filled buffer in the ring.
+     */
+    typedef void (*dma_stream_cb_t)(struct dma_stream *stream, uint8_t *buffer, uint32_t index);
+
+    /**
+     * @brief Ping-pong (or N-buffer) stream.
+     *
+     * The DMA copies the source into a ring of buf_num contiguous buffers in
+     * circular mode and raises a window interrupt every filled buffer, so the
+     * application processes a buffer while the next ones are being filled.
+     * The configuration fields are set by the application before calling
+     * dma_stream_start(). The structure must be a static variable.
+     */
+    typedef struct dma_stream
+    {
+        /* Configuration */
+        uint32_t src_ptr;                 /*!< Peripheral FIFO or memory region to read. */
+        dma_trigger_slot_mask_t src_trig; /*!< Trigger of the source peripheral, DMA_TRIG_MEMORY
+                                               for a memory region of buf_num * buf_size bytes. */
+        uint8_t *buffers;                 /*!< buf_num contiguous buffers of buf_size bytes. */
+        uint32_t buf_size;                /*!< Size of a buffer in bytes, multiple of the data type size. */
+        uint32_t buf_num;                 /*!< Number of buffers, at least 2. */
+        dma_data_type_t type;             /*!< Data type of the transfer. */
+        uint8_t channel;                  /*!< DMA channel to be used. */
+        dma_stream_cb_t callback;         /*!< Called for each filled buffer, may be NULL. */
+        void *arg;                        /*!< Free for the application. */
+
+        /* State */
+        volatile uint32_t filled; /*!< Number of buffers filled since the start. */
+        uint32_t consumed;        /*!< Number of buffers returned by dma_stream_get(). */
+        uint32_t overruns;        /*!< Number of buffers overwritten before being returned. */
+        dma_target_t src_tgt;
+        dma_target_t dst_tgt;
+        dma_trans_t trans;
+    } dma_stream_t;
+
     /********************************/
     /* ---- EXPORTED VARIABLES ---- */
     /********************************/
@@ -121,6 +176,49 @@ extern "C"
 
     void __attribute__((noinline)) dma_wait(uint8_t channel);
 
+    /**
+     * @brief Copies data from source to destination splitting it across the
+     * free DMA channels, spread over the master ports, and waits for all of
+     * them.
+     *
+     * @param dst_ptr   Pointer to the destination memory location.
+     * @param src_ptr   Pointer to the source memory location.
+     * @param size      Number of data units to be copied.
+     * @param type      Variable type (byte, half-word, word) of both source and destination.
+     * @return The number of channels used, 0 if no channel is free (nothing is
+     * copied then).
+     */
+    uint8_t dma_copy_parallel(uint32_t dst_ptr, uint32_t src_ptr, uint32_t size, dma_data_type_t type);
+
+    /**
+     * @brief Starts a stream.
+     *
+     * @param stream  Pointer to the configured stream.
+     * @return DMA_CONFIG_OK if the stream is running, the flags returned by the
+     *         driver otherwise.
+     */
+    dma_config_flags_t dma_stream_start(dma_stream_t *stream);
+
+    /**
+     * @brief Waits for the next filled buffer of a stream.
+     *
+     * The buffer belongs to the application until the next call. When the
+     * application is too slow and the DMA has wrapped around the ring, the
+     * lost buffers are counted in stream->overruns and the most recent one is
+     * returned.
+     *
+     * @param stream  Pointer to the stream.
+     * @return Pointer to the filled buffer.
+     */
+    uint8_t *dma_stream_get(dma_stream_t *stream);
+
+    /**
+     * @brief Stops a stream at the end of the current ring and waits for it.
+     *
+     * @param stream  Pointer to the stream.
+     */
+    void dma_stream_stop(dma_stream_t *stream);
+
 #ifdef __cplusplus
 }
 #endif // __cplusplus
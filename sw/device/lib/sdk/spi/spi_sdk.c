@@ -36,6 +36,8 @@
 #include "spi_host.h"
 #include "spi_host_regs.h"
 #include "soc_ctrl_structs.h"
+#include "dma.h"
+#include "core_v_mini_mcu.h"
 #include "bitfield.h"
 #include "csr.h"
 
@@ -66,6 +68,8 @@
 #define SPD_INDEX    2
 
 #define TRIGGERING_EVENTS (SPI_EVENT_IDLE | SPI_EVENT_READY | SPI_EVENT_TXWM | SPI_EVENT_RXWM)
+// When the DMA moves the data only the command segments are handled by interrupts
+#define DMA_TRIGGERING_EVENTS (SPI_EVENT_IDLE | SPI_EVENT_READY)
 
 // The standard watermark for all transactions (seems reasonable)
 #define TXWM_DEFAULT (SPI_HOST_PARAM_TX_DEPTH / 4)  // Arbirarily chosen
@@ -80,6 +84,12 @@
 // Check command length validity
 #define SPI_INVALID_LEN(len) (len == 0 || len > MAX_COMMAND_LENGTH)
 
+// DMA channel status
+#define SPI_DMA_PERI     (dma_peri(SPI_DMA_CHANNEL))
+#define SPI_DMA_READY()  (SPI_DMA_PERI->STATUS & (1 << DMA_STATUS_READY_BIT))
+// Direction moved by the DMA: the larger one, the CPU moving the other
+#define SPI_DMA_MOVES_TX(txn) (txn.txbuffer != NULL && txn.txlen >= (txn.rxbuffer != NULL ? txn.rxlen : 0))
+
 /**
  * @brief Allows easy TX Transaction instantiation.
  */
@@ -146,6 +156,15 @@ typedef struct {
     uint32_t             rxlen;     // Size of RX array/buffer
 } spi_transaction_t;
 
+/**
+ * @brief Transaction waiting in the queue of a peripheral.
+ */
+typedef struct {
+    spi_t             spi;       // Copy of the spi_t that requested the transaction
+    spi_transaction_t txn;       // Transaction data (segments, buffers, lengths)
+    spi_callbacks_t   callbacks; // Callback functions to call
+} spi_queued_t;
+
 /**
  * @brief Structure to hold all relative information about a particular peripheral.
  *  peripherals variable in this file holds an instance of this structure for every
@@ -164,6 +183,13 @@ typedef struct {
     uint32_t          txcnt;     // Counter to track TX word being processed
     uint32_t          rxcnt;     // Counter to track RX word being processed
     spi_callbacks_t   callbacks; // Callback functions to call
+    uint16_t          dma_rx;    // DMA trigger slot of the RX FIFO (0 if none)
+    uint16_t          dma_tx;    // DMA trigger slot of the TX FIFO (0 if none)
+    bool              dma;       // Current transaction data is moved by the DMA
+    spi_queued_t      queue[SPI_QUEUE_LEN]; // Transactions waiting to be launched
+    uint8_t           qhead;     // Index of the next transaction of the queue
+    uint8_t           qlen;      // Number of transactions in the queue
+    uint32_t          txn_cnt;   // Number of transactions finished (done or error)
 } spi_peripheral_t;
 
 /****************************************************************************/
@@ -196,6 +222,15 @@ spi_codes_e spi_validate_slave(spi_slave_t slave);
  */
 spi_codes_e spi_set_slave(spi_t* spi);
 
+/**
+ * @brief Sets the slave at hardware level if it is not the one of the last 
+ *  transaction of the peripheral.
+ * 
+ * @param spi Pointer to spi_t structure obtained through spi_init call
+ * @return spi_codes_e information about error. SPI_CODE_OK if all went well
+ */
+spi_codes_e spi_select_slave(spi_t* spi);
+
 /**
  * @brief Validation and configuration of device prior to any transaction.
  * 
@@ -258,13 +293,43 @@ void spi_launch(spi_peripheral_t* peri, spi_t* spi, spi_transaction_t txn,
                 spi_callbacks_t callbacks);
 
 /**
- * @brief Issues a command segment and increments counter (post inc.).
- *  Determines value of CSAAT bit based on if it is last segment of transaction 
- *  or not.
+ * @brief Starts a DMA transaction moving the data of the larger direction of the
+ *  current transaction between memory and the TX or RX FIFO, if the transaction 
+ *  is eligible (at least SPI_DMA_THRESHOLD bytes, other direction fitting in its
+ *  FIFO, peripheral with trigger slots and SDK DMA channel free).
  * 
  * @param peri Pointer to the relevant spi_peripheral_t instance
+ * @return true if the DMA moves the data of the larger direction
+ * @return false if all the data has to be moved by the CPU
  */
-void spi_wait_transaction_done(spi_peripheral_t* peri);
+bool spi_dma_launch(spi_peripheral_t* peri);
+
+/**
+ * @brief Brings the DMA transaction of the current SPI transaction, if any, to
+ *  its end so that the channel is free again. To be called before resetting the
+ *  SPI peripheral, whose FIFOs won't raise the DMA triggers anymore.
+ * 
+ * @param peri Pointer to the relevant spi_peripheral_t instance
+ */
+void spi_dma_abort(spi_peripheral_t* peri);
+
+/**
+ * @brief Waits until the transaction launched by a blocking call is over, or
+ *  resets the peripheral if it times out.
+ * 
+ * @param peri Pointer to the relevant spi_peripheral_t instance
+ * @param txn_cnt Count of finished transactions read before the launch
+ */
+void spi_wait_transaction_done(spi_peripheral_t* peri, uint32_t txn_cnt);
+
+/**
+ * @brief Launches the next transaction of the queue if the peripheral is not
+ *  busy. Called when a transaction finishes and when a transaction is queued.
+ *  Must be called with interrupts disabled (or from the SPI interrupt).
+ * 
+ * @param peri Pointer to the relevant spi_peripheral_t instance
+ */
+void spi_launch_next(spi_peripheral_t* peri);
 
 /**
  * @brief Issues a command segment and increments counter (post inc.).
@@ -343,7 +408,14 @@ static volatile spi_peripheral_t peripherals[] = {
         .scnt      = 0,
         .txcnt     = 0,
         .rxcnt     = 0,
-        .callbacks = {0}
+        .callbacks = {0},
+        .dma_rx    = DMA_TRIG_SLOT_SPI_FLASH_RX,
+        .dma_tx    = DMA_TRIG_SLOT_SPI_FLASH_TX,
+        .dma       = false,
+        .queue     = {0},
+        .qhead     = 0,
+        .qlen      = 0,
+        .txn_cnt   = 0
     },
     (spi_peripheral_t) {
         .instance  = spi_host1,
@@ -356,7 +428,14 @@ static volatile spi_peripheral_t peripherals[] = {
         .scnt      = 0,
         .txcnt     = 0,
         .rxcnt     = 0,
-        .callbacks = {0}
+        .callbacks = {0},
+        .dma_rx    = DMA_TRIG_SLOT_SPI_RX,
+        .dma_tx    = DMA_TRIG_SLOT_SPI_TX,
+        .dma       = false,
+        .queue     = {0},
+        .qhead     = 0,
+        .qlen      = 0,
+        .txn_cnt   = 0
     },
     (spi_peripheral_t) {
         .instance  = spi_host2,
@@ -369,7 +448,14 @@ static volatile spi_peripheral_t peripherals[] = {
         .scnt      = 0,
         .txcnt     = 0,
         .rxcnt     = 0,
-        .callbacks = {0}
+        .callbacks = {0},
+        .dma_rx    = 0,
+        .dma_tx    = 0,
+        .dma       = false,
+        .queue     = {0},
+        .qhead     = 0,
+        .qlen      = 0,
+        .txn_cnt   = 0
     }
 };
 
@@ -432,6 +518,9 @@ spi_codes_e spi_reset(spi_t* spi)
 {
     spi_codes_e error = spi_check_valid(spi);
     if (error) return error;
+    // Drop the queued transactions
+    peripherals[spi->idx].qhead = 0;
+    peripherals[spi->idx].qlen  = 0;
     // Reset entire peripheral
     spi_reset_peri(&peripherals[spi->idx]);
 
@@ -547,11 +636,15 @@ spi_codes_e spi_transmit(spi_t* spi, const uint32_t* src_buffer, uint32_t len)
     // Create the transaction with the created segment
     spi_transaction_t txn = SPI_TXN_TX(&seg, src_buffer, LEN_WORDS(len));
 
+    // Count of finished transactions before ours, read before the launch since
+    // ours may be over, and a queued one launched, before the wait starts.
+    const uint32_t txn_cnt = peripherals[spi->idx].txn_cnt;
+
     // Launch the transaction. All data has been verified, launch doesn't check 
     // anything. No callbacks since function is blocking.
     spi_launch(&peripherals[spi->idx], spi, txn, NULL_CALLBACKS);
 
-    spi_wait_transaction_done(&peripherals[spi->idx]);
+    spi_wait_transaction_done(&peripherals[spi->idx], txn_cnt);
     // while (SPI_BUSY(peripherals[spi->idx])) wait_for_interrupt();
 
     return SPI_CODE_OK;
@@ -570,11 +663,15 @@ spi_codes_e spi_receive(spi_t* spi, uint32_t* dest_buffer, uint32_t len)
     // Create the transaction with the created segment
     spi_transaction_t txn = SPI_TXN_RX(&seg, dest_buffer, LEN_WORDS(len));
 
+    // Count of finished transactions before ours, read before the launch since
+    // ours may be over, and a queued one launched, before the wait starts.
+    const uint32_t txn_cnt = peripherals[spi->idx].txn_cnt;
+
     // Launch the transaction. All data has been verified, launch doesn't check 
     // anything. No callbacks since function is blocking.
     spi_launch(&peripherals[spi->idx], spi, txn, NULL_CALLBACKS);
 
-    spi_wait_transaction_done(&peripherals[spi->idx]);
+    spi_wait_transaction_done(&peripherals[spi->idx], txn_cnt);
     // while (SPI_BUSY(peripherals[spi->idx])) wait_for_interrupt();
 
     return SPI_CODE_OK;
@@ -594,11 +691,15 @@ spi_codes_e spi_transceive(spi_t* spi, const uint32_t* src_buffer,
     // Create the transaction with the created segment
     spi_transaction_t txn = SPI_TXN_BIDIR(&seg, src_buffer, dest_buffer, LEN_WORDS(len));
 
+    // Count of finished transactions before ours, read before the launch since
+    // ours may be over, and a queued one launched, before the wait starts.
+    const uint32_t txn_cnt = peripherals[spi->idx].txn_cnt;
+
     // Launch the transaction. All data has been verified, launch doesn't check 
     // anything. No callbacks since function is blocking.
     spi_launch(&peripherals[spi->idx], spi, txn, NULL_CALLBACKS);
 
-    spi_wait_transaction_done(&peripherals[spi->idx]);
+    spi_wait_transaction_done(&peripherals[spi->idx], txn_cnt);
     // while (SPI_BUSY(peripherals[spi->idx])) wait_for_interrupt();
 
     return SPI_CODE_OK;
@@ -621,11 +722,15 @@ spi_codes_e spi_execute(spi_t* spi, const spi_segment_t* segments,
     if (!spi_validate_segments(txn.segments, txn.seglen, &txn.txlen, &txn.rxlen)) 
         return SPI_CODE_SEGMENT_INVAL;
 
+    // Count of finished transactions before ours, read before the launch since
+    // ours may be over, and a queued one launched, before the wait starts.
+    const uint32_t txn_cnt = peripherals[spi->idx].txn_cnt;
+
     // Launch the transaction. All data has been verified, launch doesn't check 
     // anything. No callbacks since function is blocking.
     spi_launch(&peripherals[spi->idx], spi, txn, NULL_CALLBACKS);
 
-    spi_wait_transaction_done(&peripherals[spi->idx]);
+    spi_wait_transaction_done(&peripherals[spi->idx], txn_cnt);
     // while (SPI_BUSY(peripherals[spi->idx])) wait_for_interrupt();
 
     return SPI_CODE_OK;
@@ -719,6 +824,48 @@ spi_codes_e spi_execute_nb(spi_t* spi, const spi_segment_t* segments,
     return SPI_CODE_OK;
 }
 
+spi_codes_e spi_execute_queued(spi_t* spi, const spi_segment_t* segments, 
+                               uint32_t segments_len, const uint32_t* src_buffer, 
+                               uint32_t* dest_buffer, spi_callbacks_t callbacks) 
+{
+    spi_codes_e error = spi_check_valid(spi);
+    if (error) return error;
+
+    // Create the transaction with the provided segments
+    spi_transaction_t txn = SPI_TXN(segments, segments_len, src_buffer, dest_buffer);
+
+    // The segments are checked now, so that a queued transaction can be launched
+    // from the interrupt without any further check.
+    if (!spi_validate_segments(txn.segments, txn.seglen, &txn.txlen, &txn.rxlen)) 
+        return SPI_CODE_SEGMENT_INVAL;
+
+    spi_peripheral_t* peri = &peripherals[spi->idx];
+
+    // The queue is also modified by the interrupt of the peripheral when a
+    // transaction finishes, hence disable interrupts meanwhile.
+    uint32_t mstatus;
+    CSR_READ(CSR_REG_MSTATUS, &mstatus);
+    CSR_CLEAR_BITS(CSR_REG_MSTATUS, 0x8);
+
+    if (peri->qlen == SPI_QUEUE_LEN) error = SPI_CODE_QUEUE_FULL;
+    else
+    {
+        peri->queue[(peri->qhead + peri->qlen) % SPI_QUEUE_LEN] = (spi_queued_t) {
+            .spi       = *spi,
+            .txn       = txn,
+            .callbacks = callbacks
+        };
+        peri->qlen++;
+        // Launch it right away if the peripheral is free, otherwise it will be
+        // launched once the transactions before it are over.
+        spi_launch_next(peri);
+    }
+
+    if (mstatus & 0x8) CSR_SET_BITS(CSR_REG_MSTATUS, 0x8);
+
+    return error;
+}
+
 /****************************************************************************/
 /**                                                                        **/
 /*                            LOCAL FUNCTIONS                               */
@@ -792,12 +939,18 @@ spi_codes_e spi_prepare_transfer(spi_t* spi)
     if (spi_get_active(peripherals[spi->idx].instance) == SPI_TRISTATE_TRUE) 
         return SPI_CODE_NOT_IDLE;
 
+    return spi_select_slave(spi);
+}
+
+spi_codes_e spi_select_slave(spi_t* spi) 
+{
     // If the last spi instance was NOT the same as the current, slave may have
     // changed, therefore set the "new" slave. Otherwise don't bother.
     if (spi->id != peripherals[spi->idx].last_id)
     {
-        error = spi_set_slave(spi);
+        spi_codes_e error = spi_set_slave(spi);
         if (error) return error;
+        peripherals[spi->idx].last_id = spi->id;
     }
 
     return SPI_CODE_OK;
@@ -894,11 +1047,16 @@ void spi_launch(spi_peripheral_t* peri, spi_t* spi, spi_transaction_t txn,
     // Indicate the callbacks that should be called
     peri->callbacks = callbacks;
 
-    // Fill the TX fifo before starting so there is data once command launched
-    spi_fill_tx(peri);
+    // Large transactions have their larger direction moved by the DMA, which 
+    // starts filling the TX fifo (or waits for the RX fifo) right away. Otherwise
+    // fill the TX fifo before starting so there is data once command launched, 
+    // and refill it on the watermark events.
+    peri->dma = spi_dma_launch(peri);
+    if (!peri->dma || !SPI_DMA_MOVES_TX(peri->txn)) spi_fill_tx(peri);
 
     // Enable event interrupts since they are enabled only during a transaction
-    spi_set_events_enabled(peri->instance, TRIGGERING_EVENTS, true);
+    spi_set_events_enabled(peri->instance, 
+                           peri->dma ? DMA_TRIGGERING_EVENTS : TRIGGERING_EVENTS, true);
     spi_enable_evt_intr   (peri->instance, true);
 
     // Wait for the SPI peripheral to be ready before writing a command segment.
@@ -907,12 +1065,86 @@ void spi_launch(spi_peripheral_t* peri, spi_t* spi, spi_transaction_t txn,
     spi_issue_next_seg(peri);
 }
 
-void spi_wait_transaction_done(spi_peripheral_t* peri) 
+bool spi_dma_launch(spi_peripheral_t* peri) 
+{
+    // A single channel is used, hence only the larger direction is served. The
+    // other one (e.g. the command and address bytes of a flash read) is moved by
+    // the CPU, which has no watermark event to do it during the transaction: it
+    // has to fit in its fifo.
+    const bool     tx    = SPI_DMA_MOVES_TX(peri->txn);
+    const uint32_t words = tx ? peri->txn.txlen : peri->txn.rxlen;
+    const uint32_t other = tx ? (peri->txn.rxbuffer != NULL ? peri->txn.rxlen : 0)
+                              : (peri->txn.txbuffer != NULL ? peri->txn.txlen : 0);
+
+    // Short transactions are faster with the CPU than by setting up the DMA.
+    if (SPI_DMA_THRESHOLD == 0 || words == 0) return false;
+    if (words * BYTES_PER_WORD < SPI_DMA_THRESHOLD) return false;
+    if (words > DMA_SIZE_D1_SIZE_MASK) return false;
+    if (other > (tx ? SPI_HOST_PARAM_RX_DEPTH : SPI_HOST_PARAM_TX_DEPTH)) return false;
+    // The peripheral must be connected to the DMA trigger slots
+    if ((tx ? peri->dma_tx : peri->dma_rx) == 0) return false;
+    // The channel may be used by someone else, in which case the CPU moves the data
+    if (!dma_claim_channel(SPI_DMA_CHANNEL)) return false;
+
+    volatile dma* the_dma = SPI_DMA_PERI;
+    // Words are moved between the memory and the fifo, which address is fixed
+    the_dma->INTERRUPT_EN   = 0;
+    the_dma->MODE           = DMA_TRANS_MODE_SINGLE;
+    the_dma->DIM_CONFIG     = 0;
+    the_dma->DIM_INV        = 0;
+    the_dma->WINDOW_SIZE    = 0;
+    the_dma->SRC_DATA_TYPE  = DMA_DATA_TYPE_WORD;
+    the_dma->DST_DATA_TYPE  = DMA_DATA_TYPE_WORD;
+    the_dma->SIGN_EXT       = 0;
+    #if DMA_ZERO_PADDING
+    the_dma->PAD_TOP        = 0;
+    the_dma->PAD_BOTTOM     = 0;
+    the_dma->PAD_LEFT       = 0;
+    the_dma->PAD_RIGHT      = 0;
+    #endif
+    if (tx)
+    {
+        the_dma->SRC_PTR        = (uint32_t) peri->txn.txbuffer;
+        the_dma->DST_PTR        = (uint32_t) peri->instance + SPI_HOST_TXDATA_REG_OFFSET;
+        the_dma->SRC_PTR_INC_D1 = BYTES_PER_WORD;
+        the_dma->DST_PTR_INC_D1 = 0;
+        the_dma->SLOT           = (uint32_t) peri->dma_tx << DMA_SLOT_TX_TRIGGER_SLOT_OFFSET;
+    }
+    else
+    {
+        the_dma->SRC_PTR        = (uint32_t) peri->instance + SPI_HOST_RXDATA_REG_OFFSET;
+        the_dma->DST_PTR        = (uint32_t) peri->txn.rxbuffer;
+        the_dma->SRC_PTR_INC_D1 = 0;
+        the_dma->DST_PTR_INC_D1 = BYTES_PER_WORD;
+        the_dma->SLOT           = (uint32_t) peri->dma_rx << DMA_SLOT_RX_TRIGGER_SLOT_OFFSET;
+    }
+    // Writing the size starts the transaction
+    the_dma->SIZE_D1 = words & DMA_SIZE_D1_SIZE_MASK;
+
+    return true;
+}
+
+void spi_dma_abort(spi_peripheral_t* peri) 
+{
+    if (!peri->dma) return;
+    // The DMA has no abort. Releasing the triggers lets it run to the end of its
+    // transaction without waiting for the fifo, moving junk to the TX fifo or to 
+    // the RX buffer of the aborted transaction. The fifo errors this raises are
+    // cleared by the reset that follows.
+    SPI_DMA_PERI->SLOT = 0;
+    while (!SPI_DMA_READY());
+    dma_release_channel(SPI_DMA_CHANNEL);
+    peri->dma = false;
+}
+
+void spi_wait_transaction_done(spi_peripheral_t* peri, uint32_t txn_cnt) 
 {
     // Convert ms timeout to clock ticks
     uint64_t timeout_ticks = ((uint64_t) peri->timeout) * (SYS_FREQ / 1000);
     uint32_t start[2];
     uint32_t end[2];
+    // Queued transactions may be launched as soon as ours is over, so count 
+    // the finished transactions rather than only checking the state.
 
     // Enable tick counter
     CSR_CLEAR_BITS(CSR_REG_MCOUNTINHIBIT, 0x1);
@@ -936,7 +1168,38 @@ void spi_wait_transaction_done(spi_peripheral_t* peri)
             break;
         }
         
-    } while (SPI_BUSY((*peri)));
+    } while (SPI_BUSY((*peri)) && peri->txn_cnt == txn_cnt);
+
+    // Launch the transactions queued meanwhile, if any is still waiting
+    if (peri->state == SPI_STATE_TIMEOUT)
+    {
+        uint32_t mstatus;
+        CSR_READ(CSR_REG_MSTATUS, &mstatus);
+        CSR_CLEAR_BITS(CSR_REG_MSTATUS, 0x8);
+        spi_launch_next(peri);
+        if (mstatus & 0x8) CSR_SET_BITS(CSR_REG_MSTATUS, 0x8);
+    }
+}
+
+void spi_launch_next(spi_peripheral_t* peri) 
+{
+    while (peri->qlen != 0 && SPI_NOT_BUSY((*peri)))
+    {
+        spi_queued_t* next = &peri->queue[peri->qhead];
+        peri->qhead = (peri->qhead + 1) % SPI_QUEUE_LEN;
+        peri->qlen--;
+        // The transaction was validated when queued, only the slave (chip select
+        // and configuration options) may have to be changed.
+        if (spi_select_slave(&next->spi) != SPI_CODE_OK)
+        {
+            if (next->callbacks.error_cb != NULL) 
+            {
+                next->callbacks.error_cb(next->txn.txbuffer, 0, next->txn.rxbuffer, 0);
+            }
+            continue;
+        }
+        spi_launch(peri, &next->spi, next->txn, next->callbacks);
+    }
 }
 
 void spi_issue_next_seg(spi_peripheral_t* peri) 
@@ -956,6 +1219,8 @@ void spi_issue_next_seg(spi_peripheral_t* peri)
 
 void spi_reset_peri(spi_peripheral_t* peri) 
 {
+    // Free the DMA channel of an aborted transaction
+    spi_dma_abort(peri);
     // Reset static peripheral variables
     spi_reset_transaction(peri);
     // Reset the SPI peripheral (at hardware level)
@@ -986,6 +1251,7 @@ void spi_reset_transaction(spi_peripheral_t* peri)
     peri->rxcnt     = 0;
     peri->txn       = (spi_transaction_t) {0};
     peri->callbacks = NULL_CALLBACKS;
+    peri->dma       = false;
 }
 
 void spi_event_handler(spi_peripheral_t* peri, spi_event_e events) 
@@ -1007,18 +1273,35 @@ void spi_event_handler(spi_peripheral_t* peri, spi_event_e events)
             // Disable all event interrupts
             spi_set_events_enabled(peri->instance, SPI_EVENT_ALL, false);
             spi_enable_evt_intr   (peri->instance, false);
-            // Read the last data from the RX fifo
+            if (peri->dma)
+            {
+                // The DMA may still be reading the last words of the RX fifo.
+                // There are at most a fifo worth of them, so just wait.
+                while (!SPI_DMA_READY());
+                dma_release_channel(SPI_DMA_CHANNEL);
+                peri->dma = false;
+                if (SPI_DMA_MOVES_TX(peri->txn)) peri->txcnt = peri->txn.txlen;
+                else                             peri->rxcnt = peri->txn.rxlen;
+            }
+            // Read the last data from the RX fifo, unless the DMA did
             spi_empty_rx(peri);
             // Set the state to Transaction is done (meaning successful)
             peri->state = SPI_STATE_DONE;
+            peri->txn_cnt++;
+            // Keep what the callback needs and reset all transaction related variables
+            const spi_transaction_t txn       = peri->txn;
+            const spi_callbacks_t   callbacks = peri->callbacks;
+            const uint32_t          txcnt     = peri->txcnt;
+            const uint32_t          rxcnt     = peri->rxcnt;
+            spi_reset_transaction(peri);
+            // Launch the next queued transaction before calling the callback, so 
+            // that the bus doesn't wait for it
+            spi_launch_next(peri);
             // If there is a callback defined call it
-            if (peri->callbacks.done_cb != NULL) 
+            if (callbacks.done_cb != NULL) 
             {
-                peri->callbacks.done_cb(peri->txn.txbuffer, peri->txcnt, 
-                                        peri->txn.rxbuffer, peri->rxcnt);
+                callbacks.done_cb(txn.txbuffer, txcnt, txn.rxbuffer, rxcnt);
             }
-            // Reset all transaction related variables
-            spi_reset_transaction(peri);
             return;
         }
     }
@@ -1049,6 +1332,8 @@ void spi_error_handler(spi_peripheral_t* peri, spi_error_e error)
     // Disable event interrupts
     spi_set_events_enabled(peri->instance, SPI_EVENT_ALL, false);
     spi_enable_evt_intr   (peri->instance, false);
+    // Stop the DMA before handing the buffers back to the user
+    spi_dma_abort(peri);
     // If there is a callback defined invoke it
     if (peri->callbacks.error_cb != NULL) 
     {
@@ -1058,6 +1343,9 @@ void spi_error_handler(spi_peripheral_t* peri, spi_error_e error)
     spi_reset_peri(peri);
     // Set the state to error
     peri->state = SPI_STATE_ERROR;
+    peri->txn_cnt++;
+    // The queued transactions do not depend on the failed one
+    spi_launch_next(peri);
 }
 
 /****************************************************************************/
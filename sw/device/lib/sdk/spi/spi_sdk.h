@@ -49,6 +49,25 @@
 // Default timeout for blocking transactions in milliseconds
 #define SPI_TIMEOUT_DEFAULT   100
 
+// Transactions moving at least this many bytes in one direction have the data of
+// that direction moved by the DMA instead of the CPU (0 disables the DMA). Only the
+// SPI peripherals connected to the DMA trigger slots (FLASH and HOST) can use it.
+// Disabled by default with a single DMA channel, which the applications use.
+#ifndef SPI_DMA_THRESHOLD
+#define SPI_DMA_THRESHOLD     (DMA_CH_NUM > 1 ? 64 : 0)
+#endif
+// DMA channel reserved for the SDK. The last one by default, so that channel 0
+// stays free for the applications. It is claimed through the DMA driver for each
+// transaction: if it is running or holds a transaction loaded by the application,
+// the CPU moves the data.
+#ifndef SPI_DMA_CHANNEL
+#define SPI_DMA_CHANNEL       (DMA_CH_NUM - 1)
+#endif
+// Maximum number of transactions waiting in the queue of each SPI peripheral
+#ifndef SPI_QUEUE_LEN
+#define SPI_QUEUE_LEN         8
+#endif
+
 /**
  * @brief Macro to create a Slave SPI device with standard parameters.
  */
@@ -158,7 +177,8 @@ typedef enum {
     SPI_CODE_SEGMENT_INVAL      = 0x0100, // The spi_mode_e of the segment was invalid
     SPI_CODE_IS_BUSY            = 0x0200, // The SPI device is busy
     SPI_CODE_TXN_LEN_INVAL      = 0x0400, // The transaction length is 0 or too long
-    SPI_CODE_TIMEOUT_INVAL      = 0x0800  // The specified timeout is invalid
+    SPI_CODE_TIMEOUT_INVAL      = 0x0800, // The specified timeout is invalid
+    SPI_CODE_QUEUE_FULL         = 0x1000  // The transaction queue of the SPI device is full
 } spi_codes_e;
 
 typedef enum {
@@ -239,6 +259,8 @@ typedef void (*spi_cb_t)(const uint32_t*, uint32_t, uint32_t*, uint32_t);
 /**
  * @brief Structure holding all the callbacks for a transaction.
  *        Each callback may be NULL if you don't want it to be called.
+ *        The watermark callbacks are not called when the data is moved by the
+ *        DMA (see SPI_DMA_THRESHOLD).
  */
 typedef struct {
     spi_cb_t done_cb;   // Called once transaction is done
@@ -292,7 +314,7 @@ void spi_deinit(spi_t* spi);
 
 /**
  * @brief Completely reset the SPI device (clears all status, stops all transactions,
- *        empties FIFOs)
+ *        drops the queued transactions, empties FIFOs)
  * 
  * @param spi Pointer to spi_t structure obtained through spi_init call
  * @return SPI_CODE_IDX_INVAL if spi.idx not valid
@@ -556,6 +578,33 @@ spi_codes_e spi_execute_nb(spi_t* spi, const spi_segment_t* segments,
                            uint32_t segments_len, const uint32_t* src_buffer, 
                            uint32_t* dest_buffer, spi_callbacks_t callbacks);
 
+/**
+ * @brief Queues a transacton composed of multiple command segments. This is 
+ *        Non-Blocking, the function will return immediately.
+ *        If the SPI device is free the transaction is launched right away, 
+ *        otherwise it is launched from the interrupt of the previous transaction 
+ *        as soon as it is over. Transactions of different spi_t (i.e. slaves and
+ *        chip selects) can be queued on the same SPI device, and each one calls 
+ *        its own callbacks.
+ *        /!\ Caution: the segments and buffers must stay valid until the 
+ *                     transaction is over.
+ * 
+ * @param spi Pointer to spi_t structure obtained through spi_init call
+ * @param segments An array of command segments
+ * @param segments_len The size of segments array
+ * @param src_buffer An initialized buffer/array with all the data to send
+ * @param dest_buffer An initialized buffer/array to store the received data
+ * @param callbacks The callbacks of this transaction
+ * @return SPI_CODE_IDX_INVAL     if spi.idx not valid
+ * @return SPI_CODE_NOT_INIT      if spi.init false (indicates if spi was initialized)
+ * @return SPI_CODE_SEGMENT_INVAL if segments contains an invalid segment
+ * @return SPI_CODE_QUEUE_FULL    if SPI_QUEUE_LEN transactions are already waiting
+ * @return SPI_CODE_OK            if success
+ */
+spi_codes_e spi_execute_queued(spi_t* spi, const spi_segment_t* segments, 
+                               uint32_t segments_len, const uint32_t* src_buffer, 
+                               uint32_t* dest_buffer, spi_callbacks_t callbacks);
+
 /****************************************************************************/
 /**                                                                        **/
 /**                          INLINE FUNCTIONS                              **/
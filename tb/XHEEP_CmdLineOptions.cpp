@@ -24,6 +24,32 @@ std::string XHEEP_CmdLineOptions::getCmdOption(int argc, char* argv[], const std
      return cmd;
 }
 
+bool XHEEP_CmdLineOptions::hasCmdFlag(int argc, char* argv[], const std::string& flag)
+{
+     for( int i = 0; i < argc; ++i)
+     {
+          if(flag.compare(argv[i]) == 0) return true;
+     }
+     return false;
+}
+
+unsigned long long XHEEP_CmdLineOptions::parse_sim_time(const std::string& arg, const std::string& option)
+{
+  size_t u;
+  unsigned long long sim_time = stoull(arg, &u);
+  if(u == arg.length())  sim_time *= CLK_PERIOD_ps; // no suffix: clock cycles
+  else if(arg[u] == 'p') sim_time *= 1;             // "p" or "ps" suffix: picoseconds
+  else if(arg[u] == 'n') sim_time *= 1000;          // "n" or "ns" suffix: nanoseconds
+  else if(arg[u] == 'u') sim_time *= 1000000;       // "u" or "us" suffix: microseconds
+  else if(arg[u] == 'm') sim_time *= 1000000000;    // "m" or "ms" suffix: milliseconds
+  else if(arg[u] == 's') sim_time *= 1000000000000; // "s" suffix: seconds
+  else {
+    std::cout<<"[TESTBENCH]: ERROR: Unsupported suffix '"<<arg.substr(u)<<"' for "<<option<<std::endl;
+    exit(EXIT_FAILURE);
+  }
+  return sim_time;
+}
+
 bool XHEEP_CmdLineOptions::get_use_openocd()
 {
 
@@ -68,18 +94,7 @@ unsigned long long XHEEP_CmdLineOptions::get_max_sim_time(bool& run_all)
     std::cout<<"[TESTBENCH]: No Max time specified"<<std::endl;
     run_all = true;
   } else {
-    size_t u;
-    max_sim_time = stoull(arg_max_sim_time, &u);
-    if(u == arg_max_sim_time.length())  max_sim_time *= CLK_PERIOD_ps; // no suffix: clock cycles
-    else if(arg_max_sim_time[u] == 'p') max_sim_time *= 1;             // "p" or "ps" suffix: picoseconds
-    else if(arg_max_sim_time[u] == 'n') max_sim_time *= 1000;          // "n" or "ns" suffix: nanoseconds
-    else if(arg_max_sim_time[u] == 'u') max_sim_time *= 1000000;       // "u" or "us" suffix: microseconds
-    else if(arg_max_sim_time[u] == 'm') max_sim_time *= 1000000000;    // "m" or "ms" suffix: milliseconds
-    else if(arg_max_sim_time[u] == 's') max_sim_time *= 1000000000000; // "s" suffix: seconds
-    else {
-      std::cout<<"[TESTBENCH]: ERROR: Unsupported suffix '"<<arg_max_sim_time.substr(u)<<"' for +max_sim_time"<<std::endl;
-      exit(EXIT_FAILURE);
-    }
+    max_sim_time = this->parse_sim_time(arg_max_sim_time, "+max_sim_time");
     std::cout<<"[TESTBENCH]: Max sim time is "<<(max_sim_time/CLK_PERIOD_ps)<<" clock cycles"<<std::endl;
   }
 
@@ -109,3 +124,145 @@ unsigned int XHEEP_CmdLineOptions::get_boot_sel()
 
   return boot_sel;
 }
+
+bool XHEEP_CmdLineOptions::get_trace()
+{
+  // +trace_start and +trace_stop imply +trace
+  bool trace = this->hasCmdFlag(this->argc, this->argv, "+trace") ||
+               !this->getCmdOption(this->argc, this->argv, "+trace_start=").empty() ||
+               !this->getCmdOption(this->argc, this->argv, "+trace_stop=").empty();
+
+  if(trace) {
+    std::cout<<"[TESTBENCH]: Waveform tracing enabled"<<std::endl;
+  } else {
+    std::cout<<"[TESTBENCH]: Waveform tracing disabled (use +trace to enable it)"<<std::endl;
+  }
+
+  return trace;
+}
+
+unsigned long long XHEEP_CmdLineOptions::get_trace_start()
+{
+  std::string arg_trace_start = this->getCmdOption(this->argc, this->argv, "+trace_start=");
+  unsigned long long trace_start = 0;
+
+  if(!arg_trace_start.empty()) {
+    trace_start = this->parse_sim_time(arg_trace_start, "+trace_start");
+    std::cout<<"[TESTBENCH]: Tracing starts at clock cycle "<<(trace_start/CLK_PERIOD_ps)<<std::endl;
+  }
+
+  return trace_start;
+}
+
+unsigned long long XHEEP_CmdLineOptions::get_trace_stop()
+{
+  std::string arg_trace_stop = this->getCmdOption(this->argc, this->argv, "+trace_stop=");
+  unsigned long long trace_stop = 0; // 0: trace until the end of the simulation
+
+  if(!arg_trace_stop.empty()) {
+    trace_stop = this->parse_sim_time(arg_trace_stop, "+trace_stop");
+    std::cout<<"[TESTBENCH]: Tracing stops at clock cycle "<<(trace_stop/CLK_PERIOD_ps)<<std::endl;
+  }
+
+  return trace_stop;
+}
+
+unsigned int XHEEP_CmdLineOptions::get_trace_depth()
+{
+  std::string arg_trace_depth = this->getCmdOption(this->argc, this->argv, "+trace_depth=");
+  unsigned int trace_depth = 99;
+
+  if(!arg_trace_depth.empty()) {
+    trace_depth = stoul(arg_trace_depth);
+    std::cout<<"[TESTBENCH]: Tracing "<<trace_depth<<" levels of hierarchy"<<std::endl;
+  }
+
+  return trace_depth;
+}
+
+unsigned long long XHEEP_CmdLineOptions::get_save_checkpoint(std::string& file)
+{
+  std::string arg_save_checkpoint = this->getCmdOption(this->argc, this->argv, "+save_checkpoint=");
+  unsigned long long save_time = 0;
+
+  file.clear();
+  if(!arg_save_checkpoint.empty()) {
+    size_t at = arg_save_checkpoint.rfind('@');
+    if(at == std::string::npos || at == 0 || at == arg_save_checkpoint.length()-1) {
+      std::cout<<"[TESTBENCH]: ERROR: +save_checkpoint expects <file>@<cycle>"<<std::endl;
+      exit(EXIT_FAILURE);
+    }
+    file      = arg_save_checkpoint.substr(0, at);
+    save_time = this->parse_sim_time(arg_save_checkpoint.substr(at+1), "+save_checkpoint");
+    std::cout<<"[TESTBENCH]: Saving checkpoint "<<file<<" at clock cycle "<<(save_time/CLK_PERIOD_ps)<<std::endl;
+  }
+
+  return save_time;
+}
+
+std::string XHEEP_CmdLineOptions::get_restore_checkpoint()
+{
+  std::string checkpoint = this->getCmdOption(this->argc, this->argv, "+restore_checkpoint=");
+
+  if(!checkpoint.empty()) {
+    std::cout<<"[TESTBENCH]: Restoring checkpoint "<<checkpoint<<std::endl;
+  }
+
+  return checkpoint;
+}
+
+bool XHEEP_CmdLineOptions::get_bench()
+{
+  bool bench = this->hasCmdFlag(this->argc, this->argv, "+bench");
+
+  if(bench) {
+    std::cout<<"[TESTBENCH]: Benchmark mode, simulation speed is reported at exit"<<std::endl;
+  }
+
+  return bench;
+}
+
+std::string XHEEP_CmdLineOptions::get_batch()
+{
+  std::string batch = this->getCmdOption(this->argc, this->argv, "+batch=");
+
+  if(!batch.empty()) {
+    std::cout<<"[TESTBENCH]: Running the firmware batch "<<batch<<std::endl;
+  }
+
+  return batch;
+}
+
+std::string XHEEP_CmdLineOptions::get_profile(std::string& out)
+{
+  std::string elf = this->getCmdOption(this->argc, this->argv, "+profile=");
+
+  out = this->getCmdOption(this->argc, this->argv, "+profile_out=");
+  if(out.empty()) out = "profile.folded";
+
+  if(!elf.empty()) {
+    std::cout<<"[TESTBENCH]: Profiling "<<elf<<", folded stacks written to "<<out<<std::endl;
+  }
+
+  return elf;
+}
+
+std::string XHEEP_CmdLineOptions::get_stats()
+{
+  std::string stats = this->getCmdOption(this->argc, this->argv, "+stats=");
+
+  if(stats.empty()) stats = "stats.json";
+
+  return stats;
+}
+
+bool XHEEP_CmdLineOptions::get_idle_skip()
+{
+  bool idle_skip = this->hasCmdFlag(this->argc, this->argv, "+idle_skip");
+
+  if(idle_skip) {
+    std::cout<<"[TESTBENCH]: Skipping the clock cycles the CPU sleeps waiting for a timer interrupt"<<std::endl;
+  }
+
+  return idle_skip;
+}
@@ -13,10 +13,23 @@ class XHEEP_CmdLineOptions // declare Calculator class
     XHEEP_CmdLineOptions(int argc, char* argv[]); // default constructor
 
     std::string getCmdOption(int argc, char* argv[], const std::string& option); // get options from cmd lines
+    bool hasCmdFlag(int argc, char* argv[], const std::string& flag); // check for a flag without value
     bool get_use_openocd();
     std::string get_firmware();
     unsigned long long get_max_sim_time(bool& run_all);
     unsigned int get_boot_sel();
+    bool get_trace();
+    unsigned long long get_trace_start();
+    unsigned long long get_trace_stop();
+    unsigned int get_trace_depth();
+    unsigned long long get_save_checkpoint(std::string& file);
+    std::string get_restore_checkpoint();
+    bool get_bench();
+    std::string get_batch();
+    std::string get_profile(std::string& out); // returns the ELF with the symbols
+    std::string get_stats(); // JSON file of the performance counters
+    bool get_idle_skip();
+    unsigned long long parse_sim_time(const std::string& arg, const std::string& option); // returns ps
     int argc;
     char** argv;
 
@@ -0,0 +1,102 @@
+#include "XHEEP_FirmwareLoader.hh"
+#include <elf.h>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+XHEEP_FirmwareLoader::XHEEP_FirmwareLoader()
+{
+  this->size_bytes = 0;
+}
+
+bool XHEEP_FirmwareLoader::is_elf(const std::string& file)
+{
+  std::ifstream f(file, std::ios::binary);
+  char magic[SELFMAG];
+
+  if(!f.read(magic, SELFMAG)) return false;
+  return std::string(magic, SELFMAG) == std::string(ELFMAG, SELFMAG);
+}
+
+bool XHEEP_FirmwareLoader::load(const std::string& file)
+{
+  this->words.clear();
+  this->size_bytes = 0;
+
+  if(is_elf(file)) return this->load_elf(file);
+  return this->load_verilog_hex(file);
+}
+
+const std::map<uint32_t, uint32_t>& XHEEP_FirmwareLoader::get_words()
+{
+  return this->words;
+}
+
+unsigned long long XHEEP_FirmwareLoader::get_size_bytes()
+{
+  return this->size_bytes;
+}
+
+void XHEEP_FirmwareLoader::add_byte(uint32_t addr, uint8_t data)
+{
+  // missing bytes of a partially populated word are written as 0
+  this->words[addr & ~0x3U] |= (uint32_t)data << (8 * (addr & 0x3U));
+  this->size_bytes++;
+}
+
+bool XHEEP_FirmwareLoader::load_elf(const std::string& file)
+{
+  std::ifstream f(file, std::ios::binary);
+  Elf32_Ehdr ehdr;
+
+  if(!f.read(reinterpret_cast<char*>(&ehdr), sizeof(ehdr)) ||
+     ehdr.e_ident[EI_CLASS] != ELFCLASS32 || ehdr.e_ident[EI_DATA] != ELFDATA2LSB) {
+    std::cout<<"[TESTBENCH]: ERROR: "<<file<<" is not a 32-bit little-endian ELF"<<std::endl;
+    return false;
+  }
+
+  // Only the file-backed part of the loadable segments is written, .bss is left to the crt0
+  for(int i = 0; i < ehdr.e_phnum; i++) {
+    Elf32_Phdr phdr;
+    f.seekg(ehdr.e_phoff + i * ehdr.e_phentsize);
+    if(!f.read(reinterpret_cast<char*>(&phdr), sizeof(phdr))) return false;
+    if(phdr.p_type != PT_LOAD || phdr.p_filesz == 0) continue;
+
+    std::vector<char> segment(phdr.p_filesz);
+    f.seekg(phdr.p_offset);
+    if(!f.read(segment.data(), phdr.p_filesz)) return false;
+    for(uint32_t j = 0; j < phdr.p_filesz; j++) {
+      this->add_byte(phdr.p_paddr + j, (uint8_t)segment[j]);
+    }
+  }
+
+  return true;
+}
+
+bool XHEEP_FirmwareLoader::load_verilog_hex(const std::string& file)
+{
+  std::ifstream f(file);
+  std::string token;
+  uint32_t addr = 0;
+
+  if(!f.is_open()) {
+    std::cout<<"[TESTBENCH]: ERROR: Cannot open firmware "<<file<<std::endl;
+    return false;
+  }
+
+  // "@<address>" sets the byte address of the following "<byte>" tokens
+  while(f >> token) {
+    try {
+      if(token[0] == '@') {
+        addr = std::stoul(token.substr(1), nullptr, 16);
+      } else {
+        this->add_byte(addr++, (uint8_t)std::stoul(token, nullptr, 16));
+      }
+    } catch(const std::exception&) {
+      std::cout<<"[TESTBENCH]: ERROR: Unexpected '"<<token<<"' in firmware "<<file<<std::endl;
+      return false;
+    }
+  }
+
+  return true;
+}
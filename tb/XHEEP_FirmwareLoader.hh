@@ -0,0 +1,32 @@
+#ifndef XHEEP_FIRMWARE_LOADER_H
+#define XHEEP_FIRMWARE_LOADER_H
+
+#include <cstdint>
+#include <map>
+#include <string>
+
+// Parses a firmware image (ELF or Verilog hex as generated by objcopy -O verilog)
+// into the 32-bit words it populates, so that the testbench only writes those
+// words to the memory banks instead of the whole memory.
+class XHEEP_FirmwareLoader
+{
+
+  public:
+    XHEEP_FirmwareLoader();
+
+    bool load(const std::string& file); // returns false if the file cannot be parsed
+    const std::map<uint32_t, uint32_t>& get_words(); // word-aligned byte address -> data
+    unsigned long long get_size_bytes();
+    static bool is_elf(const std::string& file);
+
+  private:
+    bool load_elf(const std::string& file);
+    bool load_verilog_hex(const std::string& file);
+    void add_byte(uint32_t addr, uint8_t data);
+
+    std::map<uint32_t, uint32_t> words;
+    unsigned long long size_bytes;
+
+};
+
+#endif
@@ -0,0 +1,178 @@
+#include "XHEEP_Profiler.hh"
+#include "svdpi.h"
+#include <algorithm>
+#include <elf.h>
+#include <fstream>
+#include <iostream>
+
+#define PROFILER_MAX_STACK_DEPTH 256
+
+XHEEP_Profiler* xheep_profiler = nullptr;
+
+XHEEP_Profiler::XHEEP_Profiler()
+{
+  this->names.push_back("[unknown]");
+  this->stack_counter = nullptr;
+  this->cycles = 0;
+  this->last_valid = false;
+  this->last_pc = 0;
+  this->last_instr = 0;
+}
+
+bool XHEEP_Profiler::load_symbols(const std::string& elf)
+{
+  std::ifstream f(elf, std::ios::binary);
+  Elf32_Ehdr ehdr;
+
+  if(!f.read(reinterpret_cast<char*>(&ehdr), sizeof(ehdr)) ||
+     std::string((char*)ehdr.e_ident, SELFMAG) != std::string(ELFMAG, SELFMAG) ||
+     ehdr.e_ident[EI_CLASS] != ELFCLASS32) {
+    std::cout<<"[TESTBENCH]: ERROR: "<<elf<<" is not a 32-bit ELF"<<std::endl;
+    return false;
+  }
+
+  std::vector<Elf32_Shdr> shdrs(ehdr.e_shnum);
+  f.seekg(ehdr.e_shoff);
+  f.read(reinterpret_cast<char*>(shdrs.data()), ehdr.e_shnum * sizeof(Elf32_Shdr));
+
+  for(const Elf32_Shdr& symtab : shdrs) {
+    if(symtab.sh_type != SHT_SYMTAB || symtab.sh_link >= shdrs.size()) continue;
+
+    const Elf32_Shdr& strtab_hdr = shdrs[symtab.sh_link];
+    std::vector<char> strtab(strtab_hdr.sh_size + 1, '\0');
+    f.seekg(strtab_hdr.sh_offset);
+    f.read(strtab.data(), strtab_hdr.sh_size);
+
+    std::vector<Elf32_Sym> syms(symtab.sh_size / sizeof(Elf32_Sym));
+    f.seekg(symtab.sh_offset);
+    f.read(reinterpret_cast<char*>(syms.data()), syms.size() * sizeof(Elf32_Sym));
+
+    for(const Elf32_Sym& sym : syms) {
+      if(ELF32_ST_TYPE(sym.st_info) != STT_FUNC || sym.st_name >= strtab_hdr.sh_size) continue;
+      this->symbols.push_back({sym.st_value, sym.st_size, std::string(&strtab[sym.st_name])});
+    }
+  }
+
+  if(!f || this->symbols.empty()) {
+    std::cout<<"[TESTBENCH]: ERROR: no function symbols found in "<<elf<<std::endl;
+    return false;
+  }
+
+  std::sort(this->symbols.begin(), this->symbols.end(),
+            [](const Symbol& a, const Symbol& b) { return a.addr < b.addr; });
+  for(const Symbol& sym : this->symbols) this->names.push_back(sym.name);
+
+  std::cout<<"[TESTBENCH]: Profiling "<<this->symbols.size()<<" functions of "<<elf<<std::endl;
+  return true;
+}
+
+unsigned int XHEEP_Profiler::lookup(uint32_t pc)
+{
+  auto it = std::upper_bound(this->symbols.begin(), this->symbols.end(), pc,
+                             [](uint32_t addr, const Symbol& sym) { return addr < sym.addr; });
+  if(it == this->symbols.begin()) return 0;
+  --it;
+  // symbols without size (e.g. assembly labels) extend to the next symbol
+  if(it->size != 0 && pc >= it->addr + it->size) return 0;
+  return (it - this->symbols.begin()) + 1;
+}
+
+bool XHEEP_Profiler::is_call(uint32_t instr)
+{
+  if((instr & 0x3) != 0x3) {
+    // c.jal (RV32 only) and c.jalr, which link to ra
+    return (instr & 0xE003) == 0x2001 ||
+           ((instr & 0xF07F) == 0x9002 && ((instr >> 7) & 0x1F) != 0);
+  }
+  uint32_t opcode = instr & 0x7F;
+  uint32_t rd = (instr >> 7) & 0x1F;
+  // jal/jalr linking to ra or t0 (alternate link register)
+  return (opcode == 0x6F || opcode == 0x67) && (rd == 1 || rd == 5);
+}
+
+bool XHEEP_Profiler::is_return(uint32_t instr)
+{
+  if((instr & 0x3) != 0x3) {
+    // c.jr ra
+    return (instr & 0xFFFF) == 0x8082;
+  }
+  uint32_t rd = (instr >> 7) & 0x1F;
+  uint32_t rs1 = (instr >> 15) & 0x1F;
+  return (instr & 0x7F) == 0x67 && rd == 0 && (rs1 == 1 || rs1 == 5);
+}
+
+void XHEEP_Profiler::set_stack_counter()
+{
+  this->stack_counter = &this->stack_cycles[this->stack];
+}
+
+void XHEEP_Profiler::sample(bool valid, uint32_t pc, uint32_t instr)
+{
+  this->cycles++;
+
+  // A new instruction entered the ID stage: update the stack with the control
+  // flow of the previous instruction. Stalled cycles are accounted to the
+  // function of the instruction that stalls.
+  if(valid && (!this->last_valid || pc != this->last_pc)) {
+    unsigned int func = this->lookup(pc);
+
+    if(this->stack.empty()) {
+      this->stack.push_back(func);
+      this->set_stack_counter();
+    } else if(this->last_valid && is_call(this->last_instr) && this->stack.size() < PROFILER_MAX_STACK_DEPTH) {
+      this->stack.push_back(func);
+      this->set_stack_counter();
+    } else if(this->last_valid && is_return(this->last_instr)) {
+      // unwind to the caller, or just replace the top if the caller is unknown
+      auto caller = std::find(this->stack.rbegin() + 1, this->stack.rend(), func);
+      if(this->stack.size() > 1 && caller != this->stack.rend()) {
+        this->stack.resize(this->stack.rend() - caller);
+      } else {
+        this->stack.back() = func;
+      }
+      this->set_stack_counter();
+    } else if(this->stack.back() != func) {
+      // tail call, jump or trap handler
+      this->stack.back() = func;
+      this->set_stack_counter();
+    }
+
+    this->last_pc = pc;
+    this->last_instr = instr;
+  }
+  this->last_valid = valid;
+
+  if(this->stack_counter != nullptr) (*this->stack_counter)++;
+}
+
+bool XHEEP_Profiler::write_folded(const std::string& file)
+{
+  std::ofstream f(file);
+
+  if(!f.is_open()) {
+    std::cout<<"[TESTBENCH]: ERROR: cannot write the profile to "<<file<<std::endl;
+    return false;
+  }
+
+  for(const auto& entry : this->stack_cycles) {
+    if(entry.second == 0) continue;
+    for(size_t i = 0; i < entry.first.size(); i++) {
+      f<<(i ? ";" : "")<<this->names[entry.first[i]];
+    }
+    f<<" "<<entry.second<<"\n";
+  }
+
+  std::cout<<"[TESTBENCH]: Profile of "<<this->cycles<<" clock cycles written to "<<file<<std::endl;
+  return true;
+}
+
+unsigned long long XHEEP_Profiler::get_cycles()
+{
+  return this->cycles;
+}
+
+// DPI import of tb_util.svh, called every clock cycle when +profile is given
+extern "C" void tb_profile_sample(svBit valid, int pc, int instr)
+{
+  if(xheep_profiler != nullptr) xheep_profiler->sample(valid, (uint32_t)pc, (uint32_t)instr);
+}
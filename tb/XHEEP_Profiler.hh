@@ -0,0 +1,52 @@
+#ifndef XHEEP_PROFILER_H
+#define XHEEP_PROFILER_H
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+// Cycle-accurate profiler of the firmware fed every clock cycle with the instruction
+// in the ID stage of the CPU (tb_profile_sample DPI call of tb_util.svh).
+// Calls and returns are tracked to keep a call stack of the functions of the ELF
+// symbol table, and every cycle is accounted to the current stack. The result is
+// written in the folded format ("main;foo;bar <cycles>") read by flamegraph.pl.
+class XHEEP_Profiler
+{
+
+  public:
+    XHEEP_Profiler();
+
+    bool load_symbols(const std::string& elf); // returns false if the ELF has no symbol table
+    void sample(bool valid, uint32_t pc, uint32_t instr);
+    bool write_folded(const std::string& file);
+    unsigned long long get_cycles();
+
+  private:
+    struct Symbol {
+      uint32_t addr;
+      uint32_t size;
+      std::string name;
+    };
+
+    unsigned int lookup(uint32_t pc); // index in names, 0 is [unknown]
+    static bool is_call(uint32_t instr);
+    static bool is_return(uint32_t instr);
+    void set_stack_counter();
+
+    std::vector<Symbol> symbols; // sorted by address
+    std::vector<std::string> names;
+    std::vector<unsigned int> stack;
+    std::map<std::vector<unsigned int>, unsigned long long> stack_cycles;
+    unsigned long long* stack_counter;
+    unsigned long long cycles;
+    bool last_valid;
+    uint32_t last_pc;
+    uint32_t last_instr;
+
+};
+
+// Set by tb_top.cpp when +profile is given
+extern XHEEP_Profiler* xheep_profiler;
+
+#endif
@@ -1,19 +1,51 @@
 #ifndef CACHE_H
 #define CACHE_H
 
+#include <cstring>
 #include <fstream>
 #include <iostream>
 #include <sstream>
 #include <iomanip>
+#include <random>
+#include <string>
+#include <vector>
 
 
-// Target module representing a simple direct mapped cache
+// Model of a N-way set-associative cache, configured with create_cache()
+// (a single way gives the direct mapped cache used by default).
+// Tags, state and data of all the lines are kept in flat arrays allocated once,
+// line i of set s being at index s*ways + i.
 class CacheMemory
 {
 
 public:
-  uint32_t cache_size_byte    = 4*1024;
-  uint32_t number_of_blocks   = 256;
+  enum replacement_policy_t { LRU, PLRU, RANDOM };
+
+  typedef struct cache_config {
+    uint32_t             cache_size_byte = 4*1024;
+    uint32_t             block_size_byte = 16;
+    uint32_t             ways            = 1;
+    replacement_policy_t policy          = LRU;
+    bool                 write_back      = true;  // false: write-through, lines are never dirty
+    bool                 write_allocate  = true;  // false: write misses go to the memory only
+  } cache_config_t;
+
+  typedef struct cache_statistics {
+    uint64_t read_hits;
+    uint64_t read_misses;
+    uint64_t write_hits;
+    uint64_t write_misses;
+    uint64_t evictions;
+    uint64_t write_backs;
+  } cache_statistics_t;
+
+  cache_config_t     config;
+  cache_statistics_t stats;
+
+  uint32_t cache_size_byte    = 0;
+  uint32_t number_of_blocks   = 0;
+  uint32_t number_of_sets     = 0;
+  uint32_t ways               = 0;
 
   uint32_t nbits_blocks       = 0;
   uint32_t nbits_tags         = 0;
@@ -26,55 +58,76 @@ public:
 
   typedef struct cache_line {
     uint32_t tag;
-    bool    valid;
-    uint8_t* data;
+    bool     valid;
+    bool     dirty;
+    uint64_t last_access;  // LRU
   } cache_line_t;
 
-  cache_line_t* cache_array;
+  std::vector<cache_line_t> cache_array;
+  std::vector<uint8_t>      cache_data;
+  std::vector<uint64_t>     plru_bits;   // tree of ways-1 bits per set, PLRU
+  uint64_t                  access_count = 0;
+  std::mt19937              random_gen;
 
 
-  CacheMemory(): cacheFile("cache_status.log")
+  CacheMemory()
   {
-    cache_array = NULL;
   }
 
-  void create_cache() {
-      cache_array = new cache_line_t[number_of_blocks];
-      this->block_size_byte = get_block_size();
-      this->nbits_blocks    = log2(block_size_byte);
-      this->nbits_index     = log2(number_of_blocks);
-      this->nbits_tags      = ARCHITECTURE_bits - nbits_index - nbits_blocks;
-      printf("bits block %d, index %d, tags %d\n",nbits_blocks, nbits_index, nbits_tags );
+  static bool is_power_of_two(uint32_t x) {
+    return x != 0 && (x & (x - 1)) == 0;
   }
 
-  void create_cache(uint32_t cache_size_byte, uint32_t number_of_blocks) {
-      this->cache_size_byte = cache_size_byte;
-      this->number_of_blocks = number_of_blocks;
-      cache_array = new cache_line_t[number_of_blocks];
-      this->block_size_byte = get_block_size();
-      this->nbits_blocks    = log2(block_size_byte);
-      this->nbits_index     = log2(number_of_blocks);
-      this->nbits_tags      = ARCHITECTURE_bits - nbits_index - nbits_blocks;
+  static uint32_t log2(uint32_t x) {
+    uint32_t n = 0;
+    while (x >>= 1) n++;
+    return n;
   }
 
-  uint32_t initialize_cache() {
-      if(cache_array == NULL) {
-        return -1;
+  // Returns false if the geometry is not supported
+  bool create_cache(const cache_config_t& config) {
+      if (!is_power_of_two(config.block_size_byte) || config.block_size_byte < 4 || config.ways == 0 || config.ways > 64 ||
+          config.cache_size_byte % (config.block_size_byte * config.ways) != 0 ||
+          !is_power_of_two(config.cache_size_byte / (config.block_size_byte * config.ways)) ||
+          (config.policy == PLRU && !is_power_of_two(config.ways))) {
+        std::cout << "[CACHE]: ERROR: unsupported geometry, size " << config.cache_size_byte << " B, line "
+                  << config.block_size_byte << " B, " << config.ways << " ways" << std::endl;
+        return false;
       }
-      // Initialize memory with random data
-      for (int i = 0; i < number_of_blocks; i++) {
-        cache_array[i].valid = false;
-        cache_array[i].tag   = 0;
-        cache_array[i].data = new uint8_t[block_size_byte];
-        for(int j = 0; j<block_size_byte;j++) {
-          cache_array[i].data[j] = (uint8_t)(i*j);
+      this->config           = config;
+      this->cache_size_byte  = config.cache_size_byte;
+      this->block_size_byte  = config.block_size_byte;
+      this->ways             = config.ways;
+      this->number_of_blocks = cache_size_byte / block_size_byte;
+      this->number_of_sets   = number_of_blocks / ways;
+      this->nbits_blocks     = log2(block_size_byte);
+      this->nbits_index      = log2(number_of_sets);
+      this->nbits_tags       = ARCHITECTURE_bits - nbits_index - nbits_blocks;
+      cache_array.assign(number_of_blocks, cache_line_t());
+      cache_data.assign(cache_size_byte, 0);
+      plru_bits.assign(number_of_sets, 0);
+      printf("bits block %d, index %d, tags %d, ways %d\n", nbits_blocks, nbits_index, nbits_tags, ways);
+      return true;
+  }
+
+  void initialize_cache() {
+      for (uint32_t i = 0; i < number_of_blocks; i++) {
+        cache_array[i].valid       = false;
+        cache_array[i].dirty       = false;
+        cache_array[i].tag         = 0;
+        cache_array[i].last_access = 0;
+        for(uint32_t j = 0; j < block_size_byte; j++) {
+          cache_data[i*block_size_byte + j] = (uint8_t)(i*j);
         }
       }
-      return 0;
+      std::fill(plru_bits.begin(), plru_bits.end(), 0);
+      memset(&stats, 0, sizeof(stats));
+      access_count = 0;
+      random_gen.seed(0);
   }
 
   uint32_t get_block_size() {
-    return (uint32_t)(cache_size_byte / number_of_blocks);
+    return block_size_byte;
   }
 
   uint32_t get_index(uint32_t address) {
@@ -92,101 +145,169 @@ public:
   }
 
   uint32_t get_tag(uint32_t address) {
-    return (uint32_t)(address >> (nbits_index+nbits_blocks));
+    return (uint32_t)((uint64_t)address >> (nbits_index+nbits_blocks));
   }
 
-  uint32_t get_tag_from_index(uint32_t index) {
-    return cache_array[index].tag;
+  // Line holding the address, -1 on a miss
+  int32_t find_line(uint32_t address) {
+    uint32_t set = get_index(address);
+    uint32_t tag = get_tag(address);
+    for (uint32_t way = 0; way < ways; way++) {
+      const cache_line_t& line = cache_array[set*ways + way];
+      if (line.valid && line.tag == tag) return set*ways + way;
+    }
+    return -1;
   }
 
-
   bool cache_hit(uint32_t address) {
-    uint32_t index = get_index(address);
-    uint32_t tag   = get_tag(address);
-    return ( cache_array[index].valid && tag == cache_array[index].tag);
+    return find_line(address) >= 0;
+  }
 
+  // Updates the replacement state on an access to the line
+  void touch(uint32_t line) {
+    uint32_t set = line / ways;
+    uint32_t way = line % ways;
+    cache_array[line].last_access = ++access_count;
+    if (config.policy == PLRU && ways > 1) {
+      // each node of the tree points to the half that was not used last
+      uint32_t levels = log2(ways);
+      uint32_t node = 1;
+      for (uint32_t l = 0; l < levels; l++) {
+        uint32_t bit = (way >> (levels - 1 - l)) & 1;
+        if (bit) plru_bits[set] &= ~(1ULL << node);
+        else     plru_bits[set] |=  (1ULL << node);
+        node = 2*node + bit;
+      }
+    }
   }
 
-  void add_entry(uint32_t address, uint8_t* new_data) {
-    uint32_t index = get_index(address);
-    uint32_t tag   = get_tag(address);
-    cache_array[index].valid = true;
-    cache_array[index].tag   = tag;
-    memcpy(cache_array[index].data, new_data, block_size_byte);
+  // Line of the set of the address to be replaced by a new entry, an invalid one if any
+  uint32_t get_victim(uint32_t address) {
+    uint32_t set = get_index(address);
+    uint32_t victim = 0;
+
+    for (uint32_t way = 0; way < ways; way++) {
+      if (!cache_array[set*ways + way].valid) return set*ways + way;
+    }
+
+    switch (config.policy) {
+      case LRU:
+        for (uint32_t way = 1; way < ways; way++) {
+          if (cache_array[set*ways + way].last_access < cache_array[set*ways + victim].last_access) victim = way;
+        }
+        break;
+      case PLRU: {
+        uint32_t levels = log2(ways);
+        uint32_t node = 1;
+        for (uint32_t l = 0; l < levels; l++) {
+          uint32_t bit = (plru_bits[set] >> node) & 1;
+          victim = (victim << 1) | bit;
+          node = 2*node + bit;
+        }
+        break;
+      }
+      case RANDOM:
+        victim = random_gen() % ways;
+        break;
+    }
+    return set*ways + victim;
   }
 
-  void get_data(uint32_t address, uint8_t* new_data) {
-    uint32_t index = get_index(address);
-    memcpy(new_data, cache_array[index].data, block_size_byte);
+  bool is_line_valid(uint32_t line) {
+    return cache_array[line].valid;
   }
 
-  void get_data_at_index(uint32_t index, uint8_t* new_data) {
-    memcpy(new_data, cache_array[index].data, block_size_byte);
+  bool is_line_dirty(uint32_t line) {
+    return cache_array[line].valid && cache_array[line].dirty;
   }
 
-  uint32_t get_address(uint32_t address){
-    uint32_t index = get_index(address);
-    uint32_t tag   = cache_array[index].tag;
-    uint32_t new_address = (tag << (nbits_index+nbits_blocks)) | (index<<nbits_blocks); //<<2 as words
-    return new_address;
+  uint8_t* get_line_data(uint32_t line) {
+    return &cache_data[line*block_size_byte];
   }
 
-  uint32_t get_address_at_index(uint32_t index){
-    uint32_t tag   = cache_array[index].tag;
-    uint32_t new_address = tag << (nbits_index+nbits_blocks) | (index<<nbits_blocks); //<<2 as words
-    return new_address;
+  uint32_t get_line_address(uint32_t line) {
+    uint32_t set = line / ways;
+    return (uint32_t)(((uint64_t)cache_array[line].tag << (nbits_index+nbits_blocks)) | (set << nbits_blocks));
   }
 
-  int32_t get_word(uint32_t address) {
-    int32_t data_word = 0;
-    uint32_t block_offset = this->get_block_offset(address);
-    uint8_t* new_data = new uint8_t[block_size_byte];
-    this->get_data(address, new_data);
-    data_word = *((int32_t *)&new_data[block_offset]);
-    delete[] new_data;
-    return data_word;
+  // Replaces the line with the block of the address, counting the eviction of a valid entry
+  void fill_line(uint32_t line, uint32_t address, const uint8_t* new_data) {
+    if (cache_array[line].valid) stats.evictions++;
+    cache_array[line].valid = true;
+    cache_array[line].dirty = false;
+    cache_array[line].tag   = get_tag(address);
+    memcpy(get_line_data(line), new_data, block_size_byte);
+    touch(line);
   }
 
-  void set_word(uint32_t address, int32_t data_word) {
-    uint32_t block_offset = this->get_block_offset(address);
-    uint8_t* new_data = new uint8_t[block_size_byte];
-    this->get_data(address, new_data);
-    *((int32_t *)&new_data[block_offset]) = data_word;
-    for(int i=0;i<block_size_byte;i++)
-    this->add_entry(address, new_data);
-    delete[] new_data;
+  // Word accesses to a line holding the address
+  int32_t get_word(uint32_t line, uint32_t address) {
+    int32_t data_word;
+    memcpy(&data_word, get_line_data(line) + (get_block_offset(address) & ~0x3), 4);
+    touch(line);
+    return data_word;
   }
 
-  bool is_entry_valid(uint32_t address) {
-    uint32_t index = get_index(address);
-    return cache_array[index].valid;
+  // Only the bytes of byte_enable (bit i for byte i of the word) are written
+  void set_word(uint32_t line, uint32_t address, int32_t data_word, uint32_t byte_enable = 0xF) {
+    uint8_t* word = get_line_data(line) + (get_block_offset(address) & ~0x3);
+    if (byte_enable == 0xF) {
+      memcpy(word, &data_word, 4);
+    } else {
+      const uint8_t* data_bytes = reinterpret_cast<const uint8_t*>(&data_word);
+      for (uint32_t i = 0; i < 4; i++) {
+        if (byte_enable & (1 << i)) word[i] = data_bytes[i];
+      }
+    }
+    cache_array[line].dirty = config.write_back;
+    touch(line);
   }
 
-  bool is_entry_valid_at_index(uint32_t index) {
-    return cache_array[index].valid;
+  void print_statistics(std::ostream& os) {
+    uint64_t hits   = stats.read_hits + stats.write_hits;
+    uint64_t misses = stats.read_misses + stats.write_misses;
+    os << "{\n"
+       << "  \"cache_size_byte\": " << cache_size_byte << ",\n"
+       << "  \"block_size_byte\": " << block_size_byte << ",\n"
+       << "  \"ways\": " << ways << ",\n"
+       << "  \"policy\": \"" << (config.policy == LRU ? "lru" : config.policy == PLRU ? "plru" : "random") << "\",\n"
+       << "  \"write_back\": " << (config.write_back ? "true" : "false") << ",\n"
+       << "  \"write_allocate\": " << (config.write_allocate ? "true" : "false") << ",\n"
+       << "  \"read_hits\": " << stats.read_hits << ",\n"
+       << "  \"read_misses\": " << stats.read_misses << ",\n"
+       << "  \"write_hits\": " << stats.write_hits << ",\n"
+       << "  \"write_misses\": " << stats.write_misses << ",\n"
+       << "  \"evictions\": " << stats.evictions << ",\n"
+       << "  \"write_backs\": " << stats.write_backs << ",\n"
+       << "  \"hit_rate\": " << (hits + misses ? (double)hits / (hits + misses) : 0.0) << "\n"
+       << "}\n";
   }
 
+  // Appends the content of every line to cache_status.log
   void print_cache_status(uint32_t operation_id, std::string time_str) {
+    if (!cacheFile.is_open()) cacheFile.open("cache_status.log");
     if (cacheFile.is_open()) {
       std::string log_cache = "";
       std::ostringstream ss;
 
       log_cache+= std::to_string(operation_id) + "):  " + time_str + "\n";
-      log_cache+= "INDEX | TAG | DATA BLOCK | VALID\n";
+      log_cache+= "INDEX | WAY | TAG | DATA BLOCK | VALID | DIRTY\n";
 
-      for(int i=0;i<number_of_blocks;i++) {
-        ss << "0x" << std::setw(this->nbits_index/4) << std::setfill('0') << std::hex << static_cast<uint32_t>(i);
+      for(uint32_t i=0;i<number_of_blocks;i++) {
+        ss << "0x" << std::setw(this->nbits_index/4) << std::setfill('0') << std::hex << static_cast<uint32_t>(i / ways);
         log_cache+= ss.str() + " | ";
         ss.str("");
         ss.clear();
+        log_cache+= std::to_string(i % ways) + " | ";
         ss << "0x" << std::setw(this->nbits_tags/4) << std::setfill('0') << std::hex << cache_array[i].tag;
         log_cache+= ss.str() + " | 0x";
         ss.str("");
         ss.clear();
-        for(int j = 0; j<block_size_byte; j++)
-          ss << ":" << std::setw(2) << std::setfill('0') << std::hex << static_cast<uint16_t>(cache_array[i].data[j]);
+        for(uint32_t j = 0; j<block_size_byte; j++)
+          ss << ":" << std::setw(2) << std::setfill('0') << std::hex << static_cast<uint16_t>(cache_data[i*block_size_byte + j]);
         log_cache+= ss.str() + " | ";
-        log_cache+= std::string( cache_array[i].valid ? "1" : "0" ) + "\n";
+        log_cache+= std::string( cache_array[i].valid ? "1" : "0" ) + " | ";
+        log_cache+= std::string( cache_array[i].dirty ? "1" : "0" ) + "\n";
 
         cacheFile << log_cache;
         ss.str("");
@@ -198,12 +319,12 @@ public:
     }
   }
 
-  /* main memory address
+  /* main memory address, direct mapped (1 way)
     0x7052 = 'b111_0000_0101_0010'
 
     cache size = 4KB,
     number_of_blocks = 256, thus index is on 8bit
-    block_size_in_byte = 4KB/256 = 16bytes, i.e. 4 words
+    block_size_in_byte = 16bytes, i.e. 4 words
 
     111:       tag
     0000_0101: used as index
@@ -214,7 +335,8 @@ public:
       get_index(0x7052) --> 0x5
       get_block_offset(0x7052) --> 0x2
 
-
+    With N ways, the number of sets (and of index bits) is divided by N
+    and the tag grows accordingly.
   */
 };
 
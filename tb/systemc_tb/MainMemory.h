@@ -13,56 +13,157 @@ using namespace std;
 #include "tlm_utils/simple_target_socket.h"
 
 
-// Target module representing a simple direct mapped cache
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <unordered_map>
+
+
+// Target module representing the external memory, covering the whole 32-bit address
+// space with 4 KiB pages allocated on first touch
 SC_MODULE(MainMemory)
 {
   // TLM-2 socket, defaults to 32-bits wide, base protocol
   tlm_utils::simple_target_socket<MainMemory> socket;
 
-  enum { SIZE = 32*1024/4 }; //32KB word addressable
+  enum { PAGE_BITS = 12, PAGE_SIZE = 1 << PAGE_BITS, PAGE_WORDS = PAGE_SIZE/4 };
+
+  std::unordered_map<uint32_t, std::unique_ptr<int32_t[]>> pages;  // page number -> words
+  // Last page accessed, most of the accesses hit the same page
+  uint32_t last_page_number;
+  int32_t* last_page;
 
-  int32_t mem[SIZE];
+  // Access latency per word, annotated on b_transport and given with the DMI pointer.
+  // Zero keeps the OBI timing set by MemoryRequest.
+  const sc_time LATENCY;
 
 
   SC_CTOR(MainMemory)
-  : socket("socket")
+  : socket("socket"), last_page_number(0), last_page(nullptr), LATENCY(SC_ZERO_TIME)
   {
-    // Register callback for incoming b_transport interface method call
+    // Register callbacks for incoming interface method calls
     socket.register_b_transport(this, &MainMemory::b_transport);
+    socket.register_get_direct_mem_ptr(this, &MainMemory::get_direct_mem_ptr);
+  }
 
-    // Initialize memory with random data
-    for (int i = 0; i < SIZE; i++)
-      mem[i] = 0xAA000000 | (rand() % 256);
+  // Page holding the address, allocated and initialized with random data on first touch
+  int32_t* get_page(uint32_t addr)
+  {
+    uint32_t page_number = addr >> PAGE_BITS;
+    if (last_page != nullptr && page_number == last_page_number) return last_page;
+
+    std::unique_ptr<int32_t[]>& page = pages[page_number];
+    if (!page) {
+      page.reset(new int32_t[PAGE_WORDS]);
+      for (int i = 0; i < PAGE_WORDS; i++)
+        page[i] = 0xAA000000 | (rand() % 256);
+    }
+    last_page_number = page_number;
+    last_page        = page.get();
+    return last_page;
+  }
+
+  void write_word(uint32_t addr, uint32_t data)
+  {
+    get_page(addr)[(addr & (PAGE_SIZE - 1)) / 4] = data;
+  }
+
+  // Writes the words of the firmware loader (ELF or Verilog hex)
+  void load(const std::map<uint32_t, uint32_t>& words)
+  {
+    for (const auto& word : words) write_word(word.first, word.second);
+  }
+
+  // Saves the touched pages as Verilog hex, which can be loaded back
+  bool save(const std::string& file_name)
+  {
+    std::ofstream f(file_name);
+    if (!f.is_open()) return false;
+
+    std::map<uint32_t, int32_t*> sorted_pages;
+    for (const auto& page : pages) sorted_pages[page.first] = page.second.get();
+
+    f << std::hex << std::setfill('0');
+    for (const auto& page : sorted_pages) {
+      f << "@" << std::setw(8) << (page.first << PAGE_BITS) << "\n";
+      const uint8_t* bytes = reinterpret_cast<const uint8_t*>(page.second);
+      for (int i = 0; i < PAGE_SIZE; i++)
+        f << std::setw(2) << (unsigned int)bytes[i] << ((i % 16 == 15) ? "\n" : " ");
+    }
+    return true;
   }
 
   // TLM-2 blocking transport method
   virtual void b_transport( tlm::tlm_generic_payload& trans, sc_time& delay )
   {
     tlm::tlm_command cmd = trans.get_command();
-    sc_dt::uint64    adr = trans.get_address() / 4;
+    uint32_t         adr = (uint32_t)trans.get_address();
     unsigned char*   ptr = trans.get_data_ptr();
     unsigned int     len = trans.get_data_length();
     unsigned char*   byt = trans.get_byte_enable_ptr();
     unsigned int     wid = trans.get_streaming_width();
+    unsigned int     bel = trans.get_byte_enable_length();
 
     // Obliged to check address range and check for unsupported features,
-    //   i.e. byte enables, streaming, and bursts
-    // Can ignore DMI hint and extensions
+    //   i.e. streaming
+    // Bursts of whole words are supported, e.g. a cache line in a single transaction
+    // Byte enables are supported, e.g. the sub-word stores of the OBI port
+    // Can ignore extensions
     // Using the SystemC report handler is an acceptable way of signalling an error
 
-    if (adr >= sc_dt::uint64(SIZE) || byt != 0 || len > 4 || wid < len)
+    if ((sc_dt::uint64)adr + len > 0x100000000ULL || (adr & 0x3) || (byt != 0 && bel == 0) || wid < len)
       SC_REPORT_ERROR("TLM-2", "Target does not support given generic payload transaction");
 
-    // Obliged to implement read and write commands
-    if ( cmd == tlm::TLM_READ_COMMAND )
-      memcpy(ptr, &mem[adr], len);
-    else if ( cmd == tlm::TLM_WRITE_COMMAND )
-      memcpy(&mem[adr], ptr, len);
+    // Obliged to implement read and write commands, page by page
+    for (unsigned int done = 0; done < len; ) {
+      uint32_t       page_offset = (adr + done) & (PAGE_SIZE - 1);
+      unsigned int   chunk       = std::min(len - done, (unsigned int)(PAGE_SIZE - page_offset));
+      unsigned char* mem_ptr     = reinterpret_cast<unsigned char*>(get_page(adr + done)) + page_offset;
+
+      if ( byt != 0 ) {
+        // Only the enabled bytes are transferred, the byte enable array is repeated over the data
+        for (unsigned int i = 0; i < chunk; i++) {
+          if (byt[(done + i) % bel] == TLM_BYTE_ENABLED) {
+            if ( cmd == tlm::TLM_READ_COMMAND )
+              ptr[done + i] = mem_ptr[i];
+            else if ( cmd == tlm::TLM_WRITE_COMMAND )
+              mem_ptr[i] = ptr[done + i];
+          }
+        }
+      } else if ( cmd == tlm::TLM_READ_COMMAND )
+        memcpy(ptr + done, mem_ptr, chunk);
+      else if ( cmd == tlm::TLM_WRITE_COMMAND )
+        memcpy(mem_ptr, ptr + done, chunk);
+
+      done += chunk;
+    }
+
+    delay += LATENCY * ((len + 3) / 4);
+
+    // The page of the address can be accessed with a DMI pointer
+    trans.set_dmi_allowed( true );
 
     // Obliged to set response status to indicate successful completion
     trans.set_response_status( tlm::TLM_OK_RESPONSE );
   }
 
+  // TLM-2 forward DMI method, the pointer covers the page of the address and is never
+  // invalidated as pages are never freed
+  virtual bool get_direct_mem_ptr( tlm::tlm_generic_payload& trans, tlm::tlm_dmi& dmi_data )
+  {
+    uint32_t page_base = (uint32_t)trans.get_address() & ~(uint32_t)(PAGE_SIZE - 1);
+    dmi_data.allow_read_write();
+    dmi_data.set_dmi_ptr( reinterpret_cast<unsigned char*>(get_page(page_base)) );
+    dmi_data.set_start_address( page_base );
+    dmi_data.set_end_address( (sc_dt::uint64)page_base + PAGE_SIZE - 1 );
+    dmi_data.set_read_latency( LATENCY );
+    dmi_data.set_write_latency( LATENCY );
+    return true;
+  }
+
 };
 
 #endif
@@ -1,6 +1,9 @@
 #ifndef MEMORYREQUEST_H
 #define MEMORYREQUEST_H
 
+// Needed for the simple_target_socket and the payload event queue
+#define SC_INCLUDE_DYNAMIC_PROCESSES
+
 #include "systemc"
 using namespace sc_core;
 using namespace sc_dt;
@@ -8,233 +11,367 @@ using namespace std;
 
 #include "tlm.h"
 #include "tlm_utils/simple_initiator_socket.h"
+#include "tlm_utils/simple_target_socket.h"
+#include "tlm_utils/peq_with_cb_and_phase.h"
 
 #include "Cache.h"
+#include "TraceBuffer.h"
 
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 #include <sstream>
 #include <iomanip>
+#include <vector>
 
-// MemoryRequest module generating generic payload transactions
+// MemoryRequest module serving the OBI requests of the external memory bridge
+// (AT four-phase protocol on target_socket) through the cache model, and
+// generating generic payload transactions to the main memory on socket.
+// Every request is accepted at once (END_REQ) and answered with BEGIN_RESP after
+// the latency of the cache and of its address region, so that requests overlap.
 
 SC_MODULE(MemoryRequest)
 {
-  // TLM-2 socket, defaults to 32-bits wide, base protocol
+  // TLM-2 sockets, default to 32-bits wide, base protocol
+  tlm_utils::simple_target_socket<MemoryRequest>    target_socket;
   tlm_utils::simple_initiator_socket<MemoryRequest> socket;
-  bool                                          we_i;
-  uint32_t                                      be_i;
-  uint32_t                                      addr_i;
-  uint32_t                                      rwdata_io;
+  tlm_utils::peq_with_cb_and_phase<MemoryRequest>   m_peq;
   CacheMemory*                                  cache;
-  std::ofstream                                 heep_mem_transactions;
+  // Binary trace of the requests, opened with open_trace()
+  TraceBuffer                                   trace;
   bool                                          bypass_state = false;
-
-  typedef struct cache_statistics
-  {
-    uint32_t number_of_transactions;
-    uint32_t number_of_hit;
-    uint32_t number_of_miss;
-  } cache_statistics_t;
-
-  cache_statistics_t cache_stat;
+  // Direct Memory Interface to the main memory, requested after the first transaction
+  tlm::tlm_dmi                                  dmi_data;
+  bool                                          dmi_ptr_valid = false;
+  // Main memory latency of the request being served, added to its response time
+  sc_time                                       mem_delay;
+  // Generic payload reused for the transactions to the main memory
+  tlm::tlm_generic_payload                      mem_trans;
+  std::vector<int32_t>                          main_mem_data;
+  unsigned char                                 mem_byte_enable[4];
+
+  // Latency of the cache on a hit and on a miss (line fill)
+  const sc_time                                 delay_hit;
+  const sc_time                                 delay_miss;
+
+  // Address region of the external memory with its own timing. latency is added to the
+  // latency of the cache, interval is the minimum time between two responses of the
+  // region (i.e. the bandwidth of a pipelined device, one word every interval).
+  typedef struct memory_region {
+    uint32_t start;
+    uint32_t end;       // inclusive
+    sc_time  latency;
+    sc_time  interval;
+    sc_time  next_free; // earliest time of the next response
+  } memory_region_t;
+
+  std::vector<memory_region_t>                  regions;
+
+  uint32_t                                      number_of_transactions = 0;
+
+  // Configuration register to flush or bypass the cache, last word of the first 32 KiB
+  // of the external slave window
+  enum { CONFIG_REG_OFFSET = 0x7FFC };
+
+  // Start of the external slave window, set by sc_main from core_v_mini_mcu_pkg
+  uint32_t                                      ext_window_start = 0;
 
   SC_CTOR(MemoryRequest)
-  : socket("socket"),  // Construct and name socket
-    heep_mem_transactions("heep_mem_transactions.log")
+  : target_socket("target_socket"),
+    socket("socket"),  // Construct and name sockets
+    m_peq(this, &MemoryRequest::peq_cb),
+    delay_hit(20, SC_NS),     //as of today, it must be >=20
+    delay_miss(200, SC_NS)
   {
+    target_socket.register_nb_transport_fw(this, &MemoryRequest::nb_transport_fw);
+    socket.register_invalidate_direct_mem_ptr(this, &MemoryRequest::invalidate_direct_mem_ptr);
 
     cache = new CacheMemory;
-    cache->create_cache();
+  }
+
+  // Must be called before the simulation starts, regions are matched in order
+  void add_region(uint32_t start, uint32_t end, const sc_time& latency, const sc_time& interval) {
+    regions.push_back({start, end, latency, interval, SC_ZERO_TIME});
+  }
+
+  // Must be called before the simulation starts, the trace is off otherwise
+  bool open_trace(const std::string& file_name) {
+    return trace.open(file_name);
+  }
+
+  inline void trace_log(TraceBuffer::record_type_t type, uint32_t addr, uint32_t data, uint16_t aux = 0,
+                        const sc_time& delay = SC_ZERO_TIME) {
+    if (!trace.enabled()) return;
+    trace.log((uint64_t)((sc_time_stamp() + delay) / sc_time(1, SC_PS)), type, addr, data, aux, bypass_state);
+  }
+
+  // Must be called before the simulation starts
+  bool configure_cache(const CacheMemory::cache_config_t& config) {
+    if (!cache->create_cache(config)) return false;
     cache->initialize_cache();
-    cache_stat.number_of_transactions = 0;
-    cache_stat.number_of_hit = 0;
-    cache_stat.number_of_miss = 0;
-    cache->print_cache_status(cache_stat.number_of_transactions++, sc_time_stamp().to_string());
+    main_mem_data.resize(cache->get_block_size()/4);
+    return true;
+  }
+
 
-    SC_THREAD(thread_process);
+  // TLM-2 backward DMI method
+  virtual void invalidate_direct_mem_ptr(sc_dt::uint64 start_range, sc_dt::uint64 end_range)
+  {
+    dmi_ptr_valid = false;
   }
 
+  // Copies N words from/to the main memory: a host memcpy when the DMI pointer covers them,
+  // otherwise a single burst transaction. The memory latency is accumulated in mem_delay.
+  // Only the bytes of byte_enable (bit i for byte i of each word) are written.
+  uint32_t memory_copy(uint32_t addr, int32_t* buffer_data, int N, bool write_enable, uint32_t byte_enable = 0xF) {
 
-  uint32_t memory_copy(uint32_t addr, int32_t* buffer_data, int N, bool write_enable, tlm::tlm_generic_payload* trans, sc_time delay) {
+    tlm::tlm_generic_payload* trans = &mem_trans;
 
     tlm::tlm_command cmd = write_enable ? tlm::TLM_WRITE_COMMAND : tlm::TLM_READ_COMMAND;
-
-    //first read block_size bytes from memory to place them in cache regardless of the cmd
-    for(int i=0; i < N; i++){
+    sc_dt::uint64 mem_addr = addr;
+    unsigned int len = N*4;
+
+    if (dmi_ptr_valid && mem_addr >= dmi_data.get_start_address() && mem_addr + len - 1 <= dmi_data.get_end_address()
+        && (write_enable ? dmi_data.is_write_allowed() : dmi_data.is_read_allowed())) {
+      unsigned char* dmi_ptr = dmi_data.get_dmi_ptr() + (mem_addr - dmi_data.get_start_address());
+      if(write_enable && byte_enable != 0xF) {
+        for(unsigned int i = 0; i < len; i++)
+          if(byte_enable & (1 << (i % 4))) dmi_ptr[i] = reinterpret_cast<unsigned char*>(buffer_data)[i];
+      } else if(write_enable)
+        memcpy(dmi_ptr, buffer_data, len);
+      else
+        memcpy(buffer_data, dmi_ptr, len);
+      mem_delay += (write_enable ? dmi_data.get_write_latency() : dmi_data.get_read_latency()) * N;
+    } else {
+      sc_time delay = mem_delay;
       trans->set_command( cmd );
-      trans->set_address( (addr + i*4) & 0x00007FFF ); //15bits
-      trans->set_data_ptr( reinterpret_cast<unsigned char*>(&buffer_data[i]) );
-      trans->set_data_length( 4 );
-      trans->set_streaming_width( 4 ); // = data_length to indicate no streaming
-      trans->set_byte_enable_ptr( 0 ); // 0 indicates unused
+      trans->set_address( mem_addr );
+      trans->set_data_ptr( reinterpret_cast<unsigned char*>(buffer_data) );
+      trans->set_data_length( len );
+      trans->set_streaming_width( len ); // = data_length to indicate no streaming
+      if(write_enable && byte_enable != 0xF) {
+        for(int i = 0; i < 4; i++)
+          mem_byte_enable[i] = (byte_enable & (1 << i)) ? TLM_BYTE_ENABLED : TLM_BYTE_DISABLED;
+        trans->set_byte_enable_ptr( mem_byte_enable );
+        trans->set_byte_enable_length( 4 );
+      } else
+        trans->set_byte_enable_ptr( 0 ); // 0 indicates unused
       trans->set_dmi_allowed( false ); // Mandatory initial value
       trans->set_response_status( tlm::TLM_INCOMPLETE_RESPONSE ); // Mandatory initial value
       socket->b_transport( *trans, delay );  // Blocking transport call
+      mem_delay = delay;
 
-      if(bypass_state){
-        if(write_enable)
-          heep_mem_transactions << "Writing to Mem[" << hex << ((addr + i*4) & 0x00007FFF) << "]: " << buffer_data[i] << " at time " << sc_time_stamp() <<std::endl;
-        else
-          heep_mem_transactions << "Reading from Mem[" << hex << ((addr + i*4) & 0x00007FFF) << "]: " << buffer_data[i] << " at time " << sc_time_stamp() <<std::endl;
-      } else {
-        if(write_enable)
-          heep_mem_transactions << "Cache Writing to Mem[" << hex << ((addr + i*4) & 0x00007FFF) << "]: " << buffer_data[i] << " at time " << sc_time_stamp() <<std::endl;
-        else
-          heep_mem_transactions << "Cache Reading from Mem[" << hex << ((addr + i*4) & 0x00007FFF) << "]: " << buffer_data[i] << " at time " << sc_time_stamp() <<std::endl;
-      }
       // Initiator obliged to check response status and delay
       if ( trans->is_response_error() )
         SC_REPORT_ERROR("TLM-2", "Response error from b_transport");
+
+      // DMI pointer to the new region of the memory (a page)
+      if ( trans->is_dmi_allowed() )
+        dmi_ptr_valid = socket->get_direct_mem_ptr( *trans, dmi_data );
     }
+
+    if (trace.enabled()) {
+      for(int i=0; i < N; i++)
+        trace_log(write_enable ? TraceBuffer::MEM_WRITE : TraceBuffer::MEM_READ, addr + i*4, buffer_data[i],
+                  write_enable ? byte_enable : 0xF);
+    }
+
     return N;
   }
 
 
-  void thread_process()
+  // Writes the dirty lines back to the main memory, returns their number
+  uint32_t flush_cache() {
+    uint32_t cache_block_size_word = cache->get_block_size()/4;
+    uint32_t cache_flushed = 0;
+    for(uint32_t i=0;i<cache->number_of_blocks;i++){
+      // with write-through the memory is already up to date
+      if (cache->is_line_dirty(i)) {
+        cache_flushed++;
+        uint32_t address_to_replace = cache->get_line_address(i);
+        trace_log(TraceBuffer::WRITE_BACK, address_to_replace, 0, i % cache->ways);
+        //write back
+        memory_copy(address_to_replace, (int32_t *)cache->get_line_data(i), cache_block_size_word, true);
+        cache->cache_array[i].dirty = false;
+        cache->stats.write_backs++;
+      }
+    }
+    return cache_flushed;
+  }
+
+  // Address region of the request, nullptr if it has none
+  memory_region_t* find_region(uint32_t addr) {
+    for (memory_region_t& region : regions) {
+      if (addr >= region.start && addr <= region.end) return &region;
+    }
+    return nullptr;
+  }
+
+  // TLM-2 non-blocking forward transport method of the OBI bridge
+  virtual tlm::tlm_sync_enum nb_transport_fw( tlm::tlm_generic_payload& trans, tlm::tlm_phase& phase, sc_time& delay )
   {
-    // TLM-2 generic payload transaction, reused across calls to b_transport
-    tlm::tlm_generic_payload* trans = new tlm::tlm_generic_payload;
+    if (phase == tlm::BEGIN_REQ) {
+      sc_time latency = serve_request(trans);
+
+      // Responses of a region leave at most one every interval
+      memory_region_t* region = find_region((uint32_t)trans.get_address());
+      if (region != nullptr) {
+        sc_time resp_time = sc_time_stamp() + delay + latency + region->latency;
+        if (resp_time < region->next_free) resp_time = region->next_free;
+        region->next_free = resp_time + region->interval;
+        latency = resp_time - sc_time_stamp() - delay;
+      }
+
+      trace_log(TraceBuffer::RESP, (uint32_t)trans.get_address(), *reinterpret_cast<uint32_t*>(trans.get_data_ptr()),
+                (uint16_t)std::min(latency / sc_time(1, SC_NS), 65535.0), delay + latency);
+
+      tlm::tlm_phase resp_phase = tlm::BEGIN_RESP;
+      m_peq.notify(trans, resp_phase, delay + latency);
+
+      // The request is accepted right away, the bridge bounds the outstanding ones
+      phase = tlm::END_REQ;
+      return tlm::TLM_UPDATED;
+    }
 
-    sc_time delay_gnt_miss = sc_time(100, SC_NS);
-    sc_time delay_rvalid_miss = sc_time(100, SC_NS);
+    if (phase != tlm::END_RESP)
+      SC_REPORT_ERROR("TLM-2", "Illegal transaction phase received by the external memory");
 
-    sc_time delay_rvalid_hit = sc_time(20, SC_NS); //as of today, it must be >=20
+    return tlm::TLM_COMPLETED;
+  }
 
-    sc_time delay = sc_time(1, SC_NS);
+  void peq_cb( tlm::tlm_generic_payload& trans, const tlm::tlm_phase& phase )
+  {
+    tlm::tlm_phase bw_phase = tlm::BEGIN_RESP;
+    sc_time delay = SC_ZERO_TIME;
+
+    trans.set_response_status( tlm::TLM_OK_RESPONSE );
+    // The bridge completes the transaction with END_RESP when the OBI rvalid is given
+    target_socket->nb_transport_bw( trans, bw_phase, delay );
+  }
+
+  // Serves the OBI request of the transaction through the cache (the data are exchanged
+  // at once) and returns its latency
+  sc_time serve_request( tlm::tlm_generic_payload& trans )
+  {
+    bool      we_i      = trans.get_command() == tlm::TLM_WRITE_COMMAND;
+    uint32_t  addr_i    = (uint32_t)trans.get_address();
+    uint32_t* rwdata_io = reinterpret_cast<uint32_t*>(trans.get_data_ptr());
+    uint32_t  be_i      = 0xF;
+
+    // Byte enables of a sub-word access, one per byte of the word
+    if (trans.get_byte_enable_ptr() != 0) {
+      be_i = 0;
+      for (unsigned int i = 0; i < 4; i++)
+        if (trans.get_byte_enable_ptr()[i % trans.get_byte_enable_length()] == TLM_BYTE_ENABLED) be_i |= 1 << i;
+    }
 
-    uint32_t cache_block_size_byte = cache->get_block_size();
     uint32_t cache_block_size_word = cache->get_block_size()/4;
-    uint8_t* cache_data = new uint8_t[cache_block_size_byte];
-    int32_t* main_mem_data = new int32_t[cache_block_size_word];
     uint32_t address_to_replace;
     uint32_t cache_flushed;
+    sc_time  latency;
 
-    while(true) {
+    mem_delay = SC_ZERO_TIME;
 
-      wait(obi_new_req);
+    trace_log(we_i ? TraceBuffer::REQ_WRITE : TraceBuffer::REQ_READ, addr_i, we_i ? *rwdata_io : 0, be_i);
 
-      heep_mem_transactions << "X-HEEP tlm_generic_payload REQ: { " << (we_i ? 'W' : 'R') << ", @0x" << hex << addr_i
-                << " , DATA = 0x" << hex << rwdata_io << " BE = " << hex << be_i <<", at time " << sc_time_stamp() << " }" << std::endl;
+    //if we are writing 1 or 2 to last address, flush cache or bypass
+    if(we_i && (addr_i == ext_window_start + CONFIG_REG_OFFSET)){
 
-      if(be_i!=0xF) {
-        SC_REPORT_ERROR("OBI External Memory SystemC", "ByteEnable different than 0xF is not supported");
+      if(*rwdata_io == 1){
+        //FLUSH Cache
+        cache_flushed = flush_cache();
+        trace_log(TraceBuffer::FLUSH, addr_i, cache_flushed);
+      } else if (*rwdata_io == 2){
+        //ByPass Flash from next transaction
+        bypass_state = true;
+        trace_log(TraceBuffer::BYPASS, addr_i, 0);
       }
+      latency = delay_miss;
+    }
 
-      //if we are writing 1 or 2 to last address, flush cache or bypass
-      if(we_i && ((addr_i & 0x00007FFF) == 0x7FFC)){
-
-        if(rwdata_io == 1){
-          //FLUSH Cache
-          heep_mem_transactions << "X-HEEP Flush Cache, at time " << sc_time_stamp() << " }" << std::endl;
-          uint32_t cache_number_of_blocks = cache->number_of_blocks;
-          heep_mem_transactions<<"Cache Flushing at time "<<sc_time_stamp()<<std::endl;
-          cache_flushed=0;
-          for(int i=0;i<cache_number_of_blocks;i++){
-              if (cache->is_entry_valid_at_index(i)) {
-                cache_flushed++;
-                //if we are going to replace a valid entry
-                cache->get_data_at_index(i, cache_data);
-                address_to_replace = cache->get_address_at_index(i);
-                //write back
-                memory_copy(address_to_replace, (int32_t *)cache_data, cache_block_size_word, true, trans, delay);
-            }
-          }
-          heep_mem_transactions<<"Cache Flushed "<< dec << cache_flushed << " entries"<<std::endl;
-        } else if (rwdata_io == 2){
-          //ByPass Flash from next transaction
-          bypass_state = true;
-          heep_mem_transactions<<"Cache ByPass set at time "<<sc_time_stamp()<<std::endl;
-          heep_mem_transactions << "X-HEEP Bypass Cache, at time " << sc_time_stamp() << " }" << std::endl;
-        }
-        obi_new_gnt.notify();
-        wait(delay_rvalid_miss);
-      }
+    else{
 
-      else{
-
-        if (bypass_state) {
-          heep_mem_transactions << "Cache in bypass state at time " << sc_time_stamp() <<std::endl;
-          wait(delay_gnt_miss);
-          obi_new_gnt.notify();
-          memory_copy(addr_i, (int32_t *) &rwdata_io, 1, we_i == true, trans, delay);
-          wait(delay_rvalid_miss);
-        } else {
-          // we use the cache only to read
-          if(cache->cache_hit(addr_i)){
-
-            heep_mem_transactions << "Cache HIT on address " << hex << addr_i << " at time " << sc_time_stamp() <<std::endl;
-
-            cache_stat.number_of_hit++;
-
-            obi_new_gnt.notify();
-            main_mem_data[0] = cache->get_word(addr_i);
-            //if Write, writes to cache
-            if(we_i)
-              cache->set_word(addr_i, rwdata_io);
-            else
-              rwdata_io = main_mem_data[0];
-            wait(delay_rvalid_hit);
-          }
+      if (bypass_state) {
+        memory_copy(addr_i, (int32_t *) rwdata_io, 1, we_i == true, be_i);
+        latency = delay_miss;
+      } else {
+        int32_t line = cache->find_line(addr_i);
 
-          else { //miss case
+        if(line >= 0){
 
-            cache_stat.number_of_miss++;
+          trace_log(TraceBuffer::HIT, addr_i, 0, line % cache->ways);
 
-            heep_mem_transactions << "Cache MISS on address " << hex << addr_i << " at time " << sc_time_stamp() <<std::endl;
+          if(we_i) cache->stats.write_hits++;
+          else     cache->stats.read_hits++;
 
-            //wait some time before giving the gnt as we have a miss
-            wait(delay_gnt_miss);
-            obi_new_gnt.notify();
+          //if Write, writes to cache, and to the memory with write-through
+          if(we_i) {
+            cache->set_word(line, addr_i, *rwdata_io, be_i);
+            if(!cache->config.write_back)
+              memory_copy(addr_i, (int32_t *) rwdata_io, 1, true, be_i);
+          } else
+            *rwdata_io = cache->get_word(line, addr_i);
+          latency = delay_hit;
+        }
 
-            uint32_t addr_to_read = cache->get_base_address(addr_i);
-            uint32_t addr_offset  = cache->get_block_offset(addr_i);
+        else if(we_i && !cache->config.write_allocate) { //write miss without allocation
 
-            //first read block_size bytes from memory to place them in cache regardless of the cmd
-            memory_copy(addr_to_read, main_mem_data, cache_block_size_word, false, trans, delay);
-            uint32_t index_to_add = cache->get_index(addr_i);
-            uint32_t tag_to_add       = cache->get_tag(addr_i);
+          cache->stats.write_misses++;
 
-            heep_mem_transactions << "Adding to Cache TAG " << hex << tag_to_add << " and index " << hex << index_to_add <<std::endl;
+          trace_log(TraceBuffer::MISS, addr_i, 0, 0xFF);
 
-            //always write back what will be replace if valid as we do not have dirty bits for simplicity
-            if (cache->is_entry_valid(addr_i)) {
-              //if we are going to replace a valid entry
-              cache->get_data(addr_i, cache_data);
-              address_to_replace = cache->get_address(addr_i);
-              uint32_t index_to_replace = cache->get_index(addr_i);
-              uint32_t tag_to_replace = cache->get_tag_from_index(index_to_replace);
+          memory_copy(addr_i, (int32_t *) rwdata_io, 1, true, be_i);
+          latency = delay_miss;
+        }
 
-              heep_mem_transactions << "Cache Replace address " << hex << addr_i << " with address " << hex << address_to_replace << " due to the MISS at time " << sc_time_stamp() <<std::endl;
-              heep_mem_transactions << "Index to replace " << hex << index_to_replace << " Tag to replace " << tag_to_replace <<std::endl;
+        else { //miss case
 
-              //write back
-              memory_copy(address_to_replace, (int32_t *)cache_data, cache_block_size_word, true, trans, delay);
-            }
+          if(we_i) cache->stats.write_misses++;
+          else     cache->stats.read_misses++;
 
-            //now replace the entry in cache
-            cache->add_entry(addr_i, (uint8_t*)main_mem_data);
+          line = cache->get_victim(addr_i);
 
-            //if Write, writes to cache
-            if(we_i)
-              cache->set_word(addr_i, rwdata_io);
+          trace_log(TraceBuffer::MISS, addr_i, 0, line % cache->ways);
 
-            //now give back the rdata
-            rwdata_io = main_mem_data[addr_offset>>2]; //>>2 as addr_offset is for byte address, not words
+          uint32_t addr_to_read = cache->get_base_address(addr_i);
+
+          //first read block_size bytes from memory to place them in cache regardless of the cmd
+          memory_copy(addr_to_read, main_mem_data.data(), cache_block_size_word, false);
 
-            //wait some time before giving the rvalid
-            wait(delay_rvalid_miss);
+          //write back the entry that will be replaced if it was modified
+          if (cache->is_line_dirty(line)) {
+            address_to_replace = cache->get_line_address(line);
 
+            trace_log(TraceBuffer::WRITE_BACK, address_to_replace, 0, line % cache->ways);
+
+            //write back
+            memory_copy(address_to_replace, (int32_t *)cache->get_line_data(line), cache_block_size_word, true);
+            cache->stats.write_backs++;
           }
+
+          //now replace the entry in cache
+          cache->fill_line(line, addr_i, (uint8_t*)main_mem_data.data());
+
+          //if Write, writes to cache, and to the memory with write-through
+          if(we_i) {
+            cache->set_word(line, addr_i, *rwdata_io, be_i);
+            if(!cache->config.write_back)
+              memory_copy(addr_i, (int32_t *) rwdata_io, 1, true, be_i);
+          } else
+            //now give back the rdata
+            *rwdata_io = cache->get_word(line, addr_i);
+
+          latency = delay_miss;
         }
       }
+    }
 
-      heep_mem_transactions << "X-HEEP tlm_generic_payload RESP: { DATA = 0x" << hex << rwdata_io <<", at time " << sc_time_stamp() << " }" << std::endl;
-      cache->print_cache_status(cache_stat.number_of_transactions++, sc_time_stamp().to_string());
+    // The memory accesses of the request are done before its response
+    latency += mem_delay;
 
-      obi_new_rvalid.notify();
+    number_of_transactions++;
 
-    }
+    return latency;
   }
 };
 
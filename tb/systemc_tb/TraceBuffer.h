@@ -0,0 +1,149 @@
+#ifndef TRACEBUFFER_H
+#define TRACEBUFFER_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Binary trace of the external memory model, decoded offline with util/decode_mem_trace.py.
+// Records are appended to a ring of blocks; full blocks are written to the file by a
+// background thread, so the simulation only pays for filling the records. When the
+// trace is not opened (the default) log() returns right away.
+//
+// File format: the 16-byte header "XHMTRACE", version (uint32) and record size (uint32),
+// followed by the records, all little endian.
+class TraceBuffer
+{
+
+public:
+  enum record_type_t : uint8_t {
+    REQ_READ   = 0,  // OBI read request accepted, aux = byte enable
+    REQ_WRITE  = 1,  // OBI write request accepted, data = wdata, aux = byte enable
+    RESP       = 2,  // response ready, data = rdata, aux = latency in ns
+    HIT        = 3,  // cache hit, aux = way
+    MISS       = 4,  // cache miss, aux = way of the line filled (0xFF if not filled)
+    WRITE_BACK = 5,  // dirty line at addr written back to the memory
+    MEM_READ   = 6,  // word read from the main memory
+    MEM_WRITE  = 7,  // word written to the main memory
+    FLUSH      = 8,  // cache flushed, data = number of lines written back
+    BYPASS     = 9   // cache bypassed from now on
+  };
+
+  typedef struct __attribute__((packed)) trace_record {
+    uint64_t time_ps;
+    uint32_t addr;
+    uint32_t data;
+    uint8_t  type;
+    uint8_t  bypass;  // 1 if the cache is bypassed
+    uint16_t aux;
+    uint32_t reserved;
+  } trace_record_t;
+
+  enum { VERSION = 1, BLOCK_RECORDS = 4096, NUM_BLOCKS = 16 };
+
+  TraceBuffer(): file(nullptr), blocks(NUM_BLOCKS), block_full(NUM_BLOCKS, false),
+                 block_size(NUM_BLOCKS, 0), current(0), fill(0), stop(false)
+  {
+  }
+
+  ~TraceBuffer() {
+    close();
+  }
+
+  bool open(const std::string& file_name) {
+    file = fopen(file_name.c_str(), "wb");
+    if (file == nullptr) {
+      std::cout << "[TESTBENCH]: ERROR: cannot open the memory trace " << file_name << std::endl;
+      return false;
+    }
+    uint32_t header[4];
+    memcpy(header, "XHMTRACE", 8);
+    header[2] = VERSION;
+    header[3] = sizeof(trace_record_t);
+    fwrite(header, sizeof(header), 1, file);
+
+    for (std::vector<trace_record_t>& block : blocks) block.resize(BLOCK_RECORDS);
+    writer = std::thread(&TraceBuffer::writer_thread, this);
+    return true;
+  }
+
+  bool enabled() const {
+    return file != nullptr;
+  }
+
+  inline void log(uint64_t time_ps, record_type_t type, uint32_t addr, uint32_t data, uint16_t aux, bool bypass) {
+    if (file == nullptr) return;
+    trace_record_t& r = blocks[current][fill];
+    r.time_ps  = time_ps;
+    r.addr     = addr;
+    r.data     = data;
+    r.type     = type;
+    r.bypass   = bypass;
+    r.aux      = aux;
+    r.reserved = 0;
+    if (++fill == BLOCK_RECORDS) submit(BLOCK_RECORDS);
+  }
+
+  // Writes the pending records and stops the writer thread
+  void close() {
+    if (file == nullptr) return;
+    if (fill != 0) submit(fill);
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stop = true;
+    }
+    cv.notify_all();
+    writer.join();
+    fclose(file);
+    file = nullptr;
+  }
+
+private:
+  FILE*                                    file;
+  std::vector<std::vector<trace_record_t>> blocks;
+  std::vector<bool>                        block_full;
+  std::vector<size_t>                      block_size;
+  size_t                                   current;
+  size_t                                   fill;
+  bool                                     stop;
+  std::mutex                               mutex;
+  std::condition_variable                  cv;
+  std::thread                              writer;
+
+  // Hands the current block to the writer and moves to the next one, waiting for it if
+  // the writer is late (records are never dropped)
+  void submit(size_t records) {
+    std::unique_lock<std::mutex> lock(mutex);
+    block_size[current] = records;
+    block_full[current] = true;
+    cv.notify_all();
+    current = (current + 1) % NUM_BLOCKS;
+    fill = 0;
+    cv.wait(lock, [this] { return !block_full[current]; });
+  }
+
+  void writer_thread() {
+    size_t next = 0;
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+      cv.wait(lock, [this, next] { return block_full[next] || stop; });
+      if (!block_full[next]) break;  // stopped with every block written
+      size_t records = block_size[next];
+      lock.unlock();
+      fwrite(blocks[next].data(), sizeof(trace_record_t), records, file);
+      lock.lock();
+      block_full[next] = false;
+      cv.notify_all();
+      next = (next + 1) % NUM_BLOCKS;
+    }
+  }
+
+};
+
+#endif
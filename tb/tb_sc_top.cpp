@@ -9,24 +9,33 @@
 #include "systemc.h"
 #include <stdlib.h>
 #include <iostream>
+#include <fstream>
+#include <sstream>
+#include <deque>
+#include <vector>
 #include <sys/stat.h>
+#include <csignal>
 #include "XHEEP_CmdLineOptions.hh"
+#include "XHEEP_FirmwareLoader.hh"
 
 sc_event reset_done_event;
-sc_event obi_new_gnt;
-sc_event obi_new_rvalid;
-sc_event obi_new_req;
 
 
 #include "systemc_tb/MemoryRequest.h"
 #include "systemc_tb/MainMemory.h"
 
 
+// Bridge from the OBI port of X-HEEP to the memory model, TLM-2 AT four-phase protocol.
+// A request is accepted (gnt) while less than max_outstanding requests are in flight and
+// sent with BEGIN_REQ; the responses come back with BEGIN_RESP in any order and are given
+// back to the RTL in the OBI order, one rvalid per cycle, completing them with END_RESP.
 SC_MODULE(external_memory)
 {
   MemoryRequest *memory_request;
   MainMemory    *memory;
 
+  tlm_utils::simple_initiator_socket<external_memory> socket;
+
   sc_in<bool>          clk_i;
   sc_in<bool>          ext_systemc_req_req_i;
   sc_in<bool>          ext_systemc_req_we_i;
@@ -37,57 +46,132 @@ SC_MODULE(external_memory)
   sc_out<bool>         ext_systemc_resp_rvalid_o;
   sc_out<uint32_t>     ext_systemc_resp_rdata_o;
 
-  void notify_obi_transaction () {
-    if(ext_systemc_req_req_i) {
-      obi_new_req.notify();
-      memory_request->we_i    = ext_systemc_req_we_i;
-      memory_request->be_i    = ext_systemc_req_be_i;
-      memory_request->addr_i  = ext_systemc_req_addr_i;
-      memory_request->rwdata_io = ext_systemc_req_wdata_i;
-    }
-  }
+  typedef struct obi_transaction {
+    tlm::tlm_generic_payload trans;
+    uint32_t                 data;
+    unsigned char            byte_enable[4];
+    bool                     resp_valid;
+  } obi_transaction_t;
+
+  // Must be set before the simulation starts
+  unsigned int max_outstanding = 4;
 
-  void give_gnt_back () {
+  std::vector<obi_transaction_t*> free_transactions;
+  std::deque<obi_transaction_t*>  outstanding;       // OBI order
+
+  void obi_request () {
+    for (unsigned int i = 0; i < max_outstanding; i++) free_transactions.push_back(new obi_transaction_t);
+
+    ext_systemc_resp_gnt_o.write(false);
+    wait();
     while (true) {
-      ext_systemc_resp_gnt_o.write(false);
-      wait(obi_new_gnt);
-      ext_systemc_resp_gnt_o.write(true);
+      // OBI handshake of the cycle, gnt was given in the previous one
+      if (ext_systemc_resp_gnt_o.read() && ext_systemc_req_req_i.read()) {
+        obi_transaction_t* t = free_transactions.back();
+        free_transactions.pop_back();
+        t->data       = ext_systemc_req_wdata_i.read();
+        t->resp_valid = false;
+        t->trans.set_command( ext_systemc_req_we_i.read() ? tlm::TLM_WRITE_COMMAND : tlm::TLM_READ_COMMAND );
+        t->trans.set_address( ext_systemc_req_addr_i.read() );
+        t->trans.set_data_ptr( reinterpret_cast<unsigned char*>(&t->data) );
+        t->trans.set_data_length( 4 );
+        t->trans.set_streaming_width( 4 );
+        // Sub-word accesses carry the OBI be, one TLM byte enable per byte
+        uint32_t be = ext_systemc_req_be_i.read();
+        if (be != 0xF) {
+          for (int i = 0; i < 4; i++)
+            t->byte_enable[i] = (be & (1 << i)) ? TLM_BYTE_ENABLED : TLM_BYTE_DISABLED;
+          t->trans.set_byte_enable_ptr( t->byte_enable );
+          t->trans.set_byte_enable_length( 4 );
+        } else
+          t->trans.set_byte_enable_ptr( 0 );
+        t->trans.set_dmi_allowed( false );
+        t->trans.set_response_status( tlm::TLM_INCOMPLETE_RESPONSE );
+        outstanding.push_back(t);
+
+        tlm::tlm_phase phase = tlm::BEGIN_REQ;
+        sc_time delay = SC_ZERO_TIME;
+        tlm::tlm_sync_enum status = socket->nb_transport_fw( t->trans, phase, delay );
+        if (status == tlm::TLM_COMPLETED || (status == tlm::TLM_UPDATED && phase == tlm::BEGIN_RESP))
+          t->resp_valid = true;
+      }
+      ext_systemc_resp_gnt_o.write(outstanding.size() < max_outstanding);
       wait();
     }
   }
 
-  void give_rvalid_rdata_back () {
+  void obi_response () {
+    ext_systemc_resp_rvalid_o.write(false);
+    wait();
     while (true) {
-      ext_systemc_resp_rvalid_o.write(false);
-      wait(obi_new_rvalid);
-      ext_systemc_resp_rvalid_o.write(true);
-      ext_systemc_resp_rdata_o.write(memory_request->rwdata_io);
+      if (!outstanding.empty() && outstanding.front()->resp_valid) {
+        obi_transaction_t* t = outstanding.front();
+        outstanding.pop_front();
+
+        if ( t->trans.is_response_error() )
+          SC_REPORT_ERROR("TLM-2", "Response error from nb_transport");
+
+        ext_systemc_resp_rvalid_o.write(true);
+        ext_systemc_resp_rdata_o.write(t->data);
+
+        tlm::tlm_phase phase = tlm::END_RESP;
+        sc_time delay = SC_ZERO_TIME;
+        socket->nb_transport_fw( t->trans, phase, delay );
+        free_transactions.push_back(t);
+      } else {
+        ext_systemc_resp_rvalid_o.write(false);
+      }
       wait();
     }
   }
 
+  // TLM-2 non-blocking backward transport method
+  virtual tlm::tlm_sync_enum nb_transport_bw( tlm::tlm_generic_payload& trans, tlm::tlm_phase& phase, sc_time& delay )
+  {
+    if (phase != tlm::BEGIN_RESP) {
+      SC_REPORT_ERROR("TLM-2", "Illegal transaction phase received by the OBI bridge");
+    }
+    for (obi_transaction_t* t : outstanding) {
+      if (&t->trans == &trans) t->resp_valid = true;
+    }
+    return tlm::TLM_ACCEPTED;
+  }
+
   SC_CTOR(external_memory)
+  : socket("socket")
   {
     // Instantiate components
     memory_request = new MemoryRequest("memory_request");
     memory         = new MainMemory   ("main_memory");
 
-    SC_METHOD(notify_obi_transaction);
-    sensitive << ext_systemc_req_req_i;
+    socket.register_nb_transport_bw(this, &external_memory::nb_transport_bw);
 
-    SC_CTHREAD(give_gnt_back, clk_i.pos());
-    SC_CTHREAD(give_rvalid_rdata_back, clk_i.pos());
+    SC_CTHREAD(obi_request, clk_i.pos());
+    SC_CTHREAD(obi_response, clk_i.pos());
 
-    // Bind memory_request socket to target socket
+    // Bind the bridge to the memory_request and memory_request to the memory
+    socket.bind( memory_request->target_socket );
     memory_request->socket.bind( memory->socket );
   }
 };
 
 
+// Set when the simulation is interrupted, so that watch_exit stops it and the
+// waves are closed by sc_main (nothing else is async-signal-safe in a handler)
+volatile sig_atomic_t abort_requested = 0;
+
+void request_abort(int sig)
+{
+  abort_requested = 1;
+  // A second signal terminates right away
+  signal(sig, SIG_DFL);
+}
+
 SC_MODULE(testbench)
 {
 
   sc_in<bool> clk_i;
+  sc_in<bool> exit_valid_i;
   sc_out<bool> clk_o;
   sc_out<bool> rst_no;
   sc_out<bool> boot_select_o;
@@ -141,7 +225,20 @@ SC_MODULE(testbench)
       std::cerr << "[TESTBENCH]: ERROR: Firmware file " << firmware << " does not exist." << std::endl;
       exit(EXIT_FAILURE);
     }
-    dut->tb_loadHEX(firmware->c_str());
+    // Write only the words populated by the firmware to the memory banks
+    XHEEP_FirmwareLoader loader;
+    if(!loader.load(*firmware)) {
+      exit(EXIT_FAILURE);
+    }
+    for(const auto& word : loader.get_words()) {
+      dut->tb_writeWord(word.first, word.second);
+    }
+  }
+
+  // Stops the simulation when the firmware exits, on $finish or when it is
+  // interrupted, so that sc_main can run it with a single sc_start()
+  void watch_exit () {
+    if (exit_valid_i.read() || Verilated::gotFinish() || abort_requested) sc_stop();
   }
 
   void set_exit_loop () {
@@ -179,12 +276,79 @@ SC_MODULE(testbench)
     SC_CTHREAD(make_clock, clk_i.pos());
     SC_CTHREAD(make_stimuli, clk_i.pos());
 
+    SC_METHOD(watch_exit);
+    sensitive << exit_valid_i << clk_i.pos();
+    dont_initialize();
+
   }
 
 
 
 };
 
+// Geometry and policies of the cache of the external memory model, from the plusargs
+// +cache_size=<bytes> +cache_line=<bytes> +cache_ways=<n> +cache_policy=lru|plru|random
+// +cache_write_back=0|1 +cache_write_allocate=0|1
+CacheMemory::cache_config_t get_cache_config(XHEEP_CmdLineOptions* cmd_lines_options, int argc, char* argv[])
+{
+  CacheMemory::cache_config_t config;
+  std::string arg;
+
+  arg = cmd_lines_options->getCmdOption(argc, argv, "+cache_size=");
+  if(!arg.empty()) config.cache_size_byte = std::stoul(arg);
+  arg = cmd_lines_options->getCmdOption(argc, argv, "+cache_line=");
+  if(!arg.empty()) config.block_size_byte = std::stoul(arg);
+  arg = cmd_lines_options->getCmdOption(argc, argv, "+cache_ways=");
+  if(!arg.empty()) config.ways = std::stoul(arg);
+  arg = cmd_lines_options->getCmdOption(argc, argv, "+cache_policy=");
+  if(arg == "plru") config.policy = CacheMemory::PLRU;
+  else if(arg == "random") config.policy = CacheMemory::RANDOM;
+  else if(!arg.empty() && arg != "lru") {
+    std::cout<<"[TESTBENCH]: ERROR: unknown cache policy "<<arg<<", use lru, plru or random"<<std::endl;
+    exit(EXIT_FAILURE);
+  }
+  arg = cmd_lines_options->getCmdOption(argc, argv, "+cache_write_back=");
+  if(!arg.empty()) config.write_back = arg != "0";
+  arg = cmd_lines_options->getCmdOption(argc, argv, "+cache_write_allocate=");
+  if(!arg.empty()) config.write_allocate = arg != "0";
+
+  std::cout<<"[TESTBENCH]: External memory cache of "<<config.cache_size_byte<<" B, "<<config.ways<<" way(s), "
+           <<config.block_size_byte<<" B lines, "<<(config.write_back ? "write-back" : "write-through")
+           <<(config.write_allocate ? ", write-allocate" : ", no write-allocate")<<std::endl;
+
+  return config;
+}
+
+// Outstanding requests of the OBI bridge and timing of the address regions of the external
+// memory, from the plusargs +ext_mem_outstanding=<n> and
+// +ext_mem_regions=<start>-<end>:<latency_ns>:<interval_ns>[,<start>-<end>:...]
+void configure_ext_mem(external_memory* ext_mem, XHEEP_CmdLineOptions* cmd_lines_options, int argc, char* argv[])
+{
+  std::string arg;
+
+  arg = cmd_lines_options->getCmdOption(argc, argv, "+ext_mem_outstanding=");
+  if(!arg.empty()) ext_mem->max_outstanding = std::stoul(arg);
+  if(ext_mem->max_outstanding == 0) {
+    std::cout<<"[TESTBENCH]: ERROR: at least one outstanding request is needed"<<std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  std::stringstream regions(cmd_lines_options->getCmdOption(argc, argv, "+ext_mem_regions="));
+  std::string region;
+  while(std::getline(regions, region, ',')) {
+    long start, end, latency, interval;
+    if(sscanf(region.c_str(), "%li-%li:%li:%li", &start, &end, &latency, &interval) != 4 ||
+       start < 0 || end < start || latency < 0 || interval < 0) {
+      std::cout<<"[TESTBENCH]: ERROR: wrong external memory region "<<region<<", use <start>-<end>:<latency_ns>:<interval_ns>"<<std::endl;
+      exit(EXIT_FAILURE);
+    }
+    ext_mem->memory_request->add_region(start, end, sc_time(latency, SC_NS), sc_time(interval, SC_NS));
+  }
+
+  std::cout<<"[TESTBENCH]: External memory with up to "<<ext_mem->max_outstanding<<" outstanding request(s), "
+           <<ext_mem->memory_request->regions.size()<<" timing region(s)"<<std::endl;
+}
+
 int sc_main (int argc, char * argv[])
 {
 
@@ -192,6 +356,7 @@ int sc_main (int argc, char * argv[])
   unsigned long long max_sim_time;
   unsigned int boot_sel, exit_val;
   bool use_openocd;
+  bool trace;
   bool run_all = false;
   Verilated::commandArgs(argc, argv);
   Verilated::traceEverOn(true);
@@ -210,6 +375,8 @@ int sc_main (int argc, char * argv[])
 
   boot_sel     = cmd_lines_options->get_boot_sel();
 
+  trace        = cmd_lines_options->get_trace();
+
   if(use_openocd) {
     std::cout<<"[TESTBENCH]: ERROR: Executing from OpenOCD in SystemC is not supported (yet) in X-HEEP"<<std::endl;
     std::cout<<"exit simulation..."<<std::endl;
@@ -229,6 +396,27 @@ int sc_main (int argc, char * argv[])
   testbench tb("testbench");
   external_memory ext_mem("external_memory");
 
+  if(!ext_mem.memory_request->configure_cache(get_cache_config(cmd_lines_options, argc, argv))) {
+    exit(EXIT_FAILURE);
+  }
+  configure_ext_mem(&ext_mem, cmd_lines_options, argc, argv);
+
+  // Initial content of the external memory, ELF or Verilog hex at the bus addresses
+  std::string ext_mem_load = cmd_lines_options->getCmdOption(argc, argv, "+ext_mem_load=");
+  if(!ext_mem_load.empty()) {
+    XHEEP_FirmwareLoader loader;
+    if(!loader.load(ext_mem_load)) exit(EXIT_FAILURE);
+    ext_mem.memory->load(loader.get_words());
+    std::cout<<"[TESTBENCH]: Loaded "<<loader.get_words().size()<<" words of "<<ext_mem_load<<" in the external memory"<<std::endl;
+  }
+
+  // Binary trace of the external memory requests, decoded with util/decode_mem_trace.py
+  std::string mem_trace = cmd_lines_options->getCmdOption(argc, argv, "+mem_trace=");
+  if(!mem_trace.empty()) {
+    if(!ext_mem.memory_request->open_trace(mem_trace)) exit(EXIT_FAILURE);
+    std::cout<<"[TESTBENCH]: Tracing the external memory requests to "<<mem_trace<<std::endl;
+  }
+
   svSetScope(svGetScopeFromName("TOP.testharness"));
   svScope scope = svGetScope();
   if (!scope) {
@@ -236,6 +424,11 @@ int sc_main (int argc, char * argv[])
     exit(EXIT_FAILURE);
   }
 
+  // The configuration register of the cache is at a fixed offset of the external slave window
+  int ext_slave_start;
+  dut.tb_getExtSlaveStart(&ext_slave_start);
+  ext_mem.memory_request->ext_window_start = (uint32_t)ext_slave_start;
+
 
   // static values
   tb.boot_select_option = boot_sel == 1;
@@ -265,6 +458,7 @@ int sc_main (int argc, char * argv[])
 
 
   tb.clk_i(clock_sig);
+  tb.exit_valid_i(exit_valid);
   tb.clk_o(clk);
   tb.rst_no(rst_n);
   tb.boot_select_o(boot_select);
@@ -315,24 +509,50 @@ int sc_main (int argc, char * argv[])
 
 
   VerilatedFstSc* tfp = nullptr;
-  tfp = new VerilatedFstSc;
-  dut.trace(tfp, 99);  // Trace 99 levels of hierarchy
-  tfp->open("waveform.fst");
-
-  // Simulate until $finish
-  while (!Verilated::gotFinish() && exit_valid !=1 ) {
-      // Flush the wave files each cycle so we can immediately see the output
-      // Don't do this in "real" programs, do it in an abort() handler instead
-      if (tfp) tfp->flush();
-      // Simulate 1ns
-      sc_start(1, SC_NS);
+  if(trace) {
+    tfp = new VerilatedFstSc;
+    dut.trace(tfp, cmd_lines_options->get_trace_depth());
+    tfp->open("waveform.fst");
   }
 
+  // An interrupted simulation stops like a finished one, so that the waves are closed
+  signal(SIGINT, request_abort);
+  signal(SIGTERM, request_abort);
+
+  // Event driven run until $finish or exit_valid (watch_exit) or the max sim time
+  if(run_all)
+    sc_start();
+  else if(sc_time(max_sim_time, SC_PS) > sc_time_stamp())
+    sc_start(sc_time(max_sim_time, SC_PS) - sc_time_stamp());
+
+  std::cout<<"[TESTBENCH]: Simulation "<<(abort_requested ? "interrupted" : "stopped")<<" at "<<sc_time_stamp()<<std::endl;
+
   if(exit_valid == 1) {
     std::cout<<"Program Finished with value "<< exit_value <<std::endl;
     exit_val = EXIT_SUCCESS;
   } else exit_val = EXIT_FAILURE;
 
+  // Cache statistics of the run, to compare cache configurations
+  std::ofstream cache_stats_file("cache_stats.json");
+  ext_mem.memory_request->cache->print_statistics(cache_stats_file);
+  ext_mem.memory_request->cache->print_statistics(std::cout);
+
+  // The cache is flushed so that the saved memory holds the data written by the firmware
+  std::string ext_mem_save = cmd_lines_options->getCmdOption(argc, argv, "+ext_mem_save=");
+  if(!ext_mem_save.empty()) {
+    ext_mem.memory_request->flush_cache();
+    if(ext_mem.memory->save(ext_mem_save))
+      std::cout<<"[TESTBENCH]: External memory saved to "<<ext_mem_save<<" ("<<ext_mem.memory->pages.size()<<" pages)"<<std::endl;
+    else
+      std::cout<<"[TESTBENCH]: ERROR: cannot save the external memory to "<<ext_mem_save<<std::endl;
+  }
+
+  if(ext_mem.memory_request->trace.enabled()) {
+    ext_mem.memory_request->trace.close();
+    // Final content of the cache, the trace gives its evolution
+    ext_mem.memory_request->cache->print_cache_status(ext_mem.memory_request->number_of_transactions, sc_time_stamp().to_string());
+  }
+
   // Final model cleanup
   dut.final();
 
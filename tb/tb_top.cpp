@@ -4,51 +4,305 @@
 
 #include "verilated.h"
 #include "verilated_fst_c.h"
+#include "verilated_save.h"
 #include "Vtestharness.h"
 #include "Vtestharness__Syms.h"
 
 #include <stdlib.h>
 #include <iostream>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <climits>
 
 #include "XHEEP_CmdLineOptions.hh"
+#include "XHEEP_FirmwareLoader.hh"
+#include "XHEEP_Profiler.hh"
 
 vluint64_t sim_time = 0;
+// Tracing window in ps, trace_stop_time == 0 means until the end of the simulation
+vluint64_t trace_start_time = 0;
+vluint64_t trace_stop_time  = 0;
+// Clock cycles jumped over while the CPU was sleeping (+idle_skip)
+vluint64_t idle_skipped_cycles = 0;
+
+static inline void dumpTrace(VerilatedFstC *m_trace){
+  if(m_trace == nullptr) return;
+  if(sim_time < trace_start_time) return;
+  if(trace_stop_time != 0 && sim_time >= trace_stop_time) return;
+  m_trace->dump(sim_time);
+}
 
 void runCycles(unsigned int ncycles, Vtestharness *dut, VerilatedFstC *m_trace){
   for(unsigned int i = 0; i < 2*ncycles; i++) {
     sim_time += CLK_PERIOD_ps/2;
     dut->clk_i ^= 1;
     dut->eval();
-    m_trace->dump(sim_time);
+    dumpTrace(m_trace);
+  }
+}
+
+// Jumps over the clock cycles the CPU spends sleeping in WFI until the next timer interrupt,
+// only the timers are advanced. max_cycles bounds the jump, e.g. to the end of the simulation.
+void skipIdleCycles(long long max_cycles, Vtestharness *dut){
+  long long cycles;
+
+  dut->tb_getIdleCycles(max_cycles, &cycles);
+  if(cycles <= 0) return;
+
+  dut->tb_skipCycles(cycles);
+  sim_time += cycles * CLK_PERIOD_ps;
+  idle_skipped_cycles += cycles;
+}
+
+void resetDUT(unsigned int boot_sel, Vtestharness *dut, VerilatedFstC *m_trace){
+  dut->rst_ni               = 1;
+  dut->boot_select_i        = boot_sel;
+
+  //this creates the negedge
+  runCycles(20, dut, m_trace);
+  dut->rst_ni               = 0;
+  runCycles(40, dut, m_trace);
+
+  dut->rst_ni = 1;
+  runCycles(40, dut, m_trace);
+  std::cout<<"Reset Released"<< std::endl;
+}
+
+// Writes only the words populated by the firmware (ELF or Verilog hex) to the memory banks
+void loadMemory(const std::string& firmware, Vtestharness *dut){
+  XHEEP_FirmwareLoader loader;
+
+  if(!loader.load(firmware)) {
+    exit(EXIT_FAILURE);
   }
+  for(const auto& word : loader.get_words()) {
+    dut->tb_writeWord(word.first, word.second);
+  }
+  std::cout<<"Loaded "<<loader.get_size_bytes()<<" bytes of "<<firmware<<std::endl;
+}
+
+void loadFirmware(const std::string& firmware, unsigned int boot_sel, bool use_openocd, Vtestharness *dut, VerilatedFstC *m_trace){
+  if(!XHEEP_FirmwareLoader::is_elf(firmware)) {
+    dut->load_flash_hex(firmware.c_str());
+  } else if(boot_sel == 1) {
+    std::cout<<"[TESTBENCH]: ERROR: Booting from flash requires a hex firmware"<<std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  if(boot_sel != 1) {
+    //Booting from JTAG or loading the memory from the testbench
+    if(use_openocd==false) {
+      loadMemory(firmware, dut);
+      runCycles(1, dut, m_trace);
+      //you need to exit from the bootrom loop if not using OpenOCD
+      dut->tb_set_exit_loop();
+      std::cout<<"Set Exit Loop"<< std::endl;
+      runCycles(1, dut, m_trace);
+      std::cout<<"Memory Loaded"<< std::endl;
+    } else {
+      std::cout<<"Waiting for GDB"<< std::endl;
+    }
+  } else {
+      std::cout<<"X-HEEP is loading from FLASH..."<< std::endl;
+  }
+}
+
+// Runs every firmware of the batch manifest in the same model, resetting the DUT in between.
+// Each manifest line is "<firmware.hex> [<max_sim_time>]", empty lines and lines starting with '#' are skipped.
+// A result line "[BATCH] {...}" is printed for each firmware.
+// Returns EXIT_SUCCESS if all the programs finished with value 0.
+unsigned int runBatch(const std::string& batch, unsigned int boot_sel, vluint64_t max_sim_time, bool run_all,
+                      XHEEP_CmdLineOptions *cmd_lines_options, Vtestharness *dut, VerilatedFstC *m_trace){
+  std::ifstream manifest(batch);
+  std::string line;
+  unsigned int exit_val = EXIT_SUCCESS;
+
+  if(!manifest.is_open()) {
+    std::cout<<"[TESTBENCH]: ERROR: Cannot open batch manifest "<<batch<<std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  while(std::getline(manifest, line)) {
+    std::istringstream fields(line);
+    std::string firmware, timeout;
+    bool test_run_all = run_all;
+    vluint64_t test_max_sim_time = max_sim_time;
+
+    if(!(fields >> firmware) || firmware[0] == '#') continue;
+    if(fields >> timeout) {
+      test_max_sim_time = cmd_lines_options->parse_sim_time(timeout, "the batch timeout");
+      test_run_all = false;
+    }
+
+    std::cout<<"[TESTBENCH]: Batch running "<<firmware<<std::endl;
+    resetDUT(boot_sel, dut, m_trace);
+    loadFirmware(firmware, boot_sel, false, dut, m_trace);
+
+    vluint64_t test_start_time = sim_time;
+    while(dut->exit_valid_o!=1 && (test_run_all || sim_time - test_start_time < test_max_sim_time)) {
+      runCycles(100, dut, m_trace);
+    }
+
+    bool finished = dut->exit_valid_o==1;
+    std::cout<<"[BATCH] {\"firmware\": \""<<firmware<<"\", \"status\": \""<<(finished ? "finished" : "timeout")
+             <<"\", \"exit_value\": "<<(finished ? (long long)dut->exit_value_o : -1)
+             <<", \"cycles\": "<<((sim_time - test_start_time)/CLK_PERIOD_ps)<<"}"<<std::endl;
+
+    if(!finished || dut->exit_value_o != 0) exit_val = EXIT_FAILURE;
+  }
+
+  return exit_val;
+}
+
+// The checkpoint holds the testbench time and the whole Vtestharness state (--savable).
+// It can only be restored by the very same simulator binary that saved it.
+void saveCheckpoint(const std::string& file, Vtestharness *dut){
+  VerilatedSave os;
+  os.open(file.c_str());
+  if(!os.isOpen()) {
+    std::cout<<"[TESTBENCH]: ERROR: Cannot open checkpoint "<<file<<std::endl;
+    exit(EXIT_FAILURE);
+  }
+  os << sim_time;
+  os << *dut;
+  os.close();
+  std::cout<<"Checkpoint "<<file<<" saved at "<<(sim_time/CLK_PERIOD_ps)<<" clock cycles"<<std::endl;
+}
+
+void restoreCheckpoint(const std::string& file, Vtestharness *dut){
+  VerilatedRestore os;
+  os.open(file.c_str());
+  if(!os.isOpen()) {
+    std::cout<<"[TESTBENCH]: ERROR: Cannot open checkpoint "<<file<<std::endl;
+    exit(EXIT_FAILURE);
+  }
+  dut->tb_close_dpi();
+  os >> sim_time;
+  os >> *dut;
+  os.close();
+  // DPI handles saved in the checkpoint belong to the process that wrote it
+  dut->tb_reopen_dpi();
+  std::cout<<"Checkpoint "<<file<<" restored at "<<(sim_time/CLK_PERIOD_ps)<<" clock cycles"<<std::endl;
+}
+
+// Counter groups of tb_getStat, must match the TB_STATS_* parameters of tb_util.svh
+enum {
+  TB_STATS_CYCLES = 0,
+  TB_STATS_CORE,
+  TB_STATS_XBAR_GNT,
+  TB_STATS_XBAR_WAIT,
+  TB_STATS_RAM_BANK,
+  TB_STATS_DMA_BYTES
+};
+
+static long long getStat(int group, int idx, Vtestharness *dut){
+  long long value;
+  dut->tb_getStat(group, idx, &value);
+  return value;
+}
+
+static int getStatCount(int group, Vtestharness *dut){
+  int count;
+  dut->tb_getStatCount(group, &count);
+  return count;
+}
+
+// Names of the system xbar masters, in the order of core_v_mini_mcu_pkg (*_IDX)
+static std::string xbarMasterName(int idx){
+  static const char *core_masters[] = {"core_instr", "core_data", "debug"};
+  static const char *dma_masters[]  = {"dma_read", "dma_write", "dma_addr"};
+
+  if(idx < 3) return core_masters[idx];
+  return std::string(dma_masters[(idx - 3) % 3]) + "_p" + std::to_string((idx - 3) / 3);
+}
+
+static void writeStatArray(std::ofstream& f, int group, Vtestharness *dut){
+  int count = getStatCount(group, dut);
+
+  f<<"[";
+  for(int i = 0; i < count; i++) f<<(i ? ", " : "")<<getStat(group, i, dut);
+  f<<"]";
+}
+
+// Dumps the performance counters collected by the testbench monitors of tb_util.svh as JSON
+void writeStats(const std::string& file, Vtestharness *dut){
+  std::ofstream f(file);
+
+  if(!f.is_open()) {
+    std::cout<<"[TESTBENCH]: ERROR: Cannot write the performance counters to "<<file<<std::endl;
+    return;
+  }
+
+  f<<"{\n";
+  f<<"  \"cycles\": "<<getStat(TB_STATS_CYCLES, 0, dut) + idle_skipped_cycles<<",\n";
+  f<<"  \"sleep_cycles\": "<<getStat(TB_STATS_CYCLES, 1, dut) + idle_skipped_cycles<<",\n";
+  f<<"  \"idle_skipped_cycles\": "<<idle_skipped_cycles<<",\n";
+  // The core is not visible from the testbench with hierarchical verilation
+  if(getStatCount(TB_STATS_CORE, dut) != 0) {
+    f<<"  \"instructions_retired\": "<<getStat(TB_STATS_CORE, 0, dut)<<",\n";
+    f<<"  \"stall_cycles\": "<<getStat(TB_STATS_CORE, 1, dut)<<",\n";
+  } else {
+    f<<"  \"instructions_retired\": null,\n";
+    f<<"  \"stall_cycles\": null,\n";
+  }
+  f<<"  \"system_xbar\": {";
+  for(int i = 0; i < getStatCount(TB_STATS_XBAR_GNT, dut); i++) {
+    f<<(i ? "," : "")<<"\n    \""<<xbarMasterName(i)<<"\": {\"grants\": "<<getStat(TB_STATS_XBAR_GNT, i, dut)
+     <<", \"wait_cycles\": "<<getStat(TB_STATS_XBAR_WAIT, i, dut)<<"}";
+  }
+  f<<"\n  },\n";
+  f<<"  \"ram_bank_accesses\": ";
+  writeStatArray(f, TB_STATS_RAM_BANK, dut);
+  f<<",\n";
+  f<<"  \"dma_bytes\": ";
+  writeStatArray(f, TB_STATS_DMA_BYTES, dut);
+  f<<"\n}\n";
+
+  std::cout<<"[TESTBENCH]: Performance counters written to "<<file<<std::endl;
 }
 
 int main (int argc, char * argv[])
 {
 
   std::string firmware;
-  vluint64_t max_sim_time;
+  std::string save_checkpoint, restore_checkpoint, batch;
+  std::string profile, profile_out, stats;
+  vluint64_t max_sim_time, save_checkpoint_time;
   unsigned int boot_sel, exit_val;
   bool use_openocd;
   bool run_all = false;
+  bool trace, bench, idle_skip;
 
   Verilated::commandArgs(argc, argv);
 
+  XHEEP_CmdLineOptions* cmd_lines_options = new XHEEP_CmdLineOptions(argc,argv);
+
+  trace = cmd_lines_options->get_trace();
+
+  // Tracing must be enabled before the model is built
+  if(trace) Verilated::traceEverOn (true);
+
   // Instantiate the model
   Vtestharness *dut = new Vtestharness;
 
-  // Open VCD
-  Verilated::traceEverOn (true);
-  VerilatedFstC *m_trace = new VerilatedFstC;
-  dut->trace (m_trace, 99);
-  m_trace->open ("waveform.fst");
-
-  XHEEP_CmdLineOptions* cmd_lines_options = new XHEEP_CmdLineOptions(argc,argv);
+  // Open FST, the file is written by the Verilator writer thread (--trace-threads)
+  VerilatedFstC *m_trace = nullptr;
+  if(trace) {
+    trace_start_time = cmd_lines_options->get_trace_start();
+    trace_stop_time  = cmd_lines_options->get_trace_stop();
+    m_trace = new VerilatedFstC;
+    dut->trace (m_trace, cmd_lines_options->get_trace_depth());
+    m_trace->open ("waveform.fst");
+  }
 
   use_openocd = cmd_lines_options->get_use_openocd();
   firmware = cmd_lines_options->get_firmware();
+  restore_checkpoint   = cmd_lines_options->get_restore_checkpoint();
+  save_checkpoint_time = cmd_lines_options->get_save_checkpoint(save_checkpoint);
+  batch                = cmd_lines_options->get_batch();
 
-  if(firmware.empty() && use_openocd==false){
+  if(firmware.empty() && use_openocd==false && restore_checkpoint.empty() && batch.empty()){
       std::cout<<"You must specify the firmware if you are not using OpenOCD"<<std::endl;
       exit(EXIT_FAILURE);
   }
@@ -57,6 +311,19 @@ int main (int argc, char * argv[])
 
   boot_sel     = cmd_lines_options->get_boot_sel();
 
+  bench        = cmd_lines_options->get_bench();
+
+  profile      = cmd_lines_options->get_profile(profile_out);
+
+  stats        = cmd_lines_options->get_stats();
+
+  idle_skip    = cmd_lines_options->get_idle_skip();
+
+  if(!profile.empty()) {
+    xheep_profiler = new XHEEP_Profiler;
+    if(!xheep_profiler->load_symbols(profile)) exit(EXIT_FAILURE);
+  }
+
   svSetScope(svGetScopeFromName("TOP.testharness"));
   svScope scope = svGetScope();
   if (!scope) {
@@ -73,52 +340,79 @@ int main (int argc, char * argv[])
   dut->execute_from_flash_i = 0;
 
   dut->eval();
-  m_trace->dump(sim_time);
+  dumpTrace(m_trace);
 
-  dut->rst_ni               = 1;
-  dut->boot_select_i        = boot_sel;
+  if(!batch.empty()) {
+    exit_val = runBatch(batch, boot_sel, max_sim_time, run_all, cmd_lines_options, dut, m_trace);
+    std::cout<<"Batch finished after "<<(sim_time/CLK_PERIOD_ps)<<" clock cycles"<<std::endl;
+    if(m_trace) {
+      m_trace->close();
+      delete m_trace;
+    }
+    delete dut;
+    delete cmd_lines_options;
+    exit(exit_val);
+  }
 
-  //this creates the negedge
-  runCycles(20, dut, m_trace);
-  dut->rst_ni               = 0;
-  runCycles(40, dut, m_trace);
+  if(!restore_checkpoint.empty()) {
+    // Reset, boot and memory load are part of the checkpoint
+    restoreCheckpoint(restore_checkpoint, dut);
+  } else {
+    resetDUT(boot_sel, dut, m_trace);
+    loadFirmware(firmware, boot_sel, use_openocd, dut, m_trace);
+  }
 
-  dut->rst_ni = 1;
-  runCycles(40, dut, m_trace);
-  std::cout<<"Reset Released"<< std::endl;
 
-  dut->load_flash_hex(firmware.c_str());
+  // Benchmark mode measures the application run, after reset and memory load
+  auto wall_clock_start = std::chrono::steady_clock::now();
+  vluint64_t sim_time_start = sim_time;
 
-  if(boot_sel != 1) {
-    //Booting from JTAG or loading the memory from the testbench
-    if(use_openocd==false) {
-      dut->tb_loadHEX(firmware.c_str());
-      runCycles(1, dut, m_trace);
-      //you need to exit from the bootrom loop if not using OpenOCD
-      dut->tb_set_exit_loop();
-      std::cout<<"Set Exit Loop"<< std::endl;
-      runCycles(1, dut, m_trace);
-      std::cout<<"Memory Loaded"<< std::endl;
-    } else {
-      std::cout<<"Waiting for GDB"<< std::endl;
+  if(!save_checkpoint.empty()) {
+    // Run up to the checkpoint cycle, or save right away if it is already past (e.g. @0 for a post-boot snapshot)
+    while(dut->exit_valid_o!=1 && sim_time<save_checkpoint_time && (run_all || sim_time<max_sim_time)) {
+      vluint64_t ncycles = (save_checkpoint_time - sim_time + CLK_PERIOD_ps - 1) / CLK_PERIOD_ps;
+      runCycles(ncycles < 100 ? ncycles : 100, dut, m_trace);
     }
-  } else {
-      std::cout<<"X-HEEP is loading from FLASH..."<< std::endl;
+    saveCheckpoint(save_checkpoint, dut);
   }
 
-
   if(run_all==false) {
     while(dut->exit_valid_o!=1 && sim_time<max_sim_time) {
       runCycles(100, dut, m_trace);
+      if(idle_skip && sim_time<max_sim_time) skipIdleCycles((max_sim_time - sim_time) / CLK_PERIOD_ps, dut);
     }
   } else {
     while(dut->exit_valid_o!=1) {
       runCycles(100, dut, m_trace);
+      if(idle_skip) skipIdleCycles(LLONG_MAX, dut);
     }
   }
 
   std::cout<<"Simulation finished after "<<(sim_time/CLK_PERIOD_ps)<<" clock cycles"<<std::endl;
 
+  if(idle_skip) {
+    std::cout<<"Skipped "<<idle_skipped_cycles<<" idle clock cycles"<<std::endl;
+  }
+
+  if(bench) {
+    std::chrono::duration<double> wall_clock = std::chrono::steady_clock::now() - wall_clock_start;
+    double sim_cycles = (double)(sim_time - sim_time_start) / CLK_PERIOD_ps;
+    std::cout<<"Simulation speed: "<<(unsigned long long)(sim_cycles / wall_clock.count())<<" clock cycles/s ("
+             <<wall_clock.count()<<" s wall clock)"<<std::endl;
+  }
+
+  writeStats(stats, dut);
+
+  if(xheep_profiler) {
+    if(xheep_profiler->get_cycles() == 0) {
+      std::cout<<"[TESTBENCH]: WARNING: no profile samples, the model was built without the profiler (hierarchical verilation)"<<std::endl;
+    } else {
+      xheep_profiler->write_folded(profile_out);
+    }
+    delete xheep_profiler;
+    xheep_profiler = nullptr;
+  }
+
   // This should be the last message printed  so that the scripts like test-all can catch the exit value properly. 
   // The return value should be the last character (in case it is 0)
   if(dut->exit_valid_o==1) { 
@@ -129,7 +423,10 @@ int main (int argc, char * argv[])
     exit_val = 2; // exit 2 to indicate successful run but premature termination
   }
 
-  m_trace->close();
+  if(m_trace) {
+    m_trace->close();
+    delete m_trace;
+  }
   delete dut;
   delete cmd_lines_options;
 
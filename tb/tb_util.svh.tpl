@@ -4,6 +4,39 @@
 
 <%
     memory_ss = xheep.memory_ss()
+    base_peripheral_domain = xheep.get_base_peripheral_domain()
+    dma_included = base_peripheral_domain.contains_peripheral('dma') and base_peripheral_domain.get_dma().get_is_included()
+    user_peripheral_domain = xheep.get_user_peripheral_domain()
+    mcu = "x_heep_system_i.core_v_mini_mcu_i"
+    # RISC-V timers advanced by the idle skipping of tb_top.cpp
+    rv_timers = [mcu + ".ao_peripheral_subsystem_i.rv_timer_0_1_i"]
+    if user_peripheral_domain.contains_peripheral('rv_timer'):
+        rv_timers.append(mcu + ".peripheral_subsystem_i.rv_timer_2_3_i")
+    # SPI chip selects, all high when no transaction is ongoing
+    spi_csb = []
+    if base_peripheral_domain.contains_peripheral('spi_flash'):
+        spi_csb.append(mcu + ".ao_peripheral_subsystem_i.spi_flash_csb_o")
+    if user_peripheral_domain.contains_peripheral('spi_host'):
+        spi_csb.append(mcu + ".peripheral_subsystem_i.spi_csb_o")
+    if user_peripheral_domain.contains_peripheral('spi2'):
+        spi_csb.append(mcu + ".peripheral_subsystem_i.spi2_csb_o")
+    cpu_subsystem = "x_heep_system_i.core_v_mini_mcu_i.cpu_subsystem_i"
+    # Instruction in the ID stage (valid, pc, instr) sampled by the Verilator profiler
+    profile_signals = {
+        "cv32e20": ("gen_cv32e20.cv32e20_i.u_cve2_top.u_cve2_core.if_stage_i", "instr_valid_id_o", "pc_id_o", "instr_rdata_id_o"),
+        "cv32e40p": ("gen_cv32e40p.cv32e40p_top_i.core_i.if_stage_i", "instr_valid_id_o", "pc_id_o", "instr_rdata_id_o"),
+        "cv32e40px": ("gen_cv32e40px.cv32e40px_top_i.core_i.if_stage_i", "instr_valid_id_o", "pc_id_o", "instr_rdata_id_o"),
+        "cv32e40x": ("gen_cv32e40x.cv32e40x_core_i.id_stage_i", "instr_valid", "if_id_pipe_i.pc", "instr"),
+    }
+    profile_stage, profile_valid, profile_pc, profile_instr = profile_signals[xheep.cpu().get_name()]
+    # Retired instruction event of the performance counters (minstret)
+    instret_signals = {
+        "cv32e20": "gen_cv32e20.cv32e20_i.u_cve2_top.u_cve2_core.perf_instr_ret_wb",
+        "cv32e40p": "gen_cv32e40p.cv32e40p_top_i.core_i.mhpmevent_minstret",
+        "cv32e40px": "gen_cv32e40px.cv32e40px_top_i.core_i.mhpmevent_minstret",
+        "cv32e40x": "gen_cv32e40x.cv32e40x_core_i.ctrl_fsm.mhpmevent.minstret",
+    }
+    instret = instret_signals[xheep.cpu().get_name()]
 %>
 
 `ifndef SYNTHESIS
@@ -13,9 +46,22 @@ export "DPI-C" task tb_loadHEX;
 % for bank in memory_ss.iter_ram_banks():
 export "DPI-C" task tb_writetoSram${bank.name()};
 % endfor
+export "DPI-C" task tb_writeWord;
 export "DPI-C" task tb_getMemSize;
+export "DPI-C" task tb_getExtSlaveStart;
 export "DPI-C" task tb_set_exit_loop;
 export "DPI-C" task load_flash_hex;
+`ifdef VERILATOR
+export "DPI-C" task tb_close_dpi;
+export "DPI-C" task tb_reopen_dpi;
+export "DPI-C" task tb_getStatCount;
+export "DPI-C" task tb_getStat;
+export "DPI-C" task tb_getIdleCycles;
+export "DPI-C" task tb_skipCycles;
+
+import "DPI-C" function chandle uartdpi_create(input string name, input string log_file_path);
+import "DPI-C" function void uartdpi_close(input chandle ctx);
+`endif
 
 import core_v_mini_mcu_pkg::*;
 
@@ -24,6 +70,11 @@ task tb_getMemSize;
   mem_size  = core_v_mini_mcu_pkg::MEM_SIZE;
 endtask
 
+task tb_getExtSlaveStart;
+  output int start_address;
+  start_address = core_v_mini_mcu_pkg::EXT_SLAVE_START_ADDRESS;
+endtask
+
 task tb_readHEX;
   input string file;
   output logic [7:0] stimuli[core_v_mini_mcu_pkg::MEM_SIZE];
@@ -109,6 +160,19 @@ endtask
 
 % endfor
 
+// Backdoor write of one word at a byte address of the RAM, used by the C++
+// firmware loader of the Verilator testbenches to write only the populated words
+task tb_writeWord;
+  input int addr;
+  input logic [31:0] data;
+% for bank in memory_ss.iter_ram_banks():
+  if (addr >= ${bank.start_address()} && addr < ${bank.end_address()} && ((addr/4) & ${2**bank.il_level()-1}) == ${bank.il_offset()}) begin
+    tb_writetoSram${bank.name()}(((addr/4) >> ${bank.il_level()}) % ${bank.size()//4}, data[31:24], data[23:16],
+                                        data[15:8], data[7:0]);
+  end
+% endfor
+endtask
+
 task tb_set_exit_loop;
 `ifdef VCS
   force x_heep_system_i.core_v_mini_mcu_i.ao_peripheral_subsystem_i.soc_ctrl_i.testbench_set_exit_loop[0] = 1'b1;
@@ -117,6 +181,225 @@ task tb_set_exit_loop;
   x_heep_system_i.core_v_mini_mcu_i.ao_peripheral_subsystem_i.soc_ctrl_i.testbench_set_exit_loop[0] = 1'b1;
 `endif
 endtask
+
+`ifdef VERILATOR
+// Close the DPI contexts of this process before restoring a Verilator
+// checkpoint, which overwrites their chandles
+task tb_close_dpi;
+  uartdpi_close(i_uart0.ctx);
+endtask
+
+// Re-create the DPI contexts after restoring a Verilator checkpoint,
+// the restored chandles belong to the process that saved it
+task tb_reopen_dpi;
+  i_uart0.ctx = uartdpi_create("uart0", i_uart0.log_file_path);
+endtask
+
+`ifndef VERILATOR_HIERARCHICAL
+// Host-side profiler of tb_top.cpp (+profile=<elf>): the instruction in the ID stage
+// is sampled every clock cycle, so no waveform is needed to build the flamegraph.
+// Not available with hierarchical verilation, as the CPU core is a hierarchical block.
+import "DPI-C" function void tb_profile_sample(input bit valid, input int pc, input int instr);
+
+bit tb_profile_en;
+
+// $test$plusargs("profile") would also match +profile_out=<file>
+initial begin
+  string tb_profile_elf;
+  tb_profile_en = $value$plusargs("profile=%s", tb_profile_elf) != 0;
+end
+
+always_ff @(posedge clk_i) begin
+  if (tb_profile_en && rst_ni) begin
+    tb_profile_sample(${cpu_subsystem}.${profile_stage}.${profile_valid},
+                      ${cpu_subsystem}.${profile_stage}.${profile_pc},
+                      ${cpu_subsystem}.${profile_stage}.${profile_instr});
+  end
+end
+`endif
+
+// Performance counters of the simulation, read by tb_top.cpp at exit through
+// tb_getStat and written as JSON. They are cleared by the reset of the DUT.
+// The groups must match the TB_STATS_* enum of tb_top.cpp.
+localparam int TB_STATS_CYCLES = 0;  // cycles, sleep (WFI) cycles
+localparam int TB_STATS_CORE = 1;  // instructions retired, stall cycles
+localparam int TB_STATS_XBAR_GNT = 2;  // grants per system xbar master
+localparam int TB_STATS_XBAR_WAIT = 3;  // cycles a system xbar master waits for its grant
+localparam int TB_STATS_RAM_BANK = 4;  // accesses per memory bank
+localparam int TB_STATS_DMA_BYTES = 5;  // bytes written per DMA channel
+
+longint tb_stats_cycles, tb_stats_sleep_cycles;
+longint tb_stats_instret, tb_stats_stall_cycles;
+longint tb_stats_xbar_gnt[core_v_mini_mcu_pkg::SYSTEM_XBAR_NMASTER];
+longint tb_stats_xbar_wait[core_v_mini_mcu_pkg::SYSTEM_XBAR_NMASTER];
+longint tb_stats_ram_bank[core_v_mini_mcu_pkg::NUM_BANKS];
+longint tb_stats_dma_bytes[core_v_mini_mcu_pkg::DMA_CH_NUM];
+
+always_ff @(posedge clk_i or negedge rst_ni) begin
+  if (!rst_ni) begin
+    tb_stats_cycles <= '0;
+    tb_stats_sleep_cycles <= '0;
+    tb_stats_instret <= '0;
+    tb_stats_stall_cycles <= '0;
+    for (int i = 0; i < core_v_mini_mcu_pkg::SYSTEM_XBAR_NMASTER; i++) begin
+      tb_stats_xbar_gnt[i]  <= '0;
+      tb_stats_xbar_wait[i] <= '0;
+    end
+    for (int i = 0; i < core_v_mini_mcu_pkg::NUM_BANKS; i++) tb_stats_ram_bank[i] <= '0;
+    for (int i = 0; i < core_v_mini_mcu_pkg::DMA_CH_NUM; i++) tb_stats_dma_bytes[i] <= '0;
+  end else begin
+    tb_stats_cycles <= tb_stats_cycles + 1;
+    if (x_heep_system_i.core_v_mini_mcu_i.core_sleep) begin
+      tb_stats_sleep_cycles <= tb_stats_sleep_cycles + 1;
+`ifndef VERILATOR_HIERARCHICAL
+    end else if (${cpu_subsystem}.${instret}) begin
+      tb_stats_instret <= tb_stats_instret + 1;
+    end else begin
+      tb_stats_stall_cycles <= tb_stats_stall_cycles + 1;
+`endif
+    end
+    for (int i = 0; i < core_v_mini_mcu_pkg::SYSTEM_XBAR_NMASTER; i++) begin
+      if (x_heep_system_i.core_v_mini_mcu_i.system_bus_i.int_master_req[i].req) begin
+        if (x_heep_system_i.core_v_mini_mcu_i.system_bus_i.int_master_resp[i].gnt)
+          tb_stats_xbar_gnt[i] <= tb_stats_xbar_gnt[i] + 1;
+        else tb_stats_xbar_wait[i] <= tb_stats_xbar_wait[i] + 1;
+      end
+    end
+    for (int i = 0; i < core_v_mini_mcu_pkg::NUM_BANKS; i++) begin
+      if (x_heep_system_i.core_v_mini_mcu_i.system_bus_i.ram_req_o[i].req &&
+          x_heep_system_i.core_v_mini_mcu_i.system_bus_i.ram_resp_i[i].gnt)
+        tb_stats_ram_bank[i] <= tb_stats_ram_bank[i] + 1;
+    end
+% if dma_included:
+    for (int i = 0; i < core_v_mini_mcu_pkg::DMA_CH_NUM; i++) begin
+      if (x_heep_system_i.core_v_mini_mcu_i.ao_peripheral_subsystem_i.dma_subsystem_i.xbar_write_req[i].req &&
+          x_heep_system_i.core_v_mini_mcu_i.ao_peripheral_subsystem_i.dma_subsystem_i.xbar_write_resp[i].gnt)
+        tb_stats_dma_bytes[i] <= tb_stats_dma_bytes[i] +
+            $countones(x_heep_system_i.core_v_mini_mcu_i.ao_peripheral_subsystem_i.dma_subsystem_i.xbar_write_req[i].be);
+    end
+% endif
+  end
+end
+
+// Number of counters of a group, 0 if the group is not available in this model
+task tb_getStatCount;
+  input int group;
+  output int count;
+  case (group)
+    TB_STATS_CYCLES: count = 2;
+`ifndef VERILATOR_HIERARCHICAL
+    TB_STATS_CORE: count = 2;
+`endif
+    TB_STATS_XBAR_GNT, TB_STATS_XBAR_WAIT: count = core_v_mini_mcu_pkg::SYSTEM_XBAR_NMASTER;
+    TB_STATS_RAM_BANK: count = core_v_mini_mcu_pkg::NUM_BANKS;
+    TB_STATS_DMA_BYTES: count = core_v_mini_mcu_pkg::DMA_CH_NUM;
+    default: count = 0;
+  endcase
+endtask
+
+task tb_getStat;
+  input int group;
+  input int idx;
+  output longint value;
+  case (group)
+    TB_STATS_CYCLES: value = idx == 0 ? tb_stats_cycles : tb_stats_sleep_cycles;
+    TB_STATS_CORE: value = idx == 0 ? tb_stats_instret : tb_stats_stall_cycles;
+    TB_STATS_XBAR_GNT: value = tb_stats_xbar_gnt[idx];
+    TB_STATS_XBAR_WAIT: value = tb_stats_xbar_wait[idx];
+    TB_STATS_RAM_BANK: value = tb_stats_ram_bank[idx];
+    TB_STATS_DMA_BYTES: value = tb_stats_dma_bytes[idx];
+    default: value = '0;
+  endcase
+endtask
+
+// Idle skipping of tb_top.cpp (+idle_skip). While the CPU sleeps in WFI with no
+// interrupt, bus, DMA or SPI activity, only the RISC-V timers make progress: the
+// testbench jumps ahead by advancing their counters up to a couple of ticks before
+// the first armed compare value, instead of evaluating every clock edge in between.
+// The idle state must hold for TB_IDLE_SETTLE_CYCLES before skipping, to let the
+// power manager sequences that follow the sleep request complete.
+localparam int TB_IDLE_SETTLE_CYCLES = 1024;
+
+logic tb_idle;
+int unsigned tb_idle_cycles;
+
+always_comb begin
+  tb_idle = ${mcu}.core_sleep && ${mcu}.intr == '0;
+  for (int i = 0; i < core_v_mini_mcu_pkg::SYSTEM_XBAR_NMASTER; i++) begin
+    if (${mcu}.system_bus_i.int_master_req[i].req) tb_idle = 1'b0;
+  end
+% if dma_included:
+% for ch in range(base_peripheral_domain.get_dma().get_num_channels()):
+  // not in DMA_READY
+  if (${mcu}.ao_peripheral_subsystem_i.dma_subsystem_i.dma_i_gen[${ch}].dma_i.dma_state_q != 0) tb_idle = 1'b0;
+% endfor
+% endif
+% for csb in spi_csb:
+  if (${csb} != '1) tb_idle = 1'b0;
+% endfor
+end
+
+always_ff @(posedge clk_i or negedge rst_ni) begin
+  if (!rst_ni) tb_idle_cycles <= '0;
+  else if (!tb_idle) tb_idle_cycles <= '0;
+  else if (tb_idle_cycles < TB_IDLE_SETTLE_CYCLES) tb_idle_cycles <= tb_idle_cycles + 1;
+end
+
+function automatic longint tb_lcm(input longint a, input longint b);
+  longint x = a, y = b, r;
+  while (y != 0) begin
+    r = x % y;
+    x = y;
+    y = r;
+  end
+  return a / x * b;
+endfunction
+
+// Number of cycles (at most max_cycles) that can be skipped now, 0 if the
+// system is not idle or no timer interrupt is armed to wake the CPU up.
+// It is a multiple of the prescaler period of every running timer.
+task tb_getIdleCycles;
+  input longint max_cycles;
+  output longint cycles;
+  longint period, wake, ticks;
+  bit armed;
+  cycles = 0;
+  period = 1;
+  wake   = max_cycles;
+  armed  = 1'b0;
+  if (tb_idle_cycles < TB_IDLE_SETTLE_CYCLES) return;
+% for timer in rv_timers:
+% for h in range(2):
+  if (${timer}.active[${h}]) begin
+    period = tb_lcm(period, longint'(${timer}.prescaler[${h}]) + 1);
+    if (${timer}.intr_timer_en[${h}] && ${timer}.step[${h}] != 0) begin
+      if (${timer}.mtime[${h}] >= ${timer}.mtimecmp[${h}][0]) return;
+      ticks = longint'((${timer}.mtimecmp[${h}][0] - ${timer}.mtime[${h}] + ${timer}.step[${h}] - 1) / ${timer}.step[${h}]);
+      if (ticks <= 2) return;
+      if ((ticks - 2) * (${timer}.prescaler[${h}] + 1) < wake) wake = (ticks - 2) * (${timer}.prescaler[${h}] + 1);
+      armed = 1'b1;
+    end
+  end
+% endfor
+% endfor
+  if (armed) cycles = wake / period * period;
+endtask
+
+// Advances the running timers as if the given number of cycles had been simulated
+task tb_skipCycles;
+  input longint cycles;
+  logic [63:0] mtime;
+% for timer in rv_timers:
+% for h in range(2):
+  if (${timer}.active[${h}]) begin
+    mtime = ${timer}.mtime[${h}] + 64'(cycles / (${timer}.prescaler[${h}] + 1)) * ${timer}.step[${h}];
+    ${timer}.u_reg.u_timer_v_lower${h}.q = mtime[31:0];
+    ${timer}.u_reg.u_timer_v_upper${h}.q = mtime[63:32];
+  end
+% endfor
+% endfor
+endtask
+`endif
 `endif
 
 task load_flash_hex;
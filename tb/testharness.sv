@@ -535,6 +535,8 @@ module testharness #(
           .dma_addr_req_o(),
           .dma_addr_resp_i('0),
           .trigger_slot_i('0),
+          .trans_pending_i({31'h0, memcopy_intr}),
+          .window_pending_i('0),
           .dma_done_intr_o(memcopy_intr),
           .dma_window_intr_o(),
           .dma_done_o()
@@ -6,7 +6,9 @@ FUTURE WORK:
 """
 
 import argparse
+import json
 import os
+import shutil
 import subprocess
 import re
 
@@ -14,6 +16,15 @@ import re
 # Timeout for the simulation in seconds
 SIM_TIMEOUT_S = 180
 
+# Maximum simulation time of each app in batch mode (in clock cycles)
+BATCH_MAX_SIM_TIME = 50000000
+
+# Folder where the firmware of every app is kept for batch mode
+BATCH_DIR = "build/test_apps"
+
+# Pattern of the result line printed by the simulator for each app in batch mode
+BATCH_RESULT_PATTERN = r"^\[BATCH\] (\{.*\})$"
+
 # Available compilers
 COMPILERS = ["gcc", "clang"]
 COMPILER_PATH = [os.environ.get("RISCV_XHEEP") for _ in COMPILERS]
@@ -213,6 +224,84 @@ def run_app(an_app, simulator):
             return SimResult.FAILED
 
 
+def save_batch_firmware(an_app):
+    """
+    Keep a copy of the firmware of an_app, as the next compilation
+    overwrites sw/build/main.hex.
+
+    Returns the absolute path of the copy.
+    """
+    os.makedirs(BATCH_DIR, exist_ok=True)
+    firmware = os.path.abspath(os.path.join(BATCH_DIR, f"{an_app.name}.hex"))
+    shutil.copyfile("sw/build/main.hex", firmware)
+    return firmware
+
+
+def run_batch(batch_apps, simulator):
+    """
+    Runs all the batch_apps in a single simulation, as a list of
+    (app, firmware) tuples. The simulator resets the model between apps.
+
+    Returns a dictionary with the SimResult of each app name.
+    """
+    print(
+        BColors.OKBLUE
+        + f"Running {len(batch_apps)} apps in batch with {simulator}..."
+        + BColors.ENDC,
+        flush=True,
+    )
+    manifest = os.path.abspath(os.path.join(BATCH_DIR, "batch.txt"))
+    with open(manifest, "w") as f:
+        for _, firmware in batch_apps:
+            f.write(f"{firmware} {BATCH_MAX_SIM_TIME}\n")
+
+    results = {an_app.name: SimResult.TIMED_OUT for an_app, _ in batch_apps}
+    try:
+        run_output = subprocess.run(
+            ["make", f"{simulator}-run-batch", f"BATCH_FILE={manifest}"],
+            capture_output=True,
+            timeout=SIM_TIMEOUT_S * len(batch_apps),
+            check=False,
+        )
+    except subprocess.TimeoutExpired:
+        print(
+            BColors.FAIL
+            + f"Batch simulation with {simulator} timed out."
+            + BColors.ENDC,
+            flush=True,
+        )
+        return results
+
+    stdout = run_output.stdout.decode("utf-8")
+    for match in re.finditer(BATCH_RESULT_PATTERN, stdout, re.MULTILINE):
+        batch_result = json.loads(match.group(1))
+        for an_app, firmware in batch_apps:
+            if firmware == batch_result["firmware"]:
+                if batch_result["status"] != "finished":
+                    results[an_app.name] = SimResult.TIMED_OUT
+                elif batch_result["exit_value"] == 0:
+                    results[an_app.name] = SimResult.PASSED
+                else:
+                    results[an_app.name] = SimResult.FAILED
+
+    for an_app, _ in batch_apps:
+        if results[an_app.name] == SimResult.PASSED:
+            print(
+                BColors.OKGREEN
+                + f"Ran {an_app.name} with {simulator} successfully."
+                + BColors.ENDC,
+                flush=True,
+            )
+        else:
+            print(
+                BColors.FAIL
+                + f"Simulation of {an_app.name} with {simulator}: {results[an_app.name]}."
+                + BColors.ENDC,
+                flush=True,
+            )
+    return results
+
+
 def build_simulator(simulator):
     """
     Build the simulator model.
@@ -390,6 +479,11 @@ def main():
     parser.add_argument(
         "--compile-only", action="store_true", help="Only compile the applications"
     )
+    parser.add_argument(
+        "--batch",
+        action="store_true",
+        help="Run all the applications in a single simulator process",
+    )
     parser.add_argument(
         "--compilers",
         help="Override default list of compilers to test.",
@@ -452,6 +546,9 @@ def main():
         for simulator in SIMULATORS:
             build_simulator(simulator)
 
+    # Apps to run at the end in batch mode, as (app, firmware) tuples
+    batch_apps = []
+
     # Compile every app and run with the simulators
     for an_app in app_list:
         # If the app is in the blacklist, print a message and skip it
@@ -488,6 +585,9 @@ def main():
                             + BColors.ENDC,
                             flush=True,
                         )
+                    elif args.batch:
+                        if simulator == SIMULATORS[0] and an_app.compilation_succeeded():
+                            batch_apps.append((an_app, save_batch_firmware(an_app)))
                     else:
                         simulation_result = run_app(an_app, simulator)
                         an_app.add_simulation_result(simulator, simulation_result)
@@ -497,6 +597,13 @@ def main():
                 flush=True,
             )
 
+    # Run all the apps that compiled in a single simulation
+    if batch_apps:
+        for simulator in SIMULATORS:
+            batch_results = run_batch(batch_apps, simulator)
+            for an_app, _ in batch_apps:
+                an_app.add_simulation_result(simulator, batch_results[an_app.name])
+
     # Filter and print the results
     (
         skipped_apps,
@@ -0,0 +1,96 @@
+#!/usr/bin/env python3
+
+# Decodes the binary trace of the external memory of the SystemC testbench
+# (+mem_trace=<file>, see tb/systemc_tb/TraceBuffer.h) into text, one line per record.
+#
+# Usage: decode_mem_trace.py <trace> [--summary]
+
+import argparse
+import struct
+import sys
+
+HEADER = struct.Struct("<8sII")
+RECORD = struct.Struct("<QIIBBHI")
+VERSION = 1
+
+REQ_READ, REQ_WRITE, RESP, HIT, MISS, WRITE_BACK, MEM_READ, MEM_WRITE, FLUSH, BYPASS = range(10)
+
+NAMES = {
+    REQ_READ: "REQ R",
+    REQ_WRITE: "REQ W",
+    RESP: "RESP",
+    HIT: "HIT",
+    MISS: "MISS",
+    WRITE_BACK: "WRITE BACK",
+    MEM_READ: "MEM READ",
+    MEM_WRITE: "MEM WRITE",
+    FLUSH: "FLUSH",
+    BYPASS: "BYPASS",
+}
+
+
+def format_record(time_ps, addr, data, rtype, bypass, aux):
+    name = NAMES.get(rtype, "UNKNOWN(%d)" % rtype)
+    line = "%15d ps  %-10s @0x%08x" % (time_ps, name, addr)
+    if rtype in (REQ_READ, REQ_WRITE):
+        if rtype == REQ_WRITE:
+            line += "  DATA = 0x%08x" % data
+        line += "  BE = 0x%x" % aux
+    elif rtype == RESP:
+        line += "  DATA = 0x%08x  latency %d ns" % (data, aux)
+    elif rtype in (HIT, WRITE_BACK):
+        line += "  way %d" % aux
+    elif rtype == MISS:
+        line += "  no allocation" if aux == 0xFF else "  way %d" % aux
+    elif rtype in (MEM_READ, MEM_WRITE):
+        line += "  DATA = 0x%08x" % data
+        if rtype == MEM_WRITE and aux != 0xF:
+            line += "  BE = 0x%x" % aux
+    elif rtype == FLUSH:
+        line += "  %d lines written back" % data
+    if bypass:
+        line += "  (bypass)"
+    return line
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description="Decode the binary external memory trace of the SystemC testbench"
+    )
+    parser.add_argument("trace", help="trace file written with +mem_trace=<file>")
+    parser.add_argument(
+        "--summary",
+        action="store_true",
+        help="print only the number of records of each type",
+    )
+    args = parser.parse_args()
+
+    with open(args.trace, "rb") as f:
+        magic, version, record_size = HEADER.unpack(f.read(HEADER.size))
+        if magic != b"XHMTRACE" or version != VERSION or record_size != RECORD.size:
+            print(
+                "Error: %s is not a version %d memory trace" % (args.trace, VERSION),
+                file=sys.stderr,
+            )
+            sys.exit(1)
+
+        counts = {}
+        out = sys.stdout
+        while True:
+            chunk = f.read(RECORD.size * 4096)
+            if not chunk:
+                break
+            for time_ps, addr, data, rtype, bypass, aux, _ in RECORD.iter_unpack(
+                chunk[: len(chunk) - len(chunk) % RECORD.size]
+            ):
+                counts[rtype] = counts.get(rtype, 0) + 1
+                if not args.summary:
+                    out.write(format_record(time_ps, addr, data, rtype, bypass, aux) + "\n")
+
+    if args.summary:
+        for rtype in sorted(counts):
+            print("%-10s %d" % (NAMES.get(rtype, "UNKNOWN(%d)" % rtype), counts[rtype]))
+
+
+if __name__ == "__main__":
+    main()
@@ -278,7 +278,19 @@ def load_peripherals_config(system: XHeep, config_path: str):
                     elif peripheral_name == "spi_flash":
                         peripheral = SPI_flash(offset, length)
                     elif peripheral_name == "spi_memio":
-                        peripheral = SPI_memio(offset, length)
+                        peripheral = SPI_memio(
+                            offset,
+                            length,
+                            cache_line_size=int(
+                                peripheral_config.get("cache_line_size", "0x10"), 16
+                            ),
+                            cache_num_lines=int(
+                                peripheral_config.get("cache_num_lines", "0x10"), 16
+                            ),
+                            cache_prefetch=int(
+                                peripheral_config.get("cache_prefetch", "0x1"), 16
+                            ),
+                        )
                     elif peripheral_name == "dma":
                         try:
                             if peripheral_config["is_included"] == "yes":
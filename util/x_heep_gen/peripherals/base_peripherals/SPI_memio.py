@@ -6,7 +6,96 @@ class SPI_memio(BasePeripheral):
     Memory-mapped IO interface for SPI communication.
 
     Default length : 32KB
+
+    :param int cache_line_size: The size of a line of the read cache, in bytes.
+    :param int cache_num_lines: The number of lines of the read cache (0 removes the cache).
+    :param int cache_prefetch: The number of sequential lines prefetched after a miss.
     """
 
     _name = "spi_memio"
     _length: int = 0x00008000
+
+    def __init__(
+        self,
+        address: int = None,
+        length: int = None,
+        cache_line_size: int = 0x10,
+        cache_num_lines: int = 0x10,
+        cache_prefetch: int = 0x1,
+    ):
+        """
+        Initialize the SPI memio peripheral.
+
+        :param int address: The virtual (in peripheral domain) memory address of the spi memio.
+        :param int length: The length of the spi memio.
+        :param int cache_line_size: The size of a line of the read cache, in bytes.
+        :param int cache_num_lines: The number of lines of the read cache (0 removes the cache).
+        :param int cache_prefetch: The number of sequential lines prefetched after a miss.
+        """
+        super().__init__(address, length)
+        self._cache_line_size = cache_line_size
+        self._cache_num_lines = cache_num_lines
+        self._cache_prefetch = cache_prefetch
+
+    def set_cache_line_size(self, value: int):
+        """
+        Set the size of a line of the read cache, in bytes.
+        """
+        self._cache_line_size = value
+
+    def get_cache_line_size(self):
+        """
+        Get the size of a line of the read cache, in bytes.
+        """
+        return self._cache_line_size
+
+    def set_cache_num_lines(self, value: int):
+        """
+        Set the number of lines of the read cache.
+        """
+        self._cache_num_lines = value
+
+    def get_cache_num_lines(self):
+        """
+        Get the number of lines of the read cache.
+        """
+        return self._cache_num_lines
+
+    def set_cache_prefetch(self, value: int):
+        """
+        Set the number of sequential lines prefetched after a miss.
+        """
+        self._cache_prefetch = value
+
+    def get_cache_prefetch(self):
+        """
+        Get the number of sequential lines prefetched after a miss.
+        """
+        return self._cache_prefetch
+
+    def validate(self):
+        """
+        Checks if the read cache configuration is valid (line size a power of 2 of at least 8 bytes, number of lines 0 or a power of 2 of at least 2, prefetch depth lower than the number of lines).
+        """
+        valid = True
+        line_size = self.get_cache_line_size()
+        num_lines = self.get_cache_num_lines()
+
+        if line_size < 8 or line_size & (line_size - 1) != 0:
+            print("SPI memio cache line size has to be a power of 2 of at least 8 bytes")
+            valid = False
+
+        if num_lines != 0 and (num_lines < 2 or num_lines & (num_lines - 1) != 0):
+            print(
+                "SPI memio cache number of lines has to be 0 or a power of 2 of at least 2"
+            )
+            valid = False
+
+        if num_lines != 0 and self.get_cache_prefetch() >= num_lines:
+            print(
+                "SPI memio cache prefetch depth has to be lower than "
+                + str(num_lines)
+            )
+            valid = False
+
+        return valid
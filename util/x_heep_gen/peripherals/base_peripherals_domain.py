@@ -121,6 +121,18 @@ class BasePeripheralDomain(PeripheralDomain):
         """
         return self.get_all_dmas()[0]
 
+    def get_spi_memio(self):
+        """
+        Get the SPI memio peripheral.
+
+        :return: The SPI memio peripheral.
+        :rtype: SPI_memio
+        """
+        for p in self._peripherals:
+            if isinstance(p, SPI_memio):
+                return deepcopy(p)
+        raise ValueError("No SPI memio peripheral found")
+
     # Validate functions
 
     def __check_all_peripherals_added(self):
@@ -146,7 +158,7 @@ class BasePeripheralDomain(PeripheralDomain):
 
     def validate(self):
         """
-        Validate the base peripheral domain. Checks if all base peripherals are added, if they don't overlap and if their configuration paths are valid. Checks also if dmas are valid.
+        Validate the base peripheral domain. Checks if all base peripherals are added, if they don't overlap and if their configuration paths are valid. Checks also if dmas and the spi memio cache are valid.
 
         :return: True if the base peripheral domain is valid, False otherwise.
         :rtype: bool
@@ -155,4 +167,14 @@ class BasePeripheralDomain(PeripheralDomain):
         for dma in self.get_all_dmas():
             dma_valid &= dma.validate()
 
-        return self.__check_all_peripherals_added() and super().validate() and dma_valid
+        spi_memio_valid = True
+        for p in self._peripherals:
+            if isinstance(p, SPI_memio):
+                spi_memio_valid &= p.validate()
+
+        return (
+            self.__check_all_peripherals_added()
+            and super().validate()
+            and dma_valid
+            and spi_memio_valid
+        )